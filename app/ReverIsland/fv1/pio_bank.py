@@ -0,0 +1,15 @@
+#
+# PlatformIO pre script
+# ビルド前にbanks.jsonからsrc/PresetBank.hを作り直す
+#
+
+Import("env")
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(env.subst("$PROJECT_DIR"), "..", "..", "tools"))
+import fv1_bank
+
+if fv1_bank.write_header():
+    print("PresetBank.h updated")
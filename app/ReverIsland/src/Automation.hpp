@@ -0,0 +1,243 @@
+/*!
+ * Automation class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "SerialFrame.hpp"
+#include "GpioSet.h"
+
+// 時刻つきのパラメタ操作を再生する
+// イベントは開始からの時刻順に並べて転送する。時刻が同じなら並び順に適用する
+#define AUTO_EVENT_PRESET 0x01 // value:プリセット番号
+#define AUTO_EVENT_POT 0x02    // target:ポット番号 value:目標値(12bit) ramp:到達までの時間(ms)
+#define AUTO_EVENT_RELEASE 0x03 // target:ポット番号。ポットを手に戻す
+#define AUTO_EVENT_LOOP 0x04   // 先頭に戻って繰り返す
+
+#define AUTO_EVENTS_MAX 1024
+#define AUTO_POT_RELEASED 0xFFFF
+
+struct __attribute__((packed)) AutomationEvent
+{
+    uint32_t micros;
+    uint8_t type;
+    uint8_t target;
+    uint16_t value;
+    uint16_t ramp;
+};
+
+// 転送フレームのペイロード：[先頭イベント番号 u16][イベント x n]
+#define AUTO_EVENTS_PER_FRAME ((FRAME_PAYLOAD_MAX - 2) / sizeof(AutomationEvent))
+
+/// @brief パラメタ操作の自動再生
+/// 制御周期ごとにupdate()を呼ぶ。バッファは固定長で再生中にヒープは使わない
+/// @tparam PRESETS プリセット数。範囲外のプリセット変更は転送時に断る
+template <byte PRESETS>
+class Automation
+{
+public:
+    Automation()
+    {
+        _count = 0;
+        clear();
+    }
+
+    void clear()
+    {
+        stop();
+        _count = 0;
+    }
+
+    /// @brief 転送フレームを受ける。先頭番号0のフレームで読み込み直しになる
+    /// 範囲外のプリセット番号を含むフレームは断り、途中まで読んだ分も捨てる
+    /// @return 受け付けたらtrue
+    bool load(const byte *pPayload, byte length)
+    {
+        if (length < 2)
+        {
+            return false;
+        }
+
+        uint16_t index = pPayload[0] | (pPayload[1] << 8);
+        uint16_t count = (length - 2) / sizeof(AutomationEvent);
+        if (index == 0)
+        {
+            clear();
+        }
+        if (index != _count || index + count > AUTO_EVENTS_MAX)
+        {
+            return false;
+        }
+
+        memcpy(&_events[index], &pPayload[2], count * sizeof(AutomationEvent));
+        for (uint16_t i = index; i < index + count; ++i)
+        {
+            if (_events[i].type == AUTO_EVENT_PRESET && _events[i].value >= PRESETS)
+            {
+                clear();
+                return false;
+            }
+        }
+        _count = index + count;
+        return true;
+    }
+
+    uint16_t getCount()
+    {
+        return _count;
+    }
+
+    bool isPlaying()
+    {
+        return _playing;
+    }
+
+    void start(uint32_t now)
+    {
+        _playing = _count > 0;
+        _position = 0;
+        _startMicros = now;
+        releaseAll();
+    }
+
+    void stop()
+    {
+        _playing = false;
+        releaseAll();
+    }
+
+    /// @brief 時刻までのイベントを適用する
+    /// @param now 制御周期の時刻(us)
+    /// @param pPresetIndex プリセット変更があれば書き換える
+    /// @return プリセットが変わったらtrue
+    bool update(uint32_t now, int8_t *pPresetIndex)
+    {
+        bool presetChanged = false;
+        if (!_playing)
+        {
+            return false;
+        }
+
+        uint32_t elapsed = now - _startMicros;
+        while (_position < _count && _events[_position].micros <= elapsed)
+        {
+            const AutomationEvent &event = _events[_position];
+            _position++;
+            switch (event.type)
+            {
+            case AUTO_EVENT_PRESET:
+                *pPresetIndex = event.value;
+                presetChanged = true;
+                break;
+            case AUTO_EVENT_POT:
+                if (event.target < POTS_MAX)
+                {
+                    // 起点は現在の出力値。手に持っていたなら呼び出し側の現在値から
+                    _rampFrom[event.target] = _potValues[event.target] == AUTO_POT_RELEASED ? _lastValues[event.target] : _potValues[event.target];
+                    _rampTo[event.target] = min(event.value, (uint16_t)POTS_MAX_VALUE);
+                    _rampStart[event.target] = _startMicros + event.micros;
+                    _rampLength[event.target] = (uint32_t)event.ramp * 1000;
+                    _potValues[event.target] = _rampFrom[event.target];
+                }
+                break;
+            case AUTO_EVENT_RELEASE:
+                if (event.target < POTS_MAX)
+                {
+                    _potValues[event.target] = AUTO_POT_RELEASED;
+                }
+                break;
+            case AUTO_EVENT_LOOP:
+                // ループの時刻を次の周の0とする。位相を保つため今の時刻ではなくイベント時刻で合わせる
+                _startMicros += event.micros;
+                elapsed = now - _startMicros;
+                _position = 0;
+                break;
+            default:
+                break;
+            }
+
+            if (event.type == AUTO_EVENT_LOOP && event.micros == 0)
+            {
+                // 時刻0のループは無限に回るので止める
+                _playing = false;
+                break;
+            }
+        }
+
+        // ランプはイベント時刻基準で補間するので、制御周期のずれが積み重ならない
+        bool ramping = false;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            if (_potValues[i] == AUTO_POT_RELEASED)
+            {
+                continue;
+            }
+
+            uint32_t t = now - _rampStart[i];
+            if ((int32_t)t < 0)
+            {
+                t = 0;
+            }
+            if (t >= _rampLength[i])
+            {
+                _potValues[i] = _rampTo[i];
+            }
+            else
+            {
+                int32_t delta = (int32_t)_rampTo[i] - _rampFrom[i];
+                _potValues[i] = _rampFrom[i] + (int32_t)((int64_t)delta * t / _rampLength[i]);
+                ramping = true;
+            }
+        }
+
+        if (_position >= _count && !ramping)
+        {
+            // 最後のランプが目標値に着くまで進め、その値を保持したまま終える
+            _playing = false;
+        }
+        return presetChanged;
+    }
+
+    /// @brief 自動操作中のポットか
+    bool isPotActive(byte index)
+    {
+        return _potValues[index] != AUTO_POT_RELEASED;
+    }
+
+    uint16_t getPotValue(byte index)
+    {
+        return _potValues[index];
+    }
+
+    /// @brief ランプの起点に使う手元の値を知らせる
+    void setLastValue(byte index, uint16_t value)
+    {
+        _lastValues[index] = value;
+    }
+
+protected:
+    AutomationEvent _events[AUTO_EVENTS_MAX];
+    uint16_t _count;
+    uint16_t _position;
+    volatile bool _playing;
+    uint32_t _startMicros;
+    uint16_t _potValues[POTS_MAX];
+    uint16_t _lastValues[POTS_MAX];
+    uint16_t _rampFrom[POTS_MAX];
+    uint16_t _rampTo[POTS_MAX];
+    uint32_t _rampStart[POTS_MAX];
+    uint32_t _rampLength[POTS_MAX];
+
+    void releaseAll()
+    {
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            _potValues[i] = AUTO_POT_RELEASED;
+            _lastValues[i] = 0;
+        }
+    }
+};
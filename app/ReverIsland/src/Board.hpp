@@ -0,0 +1,167 @@
+/*!
+ * Board description
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <hardware/gpio.h>
+#include <hardware/adc.h>
+#include <pico/critical_section.h>
+
+// 基板リビジョンはビルドフラグで選ぶ(platformio.iniの環境ごとに指定)
+//   BOARD_REV100 : rev1.0.0
+//   BOARD_PROTO  : 試作基板
+//   指定なし     : rev1.1.0
+
+/// @brief ROM/EEPROM切り替え線の出力レベル
+struct RomSelect
+{
+    byte t0;
+    byte rom1;
+    byte rom2;
+};
+
+/// @brief rev1.1.0
+struct BoardRev110
+{
+    // GPIO割り当て
+    static constexpr byte SW0 = 15;
+    static constexpr byte SW1 = 14;
+    static constexpr byte POT0 = 26;
+    static constexpr byte POT1 = 27;
+    static constexpr byte POT2 = 28;
+    static constexpr byte CV = 29;
+    static constexpr byte PWM_POT0 = 10;
+    static constexpr byte PWM_POT1 = 11;
+    static constexpr byte PWM_POT2 = 12;
+    static constexpr byte S0 = 1;
+    static constexpr byte S1 = 2;
+    static constexpr byte S2 = 3;
+    static constexpr byte T0 = 13;
+    static constexpr byte ROM1 = 0;
+    static constexpr byte ROM2 = 8;
+    // 内蔵レギュレータのモード切り替え(HIGHでPWM)
+    static constexpr byte SMPS_MODE = 23;
+    // 本体どうしの連携に使うUART0。Picoのピンヘッダから出す
+    static constexpr byte LINK_TX = 16;
+    static constexpr byte LINK_RX = 17;
+
+    // バンク番号ごとのROM/EEPROM切り替え。範囲外は先頭(内蔵ROM)
+    static constexpr byte ROM_SELECT_MAX = 3;
+    static constexpr RomSelect ROM_SELECT[ROM_SELECT_MAX] = {
+        {LOW, HIGH, HIGH},
+        {HIGH, LOW, HIGH},
+        {HIGH, HIGH, LOW},
+    };
+
+    // 表示
+    static constexpr bool DISPLAY_FLIP = true;
+    static constexpr byte TITLE_ROW = 0;
+    static constexpr byte POTS_ROW = 1;
+};
+
+/// @brief rev1.0.0。EEPROM切り替え線のピンが違う
+struct BoardRev100 : BoardRev110
+{
+    static constexpr byte ROM1 = 6;
+    static constexpr byte ROM2 = 7;
+};
+
+/// @brief 試作基板。表示の向きと行の割り当てが違う
+struct BoardProto : BoardRev110
+{
+    static constexpr bool DISPLAY_FLIP = false;
+    static constexpr byte TITLE_ROW = 3;
+    static constexpr byte POTS_ROW = 0;
+};
+
+/// @brief 基板定義からの入出力。SIO/ADCを直接操作する
+/// ピン番号とマスクはすべてコンパイル時に決まるので、ArduinoのdigitalRead等のような
+/// ピン番号の検査や変換は通らない
+template <typename Def>
+class BoardIo : public Def
+{
+public:
+    static constexpr uint32_t ROM_MASK = (1u << Def::T0) | (1u << Def::ROM1) | (1u << Def::ROM2);
+    static constexpr uint32_t PRESET_MASK = (1u << Def::S0) | (1u << Def::S1) | (1u << Def::S2);
+    static constexpr byte ADC_PIN_BASE = 26;
+
+    static void initOutput(uint32_t mask)
+    {
+        gpio_init_mask(mask);
+        gpio_set_dir_out_masked(mask);
+    }
+
+    static void initInputPullup(byte pin)
+    {
+        gpio_init(pin);
+        gpio_set_dir(pin, false);
+        gpio_pull_up(pin);
+    }
+
+    static void initAnalog(byte pin)
+    {
+        if (!_adcReady)
+        {
+            adc_init();
+            critical_section_init(&_adcLock);
+            _adcReady = true;
+        }
+        adc_gpio_init(pin);
+    }
+
+    static inline byte digitalRead(byte pin)
+    {
+        return gpio_get(pin) ? HIGH : LOW;
+    }
+
+    static inline void digitalWrite(byte pin, byte value)
+    {
+        gpio_put(pin, value != LOW);
+    }
+
+    /// @brief 12bitで読む。入力の選択と変換は両コアから来るのでまとめて排他する
+    static inline uint16_t analogRead(byte pin)
+    {
+        critical_section_enter_blocking(&_adcLock);
+        adc_select_input(pin - ADC_PIN_BASE);
+        uint16_t value = adc_read();
+        critical_section_exit(&_adcLock);
+        return value;
+    }
+
+    /// @brief ROM/EEPROM切り替え線を1回で書く
+    static inline void setRomSelect(byte bank)
+    {
+        const RomSelect &select = Def::ROM_SELECT[bank < Def::ROM_SELECT_MAX ? bank : 0];
+        gpio_put_masked(ROM_MASK,
+                        ((uint32_t)select.t0 << Def::T0) |
+                            ((uint32_t)select.rom1 << Def::ROM1) |
+                            ((uint32_t)select.rom2 << Def::ROM2));
+    }
+
+    /// @brief プログラム選択線(S0-S2)を1回で書く。3bitより上は無視
+    static inline void setPresetSelect(byte index)
+    {
+        gpio_put_masked(PRESET_MASK,
+                        ((uint32_t)bitRead(index, 0) << Def::S0) |
+                            ((uint32_t)bitRead(index, 1) << Def::S1) |
+                            ((uint32_t)bitRead(index, 2) << Def::S2));
+    }
+
+protected:
+    static inline bool _adcReady = false;
+    static inline critical_section_t _adcLock;
+};
+
+#if defined(BOARD_PROTO)
+typedef BoardIo<BoardProto> Board;
+#elif defined(BOARD_REV100)
+typedef BoardIo<BoardRev100> Board;
+#else
+typedef BoardIo<BoardRev110> Board;
+#endif
@@ -0,0 +1,53 @@
+/*!
+ * BootLog class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// 起動の節目。CPU 1と2の両方から記録する
+#define BOOT_SETUP        0  // CPU 1 setup開始
+#define BOOT_SNAPSHOT     1  // 保存状態の読み込み完了
+#define BOOT_OUTPUTS      2  // ROM/プリセット選択とPWMを出力
+#define BOOT_INPUTS       3  // ボタンとフィルタの初期化完了
+#define BOOT_READY        4  // スケジューラ開始
+#define BOOT_OLED_SETUP   5  // CPU 2 setup1開始
+#define BOOT_OLED_READY   6  // 表示器の初期化完了
+#define BOOT_FIRST_FRAME  7  // 最初の画面を描いた
+#define BOOT_MILESTONE_MAX 8
+
+/// @brief 起動の節目の時刻(us)を記録する
+/// 節目ごとに置き場所が決まっているので両コアから書いてもぶつからない。0は未到達
+class BootLog
+{
+public:
+    BootLog()
+    {
+        for (byte i = 0; i < BOOT_MILESTONE_MAX; ++i)
+        {
+            _micros[i] = 0;
+        }
+    }
+
+    void mark(byte milestone)
+    {
+        // 起動直後の0と未到達を分ける
+        _micros[milestone] = max(micros(), (unsigned long)1);
+    }
+
+    /// @brief 送信用。uint32_tがBOOT_MILESTONE_MAX個並ぶ
+    void get(uint32_t values[BOOT_MILESTONE_MAX])
+    {
+        for (byte i = 0; i < BOOT_MILESTONE_MAX; ++i)
+        {
+            values[i] = _micros[i];
+        }
+    }
+
+protected:
+    volatile uint32_t _micros[BOOT_MILESTONE_MAX];
+};
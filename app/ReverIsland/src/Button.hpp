@@ -8,16 +8,14 @@
 #pragma once
 
 #include <Arduino.h>
+#include "Board.hpp"
 
-class Button
+/// @brief ボタン判定の本体。ピンの読み方は派生側のreadPin/readMillisで決める
+/// 仮想関数にせず静的に呼び分けるので、読み出しはgetStateの中に展開される
+template <typename Derived>
+class ButtonBase
 {
 public:
-    Button() {}
-    Button(byte pin)
-    {
-        init(pin);
-    }
-    
     /// @brief ピン設定
     /// @param pin
     void init(byte pin)
@@ -26,8 +24,9 @@ public:
         _pinState = 0;
         _holdStage = 0;
         _holdTime = 500;
+        _lastMillis = 0;
 
-        pinMode(pin, INPUT_PULLUP);
+        Board::initInputPullup(pin);
 
         // 空読み
         for(int i = 0; i < 8; ++i)
@@ -41,7 +40,7 @@ public:
     inline byte getState()
     {
         byte result = 0;
-        byte value = readPin();
+        byte value = self().readPin();
         // 簡単チャタ取り
         _pinState = (_pinState << 1) | value;
 
@@ -93,10 +92,10 @@ public:
             if (_holdStage == 0)
             {
                 _holdStage = 1;
-                _lastMillis = millis();
+                _lastMillis = self().readMillis();
             }
             // Hold confirm (1sec)
-            else if (millis() >= _lastMillis + _holdTime)
+            else if (self().readMillis() >= _lastMillis + _holdTime)
             {
                 _holdStage = 2;
             }
@@ -117,10 +116,40 @@ protected:
     unsigned long _lastMillis;
     int16_t _holdTime;
 
+    Derived &self()
+    {
+        return *static_cast<Derived *>(this);
+    }
+
     /// @brief ピン値読込
     /// @return
-    virtual byte readPin()
+    inline byte readPinDirect()
+    {
+        return Board::digitalRead(_pin);
+    }
+};
+
+class Button : public ButtonBase<Button>
+{
+    friend class ButtonBase<Button>;
+
+public:
+    Button() {}
+    Button(byte pin)
+    {
+        init(pin);
+    }
+
+protected:
+    inline byte readPin()
+    {
+        return readPinDirect();
+    }
+
+    /// @brief ホールド判定用の現在時刻
+    /// @return
+    inline unsigned long readMillis()
     {
-        return digitalRead(_pin);
+        return millis();
     }
 };
@@ -0,0 +1,103 @@
+/*!
+ * CVQuantizer class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "GpioSet.h"
+
+/// @brief CV電圧をスロット番号に量子化する
+/// 境界付近のふらつきはヒステリシスで、ステップ直後の揺れは確定待ちで抑える
+class CVQuantizer
+{
+public:
+    CVQuantizer()
+    {
+        setRange(2, 0, 0);
+        reset();
+    }
+
+    /// @brief 量子化の設定
+    /// @param slots スロット数
+    /// @param hysteresis 境界をまたいでからさらにスロット幅の何%動いたら切り替えるか
+    /// @param settleMicros 新しいスロットに留まってから確定するまでの時間
+    void setRange(byte slots, byte hysteresis, uint32_t settleMicros)
+    {
+        _slots = max(slots, (byte)1);
+        _width = (POTS_MAX_VALUE + 1) / _slots;
+        _margin = (uint32_t)_width * min(hysteresis, (byte)50) / 100;
+        _settleMicros = settleMicros;
+    }
+
+    /// @brief 確定済みのスロットを忘れる。次のupdateで現在値から選び直す
+    void reset()
+    {
+        _slot = -1;
+        _candidate = -1;
+    }
+
+    /// @brief 制御周期ごとに呼ぶ
+    /// @param value CV値(12bit)
+    /// @param now 制御周期の時刻(us)
+    /// @return スロットが確定して変わったらその番号、それ以外は-1
+    int8_t update(uint16_t value, uint32_t now)
+    {
+        int8_t slot = quantize(value);
+        if (slot == _slot)
+        {
+            _candidate = -1;
+            return -1;
+        }
+
+        if (slot != _candidate)
+        {
+            _candidate = slot;
+            _candidateMicros = now;
+        }
+
+        if (now - _candidateMicros < _settleMicros)
+        {
+            return -1;
+        }
+
+        _slot = slot;
+        _candidate = -1;
+        return _slot;
+    }
+
+    int8_t getSlot()
+    {
+        return _slot;
+    }
+
+protected:
+    byte _slots;
+    uint16_t _width;
+    uint16_t _margin;
+    uint32_t _settleMicros;
+    int8_t _slot;
+    int8_t _candidate;
+    uint32_t _candidateMicros;
+
+    int8_t quantize(uint16_t value)
+    {
+        int8_t slot = min(value / _width, _slots - 1);
+        if (_slot < 0 || _slot >= _slots || slot == _slot)
+        {
+            return slot;
+        }
+
+        // 今のスロットの範囲をマージン分だけ広げ、その中なら留まる
+        int32_t low = (int32_t)_slot * _width - _margin;
+        int32_t high = (int32_t)(_slot + 1) * _width + _margin;
+        if (value >= low && value < high)
+        {
+            return _slot;
+        }
+        return slot;
+    }
+};
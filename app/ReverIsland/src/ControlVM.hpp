@@ -0,0 +1,371 @@
+/*!
+ * ControlVM class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "SerialFrame.hpp"
+
+// 操作の割り当てをプリセットごとのスクリプトで差し替える小さなレジスタVM
+// 命令は4バイト固定 [OP][A][B][C]。分岐は前方のみなので、1回の実行は最大でもプログラム長の命令数で終わる
+// スクリプトは tools/vmc.py でコンパイルして転送する
+#define VM_REGS 16
+#define VM_PROGRAM_MAX 64
+
+#define VM_OP_END 0x00
+#define VM_OP_LDI 0x01  // A=imm16(B|C<<8)
+#define VM_OP_MOV 0x02  // A=B
+#define VM_OP_IN 0x03   // A=入力ポートB
+#define VM_OP_OUT 0x04  // 出力ポートB=A
+#define VM_OP_ADD 0x10  // A=B+C。算術のあふれは32bitの2の補数で折り返す
+#define VM_OP_SUB 0x11
+#define VM_OP_MUL 0x12
+#define VM_OP_DIV 0x13  // 0除算は0。最小値/-1は折り返して最小値
+#define VM_OP_MULQ 0x14 // A=(B*C)>>12。12bit値どうしの比率
+#define VM_OP_MIN 0x15
+#define VM_OP_MAX 0x16
+#define VM_OP_AND 0x17
+#define VM_OP_OR 0x18
+#define VM_OP_XOR 0x19
+#define VM_OP_SHL 0x1A
+#define VM_OP_SHR 0x1B  // 算術シフト
+#define VM_OP_ABS 0x1C  // A=|B|
+#define VM_OP_NEG 0x1D  // A=-B
+#define VM_OP_JMP 0x20  // 次の命令からC個先へ
+#define VM_OP_JZ 0x21   // A==0なら
+#define VM_OP_JNZ 0x22
+#define VM_OP_JLT 0x23  // A<Bなら
+#define VM_OP_JGE 0x24
+#define VM_OP_JEQ 0x25
+#define VM_OP_JNE 0x26
+
+// 入力ポート
+#define VM_IN_POT0 0
+#define VM_IN_POT1 1
+#define VM_IN_POT2 2
+#define VM_IN_CV 3
+#define VM_IN_SW0 4 // ボタンの状態(getStateの戻り値)
+#define VM_IN_SW1 5
+#define VM_IN_TIME 6 // ms
+#define VM_IN_PARAM0 7 // 現在のパラメタ値(12bit)
+#define VM_IN_PARAM1 8
+#define VM_IN_PARAM2 9
+#define VM_IN_PRESET 10
+#define VM_IN_MAX 11
+
+// 出力ポート
+#define VM_OUT_PARAM0 0
+#define VM_OUT_PARAM1 1
+#define VM_OUT_PARAM2 2
+#define VM_OUT_PRESET 3
+#define VM_OUT_MAX 4
+
+// 転送結果
+#define VM_LOAD_OK 0
+#define VM_LOAD_PENDING 1
+#define VM_LOAD_BAD_FRAME 2
+#define VM_LOAD_BAD_CODE 3
+
+struct __attribute__((packed)) VMInstruction
+{
+    uint8_t op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+};
+
+// 転送フレームのペイロード：[スロット][先頭命令番号][フラグ(bit0:最後)][命令 x n]
+#define VM_FRAME_HEADER 3
+#define VM_INSTRUCTIONS_PER_FRAME ((FRAME_PAYLOAD_MAX - VM_FRAME_HEADER) / sizeof(VMInstruction))
+
+/// @brief スロット(プリセット)ごとのプログラムと実行
+/// レジスタは実行をまたいで保持するのでスクリプトの状態に使える。スロットが変わると0に戻す
+template <byte SLOTS>
+class ControlVM
+{
+public:
+    ControlVM()
+    {
+        for (byte i = 0; i < SLOTS; ++i)
+        {
+            _length[i] = 0;
+        }
+        _slot = 0;
+        _loading = 0xFF;
+        resetRegs();
+    }
+
+    /// @brief 転送フレームを受ける。最後のフレームで検査して有効にする
+    /// @return VM_LOAD_*
+    byte load(const byte *pPayload, byte length, byte &slot, byte &errorPc)
+    {
+        errorPc = 0;
+        slot = length > 0 ? pPayload[0] : 0xFF;
+        if (length < VM_FRAME_HEADER || slot >= SLOTS)
+        {
+            return VM_LOAD_BAD_FRAME;
+        }
+
+        byte offset = pPayload[1];
+        bool last = pPayload[2] & 1;
+        byte count = (length - VM_FRAME_HEADER) / sizeof(VMInstruction);
+        if (offset == 0)
+        {
+            // 書き換え中は実行しない
+            _length[slot] = 0;
+            _loadLength = 0;
+            _loading = slot;
+        }
+        if (_loading != slot || offset != _loadLength || offset + count > VM_PROGRAM_MAX)
+        {
+            _loading = 0xFF;
+            return VM_LOAD_BAD_FRAME;
+        }
+
+        memcpy(&_code[slot][offset], &pPayload[VM_FRAME_HEADER], count * sizeof(VMInstruction));
+        _loadLength = offset + count;
+        if (!last)
+        {
+            return VM_LOAD_PENDING;
+        }
+
+        _loading = 0xFF;
+        if (!verify(_code[slot], _loadLength, errorPc))
+        {
+            return VM_LOAD_BAD_CODE;
+        }
+
+        _length[slot] = _loadLength;
+        if (slot == _slot)
+        {
+            resetRegs();
+        }
+        return VM_LOAD_OK;
+    }
+
+    /// @brief 実行するスロットを選ぶ。変わったらレジスタを戻す
+    void select(byte slot)
+    {
+        if (slot != _slot)
+        {
+            _slot = slot;
+            resetRegs();
+        }
+    }
+
+    bool isActive()
+    {
+        return _slot < SLOTS && _length[_slot] > 0;
+    }
+
+    /// @brief 1回実行する
+    /// @param inputs VM_IN_MAX個の入力
+    /// @param outputs VM_OUT_MAX個の出力。OUTを実行したものだけ書く
+    /// @return OUTを実行した出力のビットマスク
+    byte run(const int32_t *inputs, int32_t *outputs)
+    {
+        if (!isActive())
+        {
+            return 0;
+        }
+
+        const VMInstruction *pCode = _code[_slot];
+        byte length = _length[_slot];
+        int32_t *r = _regs;
+        byte mask = 0;
+        byte pc = 0;
+        // 分岐は前方のみなので命令数はlength以下。検査済みでも念のため数で打ち切る
+        for (byte steps = 0; pc < length && steps < length; ++steps)
+        {
+            const VMInstruction &inst = pCode[pc++];
+            switch (inst.op)
+            {
+            case VM_OP_END:
+                return mask;
+            case VM_OP_LDI:
+                r[inst.a] = (int16_t)(inst.b | (inst.c << 8));
+                break;
+            case VM_OP_MOV:
+                r[inst.a] = r[inst.b];
+                break;
+            case VM_OP_IN:
+                r[inst.a] = inputs[inst.b];
+                break;
+            case VM_OP_OUT:
+                outputs[inst.b] = r[inst.a];
+                mask |= 1 << inst.b;
+                break;
+            // あふれが未定義動作にならないよう符号なしで計算して戻す
+            case VM_OP_ADD:
+                r[inst.a] = (int32_t)((uint32_t)r[inst.b] + (uint32_t)r[inst.c]);
+                break;
+            case VM_OP_SUB:
+                r[inst.a] = (int32_t)((uint32_t)r[inst.b] - (uint32_t)r[inst.c]);
+                break;
+            case VM_OP_MUL:
+                r[inst.a] = (int32_t)((uint32_t)r[inst.b] * (uint32_t)r[inst.c]);
+                break;
+            case VM_OP_DIV:
+                if (r[inst.c] == 0)
+                {
+                    r[inst.a] = 0;
+                }
+                else if (r[inst.c] == -1)
+                {
+                    // INT32_MIN / -1 は割り算にすると例外になる
+                    r[inst.a] = (int32_t)(0u - (uint32_t)r[inst.b]);
+                }
+                else
+                {
+                    r[inst.a] = r[inst.b] / r[inst.c];
+                }
+                break;
+            case VM_OP_MULQ:
+                r[inst.a] = (int32_t)(((int64_t)r[inst.b] * r[inst.c]) >> 12);
+                break;
+            case VM_OP_MIN:
+                r[inst.a] = min(r[inst.b], r[inst.c]);
+                break;
+            case VM_OP_MAX:
+                r[inst.a] = max(r[inst.b], r[inst.c]);
+                break;
+            case VM_OP_AND:
+                r[inst.a] = r[inst.b] & r[inst.c];
+                break;
+            case VM_OP_OR:
+                r[inst.a] = r[inst.b] | r[inst.c];
+                break;
+            case VM_OP_XOR:
+                r[inst.a] = r[inst.b] ^ r[inst.c];
+                break;
+            case VM_OP_SHL:
+                r[inst.a] = (int32_t)((uint32_t)r[inst.b] << (r[inst.c] & 31));
+                break;
+            case VM_OP_SHR:
+                r[inst.a] = r[inst.b] >> (r[inst.c] & 31);
+                break;
+            case VM_OP_ABS:
+                r[inst.a] = r[inst.b] < 0 ? (int32_t)(0u - (uint32_t)r[inst.b]) : r[inst.b];
+                break;
+            case VM_OP_NEG:
+                r[inst.a] = (int32_t)(0u - (uint32_t)r[inst.b]);
+                break;
+            case VM_OP_JMP:
+                pc += inst.c;
+                break;
+            case VM_OP_JZ:
+                pc += r[inst.a] == 0 ? inst.c : 0;
+                break;
+            case VM_OP_JNZ:
+                pc += r[inst.a] != 0 ? inst.c : 0;
+                break;
+            case VM_OP_JLT:
+                pc += r[inst.a] < r[inst.b] ? inst.c : 0;
+                break;
+            case VM_OP_JGE:
+                pc += r[inst.a] >= r[inst.b] ? inst.c : 0;
+                break;
+            case VM_OP_JEQ:
+                pc += r[inst.a] == r[inst.b] ? inst.c : 0;
+                break;
+            case VM_OP_JNE:
+                pc += r[inst.a] != r[inst.b] ? inst.c : 0;
+                break;
+            default:
+                return mask;
+            }
+        }
+        return mask;
+    }
+
+protected:
+    VMInstruction _code[SLOTS][VM_PROGRAM_MAX];
+    byte _length[SLOTS];
+    int32_t _regs[VM_REGS];
+    byte _slot;
+    byte _loading;
+    byte _loadLength;
+
+    void resetRegs()
+    {
+        for (byte i = 0; i < VM_REGS; ++i)
+        {
+            _regs[i] = 0;
+        }
+    }
+
+    /// @brief 命令、レジスタ番号、ポート番号、分岐先を検査する
+    static bool verify(const VMInstruction *pCode, byte length, byte &errorPc)
+    {
+        for (byte pc = 0; pc < length; ++pc)
+        {
+            const VMInstruction &inst = pCode[pc];
+            errorPc = pc;
+            bool regA = inst.a < VM_REGS;
+            bool regB = inst.b < VM_REGS;
+            bool regC = inst.c < VM_REGS;
+            // 分岐先はプログラムの終わりちょうどまで
+            bool target = pc + 1 + inst.c <= length;
+            bool ok = false;
+            switch (inst.op)
+            {
+            case VM_OP_END:
+                ok = true;
+                break;
+            case VM_OP_LDI:
+                ok = regA;
+                break;
+            case VM_OP_MOV:
+            case VM_OP_ABS:
+            case VM_OP_NEG:
+                ok = regA && regB;
+                break;
+            case VM_OP_IN:
+                ok = regA && inst.b < VM_IN_MAX;
+                break;
+            case VM_OP_OUT:
+                ok = regA && inst.b < VM_OUT_MAX;
+                break;
+            case VM_OP_ADD:
+            case VM_OP_SUB:
+            case VM_OP_MUL:
+            case VM_OP_DIV:
+            case VM_OP_MULQ:
+            case VM_OP_MIN:
+            case VM_OP_MAX:
+            case VM_OP_AND:
+            case VM_OP_OR:
+            case VM_OP_XOR:
+            case VM_OP_SHL:
+            case VM_OP_SHR:
+                ok = regA && regB && regC;
+                break;
+            case VM_OP_JMP:
+                ok = target;
+                break;
+            case VM_OP_JZ:
+            case VM_OP_JNZ:
+                ok = regA && target;
+                break;
+            case VM_OP_JLT:
+            case VM_OP_JGE:
+            case VM_OP_JEQ:
+            case VM_OP_JNE:
+                ok = regA && regB && target;
+                break;
+            default:
+                break;
+            }
+
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,224 @@
+/*!
+ * DisplayMirror class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <pico/critical_section.h>
+#include "SerialFrame.hpp"
+#include "Telemetry.hpp"
+
+// SSD1306 128x64のフレームバッファ。U8g2の並び(8ページ x 128列、1バイトが縦8ドットでLSBが上)
+#define MIRROR_FRAME_SIZE (128 * 64 / 8)
+// 途中から見始めても絵が揃うよう、この枚数ごとに差分でなく全体を送る
+#define MIRROR_KEY_INTERVAL 64
+
+// ペイロード [連番][フラグ][分割番号][符号化データ]
+// 1フレームの符号化データは分割番号0から順に送り、最後の分割にMIRROR_FLAG_LASTを立てる
+#define MIRROR_HEADER_SIZE 3
+#define MIRROR_CHUNK_MAX (FRAME_PAYLOAD_MAX - MIRROR_HEADER_SIZE)
+#define MIRROR_FLAG_KEY 0x01    // 0との差分(全体)
+#define MIRROR_FLAG_LAST 0x02   // フレームの最後の分割
+#define MIRROR_FLAG_ROTATE 0x04 // 表示は180度回して見る
+
+// 符号化の最大長。リテラル128バイトごとに長さ1バイトが付く
+#define MIRROR_ENCODED_MAX (MIRROR_FRAME_SIZE + MIRROR_FRAME_SIZE / 128)
+
+/// @brief 画面を前回送った画面とのXORにし、PackBits形式で縮める
+/// 0x00-0x7F: 続くn+1バイトをそのまま 0x80-0xFF: 続く1バイトを(n&0x7F)+1回
+/// @return 符号化後のバイト数
+static uint16_t encodeMirrorRle(const byte *pSrc, uint16_t length, byte *pDst)
+{
+    uint16_t out = 0;
+    uint16_t i = 0;
+    while (i < length)
+    {
+        // 同じ値が3つ以上続けば繰り返しにする
+        uint16_t run = 1;
+        while (i + run < length && run < 128 && pSrc[i + run] == pSrc[i])
+        {
+            run++;
+        }
+        if (run >= 3)
+        {
+            pDst[out++] = 0x80 | (run - 1);
+            pDst[out++] = pSrc[i];
+            i += run;
+            continue;
+        }
+
+        // 次の繰り返しの手前までをそのまま
+        uint16_t start = i;
+        while (i < length && i - start < 128)
+        {
+            if (i + 2 < length && pSrc[i] == pSrc[i + 1] && pSrc[i] == pSrc[i + 2])
+            {
+                break;
+            }
+            i++;
+        }
+        pDst[out++] = i - start - 1;
+        for (uint16_t k = start; k < i; ++k)
+        {
+            pDst[out++] = pSrc[k];
+        }
+    }
+    return out;
+}
+
+/// @brief 表示器の画面をUSBへ写す
+/// 表示コアは描き終えた画面をcapture()で写すだけにし、差分と符号化は送信側のコアで行う
+/// 送信バッファに1フレーム分の空きがなければ送らずに次の機会を待つ(前回送った画面との差分なので崩れない)
+class DisplayMirror
+{
+public:
+    DisplayMirror()
+    {
+        _enable = false;
+        _keyNext = true;
+        _sharedSeq = 0;
+        _sentSeq = 0;
+        _frameSeq = 0;
+        _sinceKey = 0;
+        _sendCount = 0;
+        _byteCount = 0;
+        memset(_shared, 0, sizeof(_shared));
+        memset(_last, 0, sizeof(_last));
+    }
+
+    void init()
+    {
+        critical_section_init(&_critSec);
+    }
+
+    void start()
+    {
+        _keyNext = true;
+        _sendCount = 0;
+        _byteCount = 0;
+        _enable = true;
+    }
+
+    void stop()
+    {
+        _enable = false;
+    }
+
+    bool isEnabled()
+    {
+        return _enable;
+    }
+
+    /// @brief 送ったフレーム数
+    uint32_t getSendCount()
+    {
+        return _sendCount;
+    }
+
+    /// @brief 送った符号化データのバイト数
+    uint32_t getByteCount()
+    {
+        return _byteCount;
+    }
+
+    /// @brief 描き終えた画面を写す。表示コアから
+    void capture(const byte *pBuffer)
+    {
+        if (!_enable)
+        {
+            return;
+        }
+
+        critical_section_enter_blocking(&_critSec);
+        memcpy(_shared, pBuffer, MIRROR_FRAME_SIZE);
+        _sharedSeq++;
+        critical_section_exit(&_critSec);
+    }
+
+    /// @brief 変わっていれば1フレーム送る。送信側のコアから
+    /// @param rotate バッファが表示の向きから180度回っているときtrue
+    /// @return 送ったらtrue
+    bool send(Telemetry &telemetry, bool rotate)
+    {
+        if (!_enable || _sharedSeq == _sentSeq)
+        {
+            return false;
+        }
+
+        critical_section_enter_blocking(&_critSec);
+        memcpy(_work, _shared, MIRROR_FRAME_SIZE);
+        uint32_t seq = _sharedSeq;
+        critical_section_exit(&_critSec);
+
+        bool key = _keyNext || _sinceKey >= MIRROR_KEY_INTERVAL;
+        bool changed = key;
+        for (uint16_t i = 0; i < MIRROR_FRAME_SIZE; ++i)
+        {
+            _delta[i] = key ? _work[i] : _work[i] ^ _last[i];
+            if (_delta[i] != 0)
+            {
+                changed = true;
+            }
+        }
+        if (!changed)
+        {
+            _sentSeq = seq;
+            return false;
+        }
+
+        uint16_t length = encodeMirrorRle(_delta, MIRROR_FRAME_SIZE, _encoded);
+        byte chunks = (length + MIRROR_CHUNK_MAX - 1) / MIRROR_CHUNK_MAX;
+        uint16_t need = length + chunks * (FRAME_HEADER_SIZE + FRAME_FOOTER_SIZE + MIRROR_HEADER_SIZE);
+        if (telemetry.getFree() < need)
+        {
+            return false;
+        }
+
+        byte payload[FRAME_PAYLOAD_MAX];
+        byte flags = (key ? MIRROR_FLAG_KEY : 0) | (rotate ? MIRROR_FLAG_ROTATE : 0);
+        for (byte c = 0; c < chunks; ++c)
+        {
+            uint16_t offset = c * MIRROR_CHUNK_MAX;
+            byte count = min(length - offset, MIRROR_CHUNK_MAX);
+            payload[0] = _frameSeq;
+            payload[1] = flags | (c == chunks - 1 ? MIRROR_FLAG_LAST : 0);
+            payload[2] = c;
+            memcpy(&payload[MIRROR_HEADER_SIZE], &_encoded[offset], count);
+            if (!telemetry.pushFrame(FRAME_TYPE_DISPLAY_MIRROR, payload, MIRROR_HEADER_SIZE + count))
+            {
+                // 途中まで送った分は受け側で捨てられる。次は全体から
+                _keyNext = true;
+                return false;
+            }
+        }
+
+        memcpy(_last, _work, MIRROR_FRAME_SIZE);
+        _sentSeq = seq;
+        _frameSeq++;
+        _sinceKey = key ? 0 : _sinceKey + 1;
+        _keyNext = false;
+        _sendCount++;
+        _byteCount += length;
+        return true;
+    }
+
+protected:
+    critical_section_t _critSec;
+    volatile bool _enable;
+    bool _keyNext;
+    volatile uint32_t _sharedSeq;
+    uint32_t _sentSeq;
+    byte _frameSeq;
+    byte _sinceKey;
+    uint32_t _sendCount;
+    uint32_t _byteCount;
+    byte _shared[MIRROR_FRAME_SIZE];
+    byte _last[MIRROR_FRAME_SIZE];
+    byte _work[MIRROR_FRAME_SIZE];
+    byte _delta[MIRROR_FRAME_SIZE];
+    byte _encoded[MIRROR_ENCODED_MAX];
+};
@@ -11,6 +11,8 @@
 #include <Arduino.h>
 #include <U8g2lib.h>
 #include "SmoothAnalogRead.hpp"
+#include "WaveMeasure.hpp"
+#include "ProbeBus.hpp"
 
 #define DATA_BIT 12
 #define DATA_MAX_VALUE 4095
@@ -27,6 +29,43 @@
 #define FRM_CTR (FRM_TOP + ((FRM_BTM - FRM_TOP) >> 1))
 #define FRM_LEN 4
 
+// トリガ
+#define TRIG_MODE_AUTO 0
+#define TRIG_MODE_NORMAL 1
+#define TRIG_MODE_SINGLE 2
+#define TRIG_EDGE_RISE 0
+#define TRIG_EDGE_FALL 1
+#define TRIG_LEVEL_AUTO -1
+#define TRIG_PRE_DEFAULT 10
+// 1回の表示で取り込みに使う時間。遅い時間軸では取り込みの途中で返し、次の表示で続ける
+// AUTOはDATA_BUF_MAXサンプル待っても来なければ強制表示
+#define TRIG_BUDGET_MICROS 20000
+
+#define TRIG_STATE_WAIT 0
+#define TRIG_STATE_TRIG 1
+#define TRIG_STATE_AUTO 2
+#define TRIG_STATE_STOP 3
+
+// 表示モード
+#define DISP_MODE_NORMAL 0
+#define DISP_MODE_AVERAGE 1
+#define DISP_MODE_PERSIST 2
+// 平均の累積値は小数部8bitの固定小数点
+#define AVG_FRAC_BIT 8
+#define AVG_SHIFT_MAX 6
+// 残光はピクセル列ごと、枠内の縦ピクセルごとにヒット数を持つ
+#define PERSIST_HEIGHT (FRM_BTM - FRM_TOP - 1)
+#define PERSIST_HIT 255
+
+// 深いキャプチャ。1回の取り込みを長く取り、ポットでズームとパンをする
+#define DISP_MODE_DEEP 3
+#define DEEP_BUF_BIT 14
+#define DEEP_BUF_MAX (1 << DEEP_BUF_BIT)
+// 最小/最大のピラミッドは8サンプル単位から。各段は前の段の2つ分をまとめる
+#define DEEP_LEVEL_MIN 3
+#define DEEP_PYRAMID_SIZE ((DEEP_BUF_MAX >> (DEEP_LEVEL_MIN - 1)) - 1)
+#define DEEP_ZOOM_STEPS 15
+
 class EzOscilloscope
 {
 public:
@@ -48,10 +87,149 @@ public:
         _dataAve = 0;
         _rangeMax = DATA_MAX_VALUE;
         _rangeMin = 0;
-        _triggerPoint = 10;
+        _triggerPoint = TRIG_PRE_DEFAULT;
         _left = 0;
         _top = dispOffsetTop;
+        _trigMode = TRIG_MODE_AUTO;
+        _trigEdge = TRIG_EDGE_RISE;
+        _trigLevel = TRIG_LEVEL_AUTO;
+        _autoLevel = DATA_MAX_VALUE >> 1;
+        _preTrigger = TRIG_PRE_DEFAULT;
+        _holdoff = 0;
+        _holdoffCount = 0;
+        _waitCount = 0;
+        _capturing = false;
+        _sampleMicros = 0;
+        _trigState = TRIG_STATE_WAIT;
+        _armRequest = true;
+        _dispMode = DISP_MODE_NORMAL;
+        _avgShift = 3;
+        _persistShift = 3;
+        _resetRequest = false;
+        _deepReady = false;
+        _deepIndex = 0;
+        _deepNext = 0;
+        _deepTrigger = 0;
+        _deepStart = 0;
+        _deepSpan = 1;
+        _deepZoom = DATA_MAX_VALUE;
+        _deepPan = 0;
+        _measureSeq = 0;
+        _measureLevel = DATA_MAX_VALUE >> 1;
+        _measureHysteresis = 64;
+        memset(&_result, 0, sizeof(_result));
+        _pProbe = NULL;
+        _probeA = PROBE_OFF;
+        _probeB = PROBE_OFF;
+        _sampleB = 0;
+        memset(_ringBuffB, 0, sizeof(_ringBuffB));
         clearDataBuff();
+        resetDisplay();
+        calcScale();
+    }
+
+    /// @brief 表示モード設定
+    /// @param mode DISP_MODE_NORMAL/AVERAGE/PERSIST
+    /// @param avgShift 平均フレーム数（2^avgShift）
+    /// @param persistShift 残光の減衰（1フレームで1/2^persistShiftずつ減る）
+    void setDisplay(byte mode, byte avgShift, byte persistShift)
+    {
+        avgShift = constrain(avgShift, 1, AVG_SHIFT_MAX);
+        persistShift = constrain(persistShift, 1, AVG_SHIFT_MAX);
+        if (mode != _dispMode)
+        {
+            _resetRequest = true;
+            _armRequest = true;
+        }
+        _dispMode = mode;
+        _avgShift = avgShift;
+        _persistShift = persistShift;
+    }
+
+    /// @brief トリガ設定
+    /// @param mode TRIG_MODE_AUTO/NORMAL/SINGLE
+    /// @param edge TRIG_EDGE_RISE/FALL
+    /// @param level トリガレベル。TRIG_LEVEL_AUTOなら直前の波形の中間
+    /// @param preTrigger トリガ点より前に表示するサンプル数
+    /// @param holdoff トリガ後、次のトリガを受け付けないサンプル数
+    void setTrigger(byte mode, byte edge, int16_t level, byte preTrigger, uint16_t holdoff)
+    {
+        if (mode != _trigMode)
+        {
+            _armRequest = true;
+        }
+        _trigMode = mode;
+        _trigEdge = edge;
+        _trigLevel = level;
+        _preTrigger = min(preTrigger, (byte)(DATA_BUF_HALF - 1));
+        _holdoff = holdoff;
+    }
+
+    void attachProbe(ProbeBus *pProbe)
+    {
+        _pProbe = pProbe;
+    }
+
+    /// @brief 入力の選択。表示コアから呼ぶこと
+    /// @param a PROBE_*。PROBE_OFFならCVピンを直接読む
+    /// @param b 2本目の波形。aがプローブのときだけ使う
+    void setProbe(byte a, byte b)
+    {
+        if (_pProbe == NULL || (a == _probeA && b == _probeB))
+        {
+            return;
+        }
+        _probeA = a;
+        _probeB = b;
+        _pProbe->select(a, b);
+        arm();
+    }
+
+    /// @brief 深いキャプチャの表示範囲。ポットの値(12bit)をそのまま渡す
+    /// @param zoom 1列あたりのサンプル数を段階で選ぶ
+    /// @param pan 表示の開始位置
+    void setDeepView(uint16_t zoom, uint16_t pan)
+    {
+        _deepZoom = zoom;
+        _deepPan = pan;
+    }
+
+    /// @brief 最新の測定結果を取る。別のコアから呼んでよい
+    /// @param result
+    /// @param seq 前回取ったときの番号。新しい結果があれば更新する
+    /// @return 前回から新しい結果があればtrue
+    bool getMeasure(ScopeMeasure &result, uint32_t &seq)
+    {
+        uint32_t before;
+        uint32_t after;
+        do
+        {
+            before = _measureSeq;
+            __sync_synchronize();
+            result = _result;
+            __sync_synchronize();
+            after = _measureSeq;
+        } while ((before & 1) || before != after);
+
+        if (before == seq)
+        {
+            return false;
+        }
+        seq = before;
+        return true;
+    }
+
+    /// @brief 深いキャプチャの取り込みの途中。表示タスクは間を空けずにplay()を呼び直すこと
+    bool isAcquiring()
+    {
+        return _dispMode == DISP_MODE_DEEP && _deepIndex > 0;
+    }
+
+    /// @brief SINGLEで止まっている取り込みを再開
+    void arm()
+    {
+        _armRequest = true;
+        _resetRequest = true;
     }
 
     void play()
@@ -62,35 +240,98 @@ public:
             drawLastIndex = readDataLong();
             calcDataLong();
         }
+        else if (_dispMode == DISP_MODE_DEEP)
+        {
+            if (readDeep())
+            {
+                buildPyramid();
+            }
+            else if (isAcquiring())
+            {
+                // 描いている間は取り込めないので、埋まるまでは描かずに戻る
+                return;
+            }
+            calcDeepView();
+        }
         else
         {
-            readData();
-            calcData();
+            if (_resetRequest)
+            {
+                _resetRequest = false;
+                resetDisplay();
+            }
+
+            if (readData())
+            {
+                if (_dispMode == DISP_MODE_AVERAGE)
+                {
+                    // 位相が揃っていない強制表示は平均すると平らになるので、そのまま出して累積をやり直す
+                    if (_trigState == TRIG_STATE_AUTO)
+                    {
+                        _avgCount = 0;
+                    }
+                    else
+                    {
+                        updateAverage();
+                    }
+                }
+                calcData();
+                if (_dispMode == DISP_MODE_PERSIST)
+                {
+                    updatePersist();
+                }
+            }
         }
 
         _pU8g2->clearBuffer();
         drawFrame();
-        drawData(drawLastIndex);
+        if (_dispMode == DISP_MODE_PERSIST && _delay < SCAN_DELAY_MAX)
+        {
+            drawPersist();
+        }
+        else if (_dispMode == DISP_MODE_DEEP && _delay < SCAN_DELAY_MAX)
+        {
+            drawDeep();
+        }
+        else
+        {
+            drawData(drawLastIndex);
+        }
+        if (isDual() && _dispMode != DISP_MODE_DEEP)
+        {
+            drawDataB(drawLastIndex);
+        }
         drawString();
+        if (_delay < SCAN_DELAY_MAX)
+        {
+            drawMeasure();
+        }
         _pU8g2->sendBuffer();
     }
 
     void incDelay()
     {
         _delay = constrainCyclic((int)(_delay << 1), 25, SCAN_DELAY_MAX);
+        arm();
     }
 
     void decDelay()
     {
         _delay = constrainCyclic((int)(_delay >> 1), 25, SCAN_DELAY_MAX);
+        arm();
     }
 
 protected:
     float _convertVoltCoff = DATA_MAX_VOLT / DATA_MAX_VALUE_F;
     U8G2 *_pU8g2;
     SmoothAnalogRead *_pCv;
+    ProbeBus *_pProbe;
+    byte _probeA;
+    byte _probeB;
+    int16_t _sampleB;
     int16_t _delay;
     int16_t _dataBuff[DATA_BUF_MAX];
+    int16_t _dataBuffB[DATA_BUF_MAX]; // プローブの2本目
     int16_t _dataAve;
     int16_t _rangeMax;
     int16_t _rangeMin;
@@ -98,7 +339,66 @@ protected:
     byte _left;
     byte _top;
 
-private:
+    // トリガ。取り込みは_ringBuffへ連続して行い、確定した表示範囲を_dataBuffへ移す
+    int16_t _ringBuff[DATA_BUF_MAX];
+    int16_t _ringBuffB[DATA_BUF_MAX];
+    byte _ringIndex;
+    uint16_t _ringCount;
+    int16_t _postCount;
+    uint16_t _holdoffCount;
+    uint16_t _waitCount;
+    bool _capturing;        // 取り込みの途中で返した
+    uint32_t _sampleMicros; // 最後にサンプルを取った時刻
+    int16_t _lastSample;
+    byte _trigMode;
+    byte _trigEdge;
+    int16_t _trigLevel;
+    int16_t _autoLevel;
+    byte _preTrigger;
+    uint16_t _holdoff;
+    byte _trigState;
+    volatile bool _armRequest;
+
+    // 平均と残光
+    byte _dispMode;
+    byte _avgShift;
+    byte _avgCount;
+    int32_t _avgAcc[DATA_BUF_HALF];
+    byte _persistShift;
+    int16_t _persistMin;
+    int16_t _persistMax;
+    byte _persist[PERSIST_HEIGHT][DATA_BUF_HALF];
+    volatile bool _resetRequest;
+
+    // 深いキャプチャ。_deepMin/_deepMaxはDEEP_LEVEL_MIN段から1段ずつ詰めて並べる
+    int16_t _deepBuff[DEEP_BUF_MAX];
+    int16_t _deepMin[DEEP_PYRAMID_SIZE];
+    int16_t _deepMax[DEEP_PYRAMID_SIZE];
+    bool _deepReady;
+    uint16_t _deepIndex; // 取り込み中の位置。0ならトリガ待ち
+    uint32_t _deepNext;  // 次のサンプルの時刻
+    uint16_t _deepTrigger;
+    uint16_t _deepStart;
+    byte _deepSpan;
+    volatile uint16_t _deepZoom;
+    volatile uint16_t _deepPan;
+
+    // 測定。結果は表示コアが書き、制御コアがテレメトリ用に読むので番号で書き込み中を判別する
+    WaveMeasure _measure;
+    ScopeMeasure _result;
+    volatile uint32_t _measureSeq;
+    int16_t _measureLevel;
+    int16_t _measureHysteresis;
+
+    // 縦方向の変換係数（16bit固定小数点）。フレームごとに1回計算する
+    int32_t _scaleY;
+
+    // タイルバッファへの直接描画
+    byte *_pTile;
+    byte _tileWidth;
+    bool _tileRotate;
+    byte _tileColor;
+
     template <typename su = uint8_t>
     su constrainCyclic(su value, su min, su max)
     {
@@ -114,13 +414,74 @@ private:
         for (byte i = 0; i < DATA_BUF_MAX; ++i)
         {
             _dataBuff[i] = 0;
+            _dataBuffB[i] = 0;
         }
     }
 
+    bool isProbe()
+    {
+        return _pProbe != NULL && _probeA < PROBE_SIGNAL_MAX;
+    }
+
+    bool isDual()
+    {
+        return isProbe() && _probeB < PROBE_SIGNAL_MAX;
+    }
+
+    /// @brief 次の1サンプル。プローブを選んでいればバスから、なければCVピンから
+    /// プローブは制御周期ごとにしか来ないので、_delayは制御周期何回ごとに取るかに読み替える
+    /// @param wait falseなら待たずに読む(取り込みの最初の1サンプル)
+    int16_t readSample(bool wait)
+    {
+        if (!isProbe())
+        {
+            if (wait)
+            {
+                delayMicroseconds(_delay);
+            }
+            return _pCv->analogRead(false);
+        }
+
+        int16_t value = _lastSample;
+        uint16_t step = wait ? max(_delay / PROBE_PERIOD_MICROS, 1) : 1;
+        for (uint16_t i = 0; i < step; ++i)
+        {
+            ProbeSample sample;
+            // 制御が止まっていたら前の値のまま
+            uint32_t start = micros();
+            while (!_pProbe->pop(sample))
+            {
+                if (micros() - start >= PROBE_PERIOD_MICROS * 4)
+                {
+                    return value;
+                }
+                delayMicroseconds(PROBE_PERIOD_MICROS >> 4);
+            }
+            value = sample.a;
+            _sampleB = sample.b;
+        }
+        return value;
+    }
+
+    /// @brief 溜まっているプローブのうち最新の値。なければ前の値
+    int16_t readProbeLatest()
+    {
+        int16_t value = _lastSample;
+        ProbeSample sample;
+        while (_pProbe->pop(sample))
+        {
+            value = sample.a;
+            _sampleB = sample.b;
+        }
+        _lastSample = value;
+        return value;
+    }
+
     byte readDataLong()
     {
         static byte index = 0;
-        _dataBuff[index] = _pCv->analogRead(false);
+        _dataBuff[index] = isProbe() ? readProbeLatest() : _pCv->analogRead(false);
+        _dataBuffB[index] = _sampleB;
         index++;
         // 線描画の終端の関係で+1
         if (index >= DATA_BUF_HALF)
@@ -146,15 +507,265 @@ private:
 
         _dataAve = sum / DATA_BUF_MAX;
 
-        _triggerPoint = 10;
+        _triggerPoint = 0;
+        calcScale();
     }
 
-    void readData()
+    /// @brief 取り込み開始。プリトリガ分を貯め直す
+    /// ホールドオフとAUTOの待ちは取り込みをまたいで数え続ける
+    void resetTrigger()
     {
-        for (byte i = 0; i < DATA_BUF_MAX; ++i)
+        _ringIndex = 0;
+        _ringCount = 0;
+        _postCount = -1;
+    }
+
+    /// @brief 前回のサンプルから空いた時間の分だけホールドオフを進める
+    void elapseHoldoff()
+    {
+        uint32_t skipped = (micros() - _sampleMicros) / max(_delay, (int16_t)1);
+        _holdoffCount = skipped < _holdoffCount ? _holdoffCount - skipped : 0;
+    }
+
+    bool isTriggerEdge(int16_t prev, int16_t value)
+    {
+        int16_t level = _trigLevel == TRIG_LEVEL_AUTO ? _autoLevel : _trigLevel;
+        if (_trigEdge == TRIG_EDGE_FALL)
         {
-            _dataBuff[i] = _pCv->analogRead(false);
-            delayMicroseconds(_delay);
+            return prev >= level && value < level;
+        }
+        return prev < level && value >= level;
+    }
+
+    /// @brief 最新DATA_BUF_HALF個を表示用バッファへ移す
+    void captureWindow()
+    {
+        byte index = (_ringIndex + DATA_BUF_MAX - DATA_BUF_HALF) % DATA_BUF_MAX;
+        for (byte i = 0; i < DATA_BUF_HALF; ++i)
+        {
+            _dataBuff[i] = _ringBuff[index];
+            _dataBuffB[i] = _ringBuffB[index];
+            index = index + 1 >= DATA_BUF_MAX ? 0 : index + 1;
+        }
+        _triggerPoint = _preTrigger;
+    }
+
+    /// @brief 1サンプル入力してトリガ判定
+    /// @param value
+    /// @return 表示範囲が確定したらtrue
+    bool putSample(int16_t value)
+    {
+        _ringBuff[_ringIndex] = value;
+        _ringIndex = _ringIndex + 1 >= DATA_BUF_MAX ? 0 : _ringIndex + 1;
+        if (_ringCount < DATA_BUF_MAX)
+        {
+            _ringCount++;
+        }
+        if (_holdoffCount > 0)
+        {
+            _holdoffCount--;
+        }
+
+        int16_t prev = _lastSample;
+        _lastSample = value;
+
+        // トリガ後の残りを取り込み中
+        if (_postCount > 0)
+        {
+            _postCount--;
+            if (_postCount == 0)
+            {
+                captureWindow();
+                return true;
+            }
+            return false;
+        }
+
+        // プリトリガ分が貯まるまではトリガしない
+        if (_ringCount <= _preTrigger || _holdoffCount > 0)
+        {
+            return false;
+        }
+
+        if (isTriggerEdge(prev, value))
+        {
+            _postCount = DATA_BUF_HALF - 1 - _preTrigger;
+            _trigState = TRIG_STATE_TRIG;
+            _holdoffCount = _holdoff;
+            _waitCount = 0;
+            if (_postCount == 0)
+            {
+                captureWindow();
+                return true;
+            }
+            return false;
+        }
+
+        // AUTOは一定時間トリガがなければ最新の波形をそのまま出す
+        _waitCount++;
+        if (_trigMode == TRIG_MODE_AUTO && _waitCount >= DATA_BUF_MAX && _ringCount >= DATA_BUF_HALF)
+        {
+            _trigState = TRIG_STATE_AUTO;
+            _waitCount = 0;
+            captureWindow();
+            return true;
+        }
+
+        return false;
+    }
+
+    /// @brief 表示範囲が確定した。SINGLEならここで止める
+    bool completeCapture()
+    {
+        if (_trigMode == TRIG_MODE_SINGLE && _trigState == TRIG_STATE_TRIG)
+        {
+            _trigState = TRIG_STATE_STOP;
+        }
+        _capturing = false;
+        endMeasure();
+        return true;
+    }
+
+    /// @brief サンプリングしながらトリガを待つ
+    /// 1回にTRIG_BUDGET_MICROSまで取り込む。1画面分が収まらない遅い時間軸では、取り込みの途中で返して次の表示で続ける
+    /// @return 新しい波形が確定したらtrue。NORMALでトリガが来ない、SINGLEで停止中、取り込みの途中ならfalse
+    bool readData()
+    {
+        if (_armRequest)
+        {
+            _armRequest = false;
+            _trigState = TRIG_STATE_WAIT;
+            _capturing = false;
+            _holdoffCount = 0;
+            _waitCount = 0;
+        }
+        else if (_trigState == TRIG_STATE_STOP)
+        {
+            return false;
+        }
+
+        beginMeasure();
+        bool fits = (uint32_t)_delay * DATA_BUF_HALF <= TRIG_BUDGET_MICROS;
+        if (_capturing && !fits)
+        {
+            // 描画していた間は取り込めないので、時間軸がずれないよう直前の値で埋めて続ける
+            uint32_t missed = min((micros() - _sampleMicros) / _delay, (uint32_t)DATA_BUF_MAX);
+            for (uint32_t i = 1; i < missed; ++i)
+            {
+                _ringBuffB[_ringIndex] = _sampleB;
+                if (putSample(_lastSample))
+                {
+                    return completeCapture();
+                }
+            }
+        }
+        else
+        {
+            // フレーム間は取り込みが途切れるので、プリトリガ分から貯め直す
+            // プローブも描画中に溜まった分は捨てて今から取る
+            elapseHoldoff();
+            resetTrigger();
+            if (isProbe())
+            {
+                _pProbe->flush();
+            }
+            _lastSample = readSample(false);
+            _sampleMicros = micros();
+            _measure.put(_lastSample);
+        }
+        _capturing = true;
+
+        // 速い時間軸ではトリガ後の残りを取り切る(長くても予算1回分)
+        uint32_t start = micros();
+        while (micros() - start < TRIG_BUDGET_MICROS || (fits && _postCount > 0))
+        {
+            int16_t value = readSample(true);
+            _sampleMicros = micros();
+            _measure.put(value);
+            _ringBuffB[_ringIndex] = _sampleB;
+            if (putSample(value))
+            {
+                return completeCapture();
+            }
+        }
+
+        if (_postCount < 0)
+        {
+            _trigState = TRIG_STATE_WAIT;
+        }
+        endMeasure();
+        return false;
+    }
+
+    /// @brief 平均と残光の累積をクリア
+    void resetDisplay()
+    {
+        _avgCount = 0;
+        _persistMin = DATA_MAX_VALUE;
+        _persistMax = 0;
+        memset(_persist, 0, sizeof(_persist));
+    }
+
+    /// @brief トリガ位置を揃えたフレームを指数移動平均で累積し、_dataBuffを平均値に置き換える
+    /// 累積が2^avgShiftフレームに満たないうちは重みを大きくして立ち上がりを早める
+    void updateAverage()
+    {
+        byte shift = min(_avgCount, _avgShift);
+        for (byte i = 0; i < DATA_BUF_HALF; ++i)
+        {
+            int32_t value = (int32_t)_dataBuff[i] << AVG_FRAC_BIT;
+            _avgAcc[i] += (value - _avgAcc[i]) >> shift;
+            _dataBuff[i] = (_avgAcc[i] + (1 << (AVG_FRAC_BIT - 1))) >> AVG_FRAC_BIT;
+        }
+
+        if (_avgCount < _avgShift)
+        {
+            _avgCount++;
+        }
+    }
+
+    /// @brief 縦位置（枠内の行）に変換
+    byte toPersistRow(int16_t value)
+    {
+        return toY(value) - (FRM_TOP + 1);
+    }
+
+    /// @brief 残光のヒット数を減衰させてから今回の波形を加える
+    /// 表示範囲は広がる方向にだけ追従し、広がったときは累積をクリアする
+    void updatePersist()
+    {
+        if (_rangeMin < _persistMin || _rangeMax > _persistMax)
+        {
+            _persistMin = min(_rangeMin, _persistMin);
+            _persistMax = max(_rangeMax, _persistMax);
+            memset(_persist, 0, sizeof(_persist));
+        }
+        _rangeMin = _persistMin;
+        _rangeMax = _persistMax;
+        calcScale();
+
+        byte *pHit = &_persist[0][0];
+        for (uint16_t i = 0; i < sizeof(_persist); ++i)
+        {
+            byte hit = pHit[i];
+            if (hit > 0)
+            {
+                pHit[i] = hit - (hit >> _persistShift) - 1;
+            }
+        }
+
+        // 1列ごとに直前のサンプルからの縦の範囲をヒットとする
+        byte rowOld = toPersistRow(_dataBuff[0]);
+        for (byte x = 0; x < DATA_BUF_HALF; ++x)
+        {
+            byte row = toPersistRow(_dataBuff[x]);
+            byte rowMin = min(row, rowOld);
+            byte rowMax = max(row, rowOld);
+            for (byte y = rowMin; y <= rowMax; ++y)
+            {
+                _persist[y][x] = PERSIST_HIT;
+            }
+            rowOld = row;
         }
     }
 
@@ -164,7 +775,7 @@ private:
         int16_t dataMax = 0;
         int16_t tmp = 0;
         long sum = 0;
-        for (byte i = 0; i < DATA_BUF_MAX; ++i)
+        for (byte i = 0; i < DATA_BUF_HALF; ++i)
         {
             tmp = _dataBuff[i];
             sum += tmp;
@@ -172,27 +783,32 @@ private:
             dataMax = max(dataMax, tmp);
         }
 
-        _dataAve = sum / DATA_BUF_MAX;
+        // 2本目も同じ縦軸に収める
+        if (isDual())
+        {
+            for (byte i = 0; i < DATA_BUF_HALF; ++i)
+            {
+                dataMin = min(dataMin, _dataBuffB[i]);
+                dataMax = max(dataMax, _dataBuffB[i]);
+            }
+        }
 
+        _dataAve = sum / DATA_BUF_HALF;
+        setRange(dataMin, dataMax);
+    }
+
+    /// @brief 波形の最小/最大から表示範囲とトリガの自動レベルを決める
+    void setRange(int16_t dataMin, int16_t dataMax)
+    {
         // データ表示範囲を最大±10拡大
         _rangeMin = dataMin - 20;
         _rangeMin = max((_rangeMin / 10) * 10, 0);
         _rangeMax = dataMax + 20;
         _rangeMax = min((_rangeMax / 10) * 10, DATA_MAX_VALUE);
 
-        // 9～109の範囲でデータ表示範囲値からの立ち上がりを探す
-        // なければ10
-        _triggerPoint = 10;
-        long triggerRange = (dataMax + dataMin) >> 1;
-        for (byte i = 9; i < 110; ++i)
-        {
-            if ((_dataBuff[i - 1] < triggerRange) &&
-                (_dataBuff[i] >= triggerRange))
-            {
-                _triggerPoint = i;
-                break;
-            }
-        }
+        // レベル自動時は次の取り込みでこの波形の中間を使う
+        _autoLevel = (dataMax + dataMin) >> 1;
+        calcScale();
     }
 
     void drawFrame()
@@ -212,7 +828,16 @@ private:
             _pU8g2->drawHLine(_left + x, _top + FRM_CTR, 2);
         }
 
-        _pU8g2->drawVLine(_left + FRM_LFT + 10, _top + FRM_CTR - (2), 4);
+        // トリガ位置とレベル
+        if (_delay < SCAN_DELAY_MAX && _triggerPoint >= 0)
+        {
+            _pU8g2->drawVLine(_left + FRM_LFT + 1 + _triggerPoint, _top + FRM_CTR - (2), 4);
+            int16_t level = _trigLevel == TRIG_LEVEL_AUTO ? _autoLevel : _trigLevel;
+            if (level > _rangeMin && level < _rangeMax)
+            {
+                _pU8g2->drawHLine(_left + FRM_RGT - 2, _top + toY(level), 2);
+            }
+        }
     }
 
     void drawString()
@@ -223,6 +848,24 @@ private:
         sprintf(chrBuff, "%d", _delay);
         _pU8g2->drawStr(_left, _top, chrBuff);
 
+        if (_dispMode == DISP_MODE_DEEP && _delay < SCAN_DELAY_MAX && _deepReady)
+        {
+            // 1列あたりのサンプル数
+            sprintf(chrBuff, "x%d", _deepSpan);
+            _pU8g2->drawStr(_left + 40, _top, chrBuff);
+        }
+        else if (_delay < SCAN_DELAY_MAX)
+        {
+            static const char *trigStateNames[] = {"WAIT", "TRIG", "AUTO", "STOP"};
+            _pU8g2->drawStr(_left + 40, _top, trigStateNames[_trigState]);
+        }
+
+        // 深いキャプチャは常にCVピンから
+        if (isProbe() && _dispMode != DISP_MODE_DEEP)
+        {
+            _pU8g2->drawStr(_left + 70, _top, probeNames[_probeA]);
+        }
+
         tmp = _dataAve * _convertVoltCoff;
         sprintf(chrBuff, "%4.2f", tmp);
         _pU8g2->drawStr(_left + 105, _top, chrBuff);
@@ -240,16 +883,508 @@ private:
         _pU8g2->drawStr(_left, _top + FRM_BTM - 8, chrBuff);
     }
 
+    /// @brief 測定の開始。判定レベルは前回の取り込みの中間、ヒステリシスは振幅の1/8
+    void beginMeasure()
+    {
+        _measure.begin(_measureLevel, _measureHysteresis);
+    }
+
+    /// @brief 測定を終えて結果を公開する
+    void endMeasure()
+    {
+        ScopeMeasure result;
+        _measure.end(result);
+        if (result.samples > 0)
+        {
+            _measureLevel = (_measure.getMin() + _measure.getMax()) >> 1;
+            _measureHysteresis = max(result.vpp >> 3, 8);
+        }
+
+        _measureSeq = _measureSeq + 1;
+        __sync_synchronize();
+        _result = result;
+        __sync_synchronize();
+        _measureSeq = _measureSeq + 1;
+    }
+
+    /// @brief ADC値を電圧の文字列にする(x.xx)
+    void formatVolt(char *pBuff, uint16_t value)
+    {
+        uint32_t mv = (uint32_t)value * (uint32_t)(DATA_MAX_VOLT * 1000) / DATA_MAX_VALUE;
+        sprintf(pBuff, "%lu.%02lu", (unsigned long)(mv / 1000), (unsigned long)(mv % 1000 / 10));
+    }
+
+    /// @brief 周波数と周期の文字列。桁に合わせて単位を変える
+    void formatFreq(char *pBuff, uint32_t milliHz)
+    {
+        if (milliHz >= 1000000)
+            sprintf(pBuff, "%lu.%02lukHz", (unsigned long)(milliHz / 1000000), (unsigned long)(milliHz % 1000000 / 10000));
+        else if (milliHz >= 100000)
+            sprintf(pBuff, "%lu.%luHz", (unsigned long)(milliHz / 1000), (unsigned long)(milliHz % 1000 / 100));
+        else
+            sprintf(pBuff, "%lu.%02luHz", (unsigned long)(milliHz / 1000), (unsigned long)(milliHz % 1000 / 10));
+    }
+
+    void formatPeriod(char *pBuff, uint32_t ns)
+    {
+        if (ns >= 1000000000)
+            sprintf(pBuff, "%lu.%02lus", (unsigned long)(ns / 1000000000), (unsigned long)(ns % 1000000000 / 10000000));
+        else if (ns >= 1000000)
+            sprintf(pBuff, "%lu.%02lums", (unsigned long)(ns / 1000000), (unsigned long)(ns % 1000000 / 10000));
+        else
+            sprintf(pBuff, "%lu.%luus", (unsigned long)(ns / 1000), (unsigned long)(ns % 1000 / 100));
+    }
+
+    /// @brief 測定値の表示。波形の枠の外(上、なければ下)の2行に出す
+    void drawMeasure()
+    {
+        static char chrBuff[26] = {0};
+        static char valueBuff[3][12] = {{0}};
+        byte top = _top >= 16 ? _top - 16 : _top + FRM_BTM + 1;
+        const ScopeMeasure &result = _result;
+
+        if (result.periodNs > 0)
+        {
+            formatFreq(valueBuff[0], result.freqMilli);
+            formatPeriod(valueBuff[1], result.periodNs);
+        }
+        else
+        {
+            strcpy(valueBuff[0], "---");
+            strcpy(valueBuff[1], "---");
+        }
+        sprintf(chrBuff, "f %s", valueBuff[0]);
+        _pU8g2->drawStr(_left, top, chrBuff);
+        sprintf(chrBuff, "T %s", valueBuff[1]);
+        _pU8g2->drawStr(_left + 65, top, chrBuff);
+
+        formatVolt(valueBuff[0], result.vpp);
+        formatVolt(valueBuff[1], result.rms);
+        if (result.periodNs > 0)
+            sprintf(valueBuff[2], "%d.%d%%", result.duty / 10, result.duty % 10);
+        else
+            strcpy(valueBuff[2], "---");
+        sprintf(chrBuff, "pp%s rms%s d%s", valueBuff[0], valueBuff[1], valueBuff[2]);
+        _pU8g2->drawStr(_left, top + 8, chrBuff);
+    }
+
+    /// @brief 表示範囲から縦方向の変換係数を求める
+    void calcScale()
+    {
+        int32_t range = _rangeMax - _rangeMin;
+        _scaleY = range > 0 ? (((int32_t)(FRM_BTM - FRM_TOP - 2) << 16) + range - 1) / range : 0;
+    }
+
+    /// @brief 値を枠内の縦位置へ変換
+    byte toY(int16_t value)
+    {
+        value = constrain(value, _rangeMin, _rangeMax);
+        return FRM_BTM - 1 - (((int32_t)(value - _rangeMin) * _scaleY) >> 16);
+    }
+
+    static byte reverseBits(byte value)
+    {
+        value = ((value & 0xF0) >> 4) | ((value & 0x0F) << 4);
+        value = ((value & 0xCC) >> 2) | ((value & 0x33) << 2);
+        value = ((value & 0xAA) >> 1) | ((value & 0x55) << 1);
+        return value;
+    }
+
+    /// @brief タイルバッファへの直接描画の準備。フルバッファかつR0/R2のときだけ使える
+    /// @return 直接描画できればtrue
+    bool beginDirect()
+    {
+        u8g2_t *pU8g2 = _pU8g2->getU8g2();
+        _pTile = _pU8g2->getBufferPtr();
+        _tileWidth = _pU8g2->getBufferTileWidth() << 3;
+        _tileRotate = pU8g2->cb == U8G2_R2;
+        _tileColor = pU8g2->draw_color;
+        return _pU8g2->getBufferTileHeight() == 8 && (pU8g2->cb == U8G2_R0 || pU8g2->cb == U8G2_R2);
+    }
+
+    /// @brief 表示座標のx列、pageページの8ピクセル(bit0が上)を描く。描画色はU8g2の設定に従う
+    void drawColumnByte(byte x, byte page, byte mask)
+    {
+        byte *p;
+        if (_tileRotate)
+        {
+            p = &_pTile[(7 - page) * _tileWidth + (_tileWidth - 1 - x)];
+            mask = reverseBits(mask);
+        }
+        else
+        {
+            p = &_pTile[page * _tileWidth + x];
+        }
+
+        if (_tileColor == 0)
+            *p &= ~mask;
+        else if (_tileColor == 1)
+            *p |= mask;
+        else
+            *p ^= mask;
+    }
+
+    /// @brief x列のy0～y1の縦線
+    void drawSpan(byte x, byte y0, byte y1)
+    {
+        byte pageTop = y0 >> 3;
+        byte pageBottom = y1 >> 3;
+        for (byte page = pageTop; page <= pageBottom; ++page)
+        {
+            byte mask = 0xFF;
+            if (page == pageTop)
+                mask &= 0xFF << (y0 & 7);
+            if (page == pageBottom)
+                mask &= 0xFF >> (7 - (y1 & 7));
+            drawColumnByte(x, page, mask);
+        }
+    }
+
+    /// @brief 残光の描画。ヒット数を4x4の組織的ディザで濃淡にする
+    void drawPersist()
+    {
+        static const byte bayer[4][4] = {
+            {0, 8, 2, 10},
+            {12, 4, 14, 6},
+            {3, 11, 1, 9},
+            {15, 7, 13, 5},
+        };
+
+        bool direct = beginDirect();
+        for (byte x = 0; x < DATA_BUF_HALF; ++x)
+        {
+            byte drawX = _left + x + 27;
+            byte drawY = _top + FRM_TOP + 1;
+            byte page = drawY >> 3;
+            byte mask = 0;
+            for (byte y = 0; y < PERSIST_HEIGHT; ++y, ++drawY)
+            {
+                if (_persist[y][x] <= (bayer[drawY & 3][drawX & 3] << 4))
+                {
+                    continue;
+                }
+
+                if (!direct)
+                {
+                    _pU8g2->drawPixel(drawX, drawY);
+                    continue;
+                }
+
+                // ページが変わるまで1バイトにまとめてから書く
+                if ((drawY >> 3) != page)
+                {
+                    if (mask != 0)
+                        drawColumnByte(drawX, page, mask);
+                    page = drawY >> 3;
+                    mask = 0;
+                }
+                mask |= 1 << (drawY & 7);
+            }
+
+            if (mask != 0)
+            {
+                drawColumnByte(drawX, page, mask);
+            }
+        }
+    }
+
+    /// @brief 波形の描画
+    /// 2サンプルを隣り合う2列の線で結ぶ。左列は始点から中間、右列は中間から終点の縦線になるので
+    /// U8g2の線描画を使わずにタイルバッファへ直接書く
     void drawData(byte drawLastIndex = DATA_BUF_HALF)
     {
-        long y, y2;
+        bool direct = beginDirect();
         for (byte x = 0; x < drawLastIndex; x += 2)
         {
-            byte bufIndex = max(x + _triggerPoint - 10, 0);
+            byte bufIndex = x;
             byte bufIndexMinusOne = max(((int16_t)bufIndex - 1), 0);
-            y = map(_dataBuff[bufIndexMinusOne], _rangeMin, _rangeMax, FRM_BTM - 1, FRM_TOP + 1);
-            y2 = map(_dataBuff[bufIndex], _rangeMin, _rangeMax, FRM_BTM - 1, FRM_TOP + 1);
-            _pU8g2->drawLine(_left + x + 27, _top + y, _left + x + 28, _top + y2);
+            byte y = _top + toY(_dataBuff[bufIndexMinusOne]);
+            byte y2 = _top + toY(_dataBuff[bufIndex]);
+            if (!direct)
+            {
+                _pU8g2->drawLine(_left + x + 27, y, _left + x + 28, y2);
+                continue;
+            }
+
+            if (y2 >= y)
+            {
+                byte mid = (y + y2) >> 1;
+                drawSpan(_left + x + 27, y, mid);
+                drawSpan(_left + x + 28, min((byte)(mid + 1), y2), y2);
+            }
+            else
+            {
+                byte mid = (y + y2 + 1) >> 1;
+                drawSpan(_left + x + 27, mid, y);
+                drawSpan(_left + x + 28, y2, mid - 1);
+            }
+        }
+    }
+
+    /// @brief 2本目の波形。1本目と区別できるよう2列ごとの点で描く
+    /// 重なったところが消えないようにXORではなく上書きで描く
+    void drawDataB(byte drawLastIndex)
+    {
+        _pU8g2->setDrawColor(1);
+        for (byte x = 0; x < drawLastIndex; x += 2)
+        {
+            _pU8g2->drawPixel(_left + x + 28, _top + toY(_dataBuffB[x]));
+        }
+        _pU8g2->setDrawColor(2);
+    }
+
+    /// @brief 深いキャプチャ用の1サンプル。平均を取らずに1回だけ変換する
+    int16_t readDeepSample()
+    {
+        // 補正はanalogReadと同じ
+        return max((int16_t)_pCv->analogReadDirect() - 16, 0);
+    }
+
+    /// @brief 次のサンプル時刻まで待つ。変換時間を含めて間隔を_delayに揃える
+    uint32_t waitDeepSample(uint32_t next)
+    {
+        int32_t remain = (int32_t)(next - micros());
+        if (remain > 0)
+        {
+            delayMicroseconds(remain);
+        }
+        return next + _delay;
+    }
+
+    /// @brief 深いキャプチャの取り込み。トリガを待ち、来たらバッファが埋まるまで取り込む
+    /// 1回にTRIG_BUDGET_MICROSまで取り込んで返し、次の呼び出しで続ける。途中でarmされたら最初から
+    /// 呼び出しの間に過ぎたサンプルは直前の値で埋めて時間軸を保つ。取り込んだら次のarmまで保持する
+    /// @return 新しい取り込みが完了したらtrue
+    bool readDeep()
+    {
+        if (_armRequest)
+        {
+            _armRequest = false;
+            _trigState = TRIG_STATE_WAIT;
+            _deepIndex = 0;
+        }
+        else if (_trigState == TRIG_STATE_STOP)
+        {
+            return false;
+        }
+
+        // 測定は取り込み全体で1回。チャンクの間は積算を続ける
+        uint32_t start = micros();
+        if (_deepIndex == 0)
+        {
+            beginMeasure();
+            if (!waitDeepTrigger(start))
+            {
+                endMeasure();
+                return false;
+            }
+        }
+
+        uint32_t next = _deepNext;
+        while (_deepIndex < DEEP_BUF_MAX && micros() - start < TRIG_BUDGET_MICROS)
+        {
+            if ((int32_t)(micros() - next) >= _delay)
+            {
+                // このサンプルの時刻は過ぎている
+                _deepBuff[_deepIndex] = _deepBuff[_deepIndex - 1];
+                next += _delay;
+            }
+            else
+            {
+                next = waitDeepSample(next);
+                _deepBuff[_deepIndex] = readDeepSample();
+            }
+            _measure.put(_deepBuff[_deepIndex]);
+            _deepIndex++;
+        }
+        _deepNext = next;
+        if (_deepIndex < DEEP_BUF_MAX)
+        {
+            return false;
+        }
+
+        endMeasure();
+        _deepIndex = 0;
+        _deepReady = true;
+        _trigState = TRIG_STATE_STOP;
+        return true;
+    }
+
+    /// @brief トリガを待ち、来たらプリトリガ分を_deepBuffの先頭に並べる
+    /// @return 取り込みを始めたらtrue
+    bool waitDeepTrigger(uint32_t start)
+    {
+        // プリトリガ分は_ringBuffに貯める
+        resetTrigger();
+        _lastSample = readDeepSample();
+        _measure.put(_lastSample);
+        uint32_t next = micros() + _delay;
+        bool triggered = false;
+        while (!triggered && micros() - start < TRIG_BUDGET_MICROS)
+        {
+            next = waitDeepSample(next);
+            int16_t value = readDeepSample();
+            _measure.put(value);
+            _ringBuff[_ringIndex] = value;
+            _ringIndex = _ringIndex + 1 >= DATA_BUF_MAX ? 0 : _ringIndex + 1;
+            if (_ringCount < DATA_BUF_MAX)
+            {
+                _ringCount++;
+            }
+
+            int16_t prev = _lastSample;
+            _lastSample = value;
+            triggered = _ringCount > _preTrigger && isTriggerEdge(prev, value);
+        }
+
+        if (!triggered && _trigMode != TRIG_MODE_AUTO)
+        {
+            return false;
+        }
+
+        // トリガしたサンプルが_preTriggerの位置に来るように並べる
+        // 前の取り込みは上書きしていくので、埋まるまで表示しない
+        uint16_t pre = min(_ringCount, (uint16_t)(_preTrigger + 1));
+        byte index = (_ringIndex + DATA_BUF_MAX - pre) % DATA_BUF_MAX;
+        for (uint16_t i = 0; i < pre; ++i)
+        {
+            _deepBuff[i] = _ringBuff[index];
+            index = index + 1 >= DATA_BUF_MAX ? 0 : index + 1;
+        }
+        _deepIndex = pre;
+        _deepNext = next;
+        _deepTrigger = pre - 1;
+        _deepReady = false;
+        _trigState = triggered ? TRIG_STATE_TRIG : TRIG_STATE_AUTO;
+        return true;
+    }
+
+    /// @brief ピラミッドのlevel段の先頭位置
+    static uint16_t deepOffset(byte level)
+    {
+        return (DEEP_BUF_MAX >> (DEEP_LEVEL_MIN - 1)) - (DEEP_BUF_MAX >> (level - 1));
+    }
+
+    /// @brief 取り込み全体の最小/最大ピラミッドを作る。縦の表示範囲は取り込み全体から決める
+    void buildPyramid()
+    {
+        long sum = 0;
+        uint16_t count = DEEP_BUF_MAX >> DEEP_LEVEL_MIN;
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            const int16_t *pData = &_deepBuff[i << DEEP_LEVEL_MIN];
+            int16_t dataMin = pData[0];
+            int16_t dataMax = pData[0];
+            for (byte k = 0; k < (1 << DEEP_LEVEL_MIN); ++k)
+            {
+                sum += pData[k];
+                dataMin = min(dataMin, pData[k]);
+                dataMax = max(dataMax, pData[k]);
+            }
+            _deepMin[i] = dataMin;
+            _deepMax[i] = dataMax;
+        }
+
+        for (byte level = DEEP_LEVEL_MIN + 1; level <= DEEP_BUF_BIT; ++level)
+        {
+            uint16_t src = deepOffset(level - 1);
+            uint16_t dst = deepOffset(level);
+            count = DEEP_BUF_MAX >> level;
+            for (uint16_t i = 0; i < count; ++i)
+            {
+                _deepMin[dst + i] = min(_deepMin[src + (i << 1)], _deepMin[src + (i << 1) + 1]);
+                _deepMax[dst + i] = max(_deepMax[src + (i << 1)], _deepMax[src + (i << 1) + 1]);
+            }
+        }
+
+        _dataAve = sum / DEEP_BUF_MAX;
+        uint16_t top = deepOffset(DEEP_BUF_BIT);
+        setRange(_deepMin[top], _deepMax[top]);
+    }
+
+    /// @brief a～b-1の最小/最大。揃った区間はピラミッドの段から、端は生データから取る
+    void queryDeep(uint16_t a, uint16_t b, int16_t &dataMin, int16_t &dataMax)
+    {
+        dataMin = DATA_MAX_VALUE;
+        dataMax = 0;
+        while (a < b)
+        {
+            byte level = a == 0 ? DEEP_BUF_BIT : min(__builtin_ctz(a), DEEP_BUF_BIT);
+            while (level >= DEEP_LEVEL_MIN && a + (1u << level) > b)
+            {
+                level--;
+            }
+
+            if (level < DEEP_LEVEL_MIN)
+            {
+                dataMin = min(dataMin, _deepBuff[a]);
+                dataMax = max(dataMax, _deepBuff[a]);
+                a++;
+                continue;
+            }
+
+            uint16_t entry = deepOffset(level) + (a >> level);
+            dataMin = min(dataMin, _deepMin[entry]);
+            dataMax = max(dataMax, _deepMax[entry]);
+            a += 1u << level;
+        }
+    }
+
+    /// @brief ポットの値から表示範囲を決める
+    void calcDeepView()
+    {
+        // 1列あたりのサンプル数。最後は取り込み全体が収まる幅
+        static const byte zooms[DEEP_ZOOM_STEPS] = {
+            1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128,
+            (DEEP_BUF_MAX + DATA_BUF_HALF - 1) / DATA_BUF_HALF};
+
+        byte zoom = min((uint32_t)_deepZoom * DEEP_ZOOM_STEPS / (DATA_MAX_VALUE + 1), (uint32_t)DEEP_ZOOM_STEPS - 1);
+        _deepSpan = zooms[zoom];
+        uint32_t width = (uint32_t)_deepSpan * DATA_BUF_HALF;
+        uint32_t room = width < DEEP_BUF_MAX ? DEEP_BUF_MAX - width : 0;
+        _deepStart = room * min(_deepPan, (uint16_t)DATA_MAX_VALUE) / DATA_MAX_VALUE;
+
+        int32_t trigger = (int32_t)_deepTrigger - _deepStart;
+        _triggerPoint = trigger >= 0 && trigger < (int32_t)width ? trigger / _deepSpan : -1;
+    }
+
+    /// @brief 深いキャプチャの描画。1列ごとに範囲の最小～最大を縦線で描き、前の列の終わりとつなぐ
+    void drawDeep()
+    {
+        if (!_deepReady)
+        {
+            return;
+        }
+
+        bool direct = beginDirect();
+        int16_t last = _deepBuff[_deepStart > 0 ? _deepStart - 1 : 0];
+        for (byte x = 0; x < DATA_BUF_HALF; ++x)
+        {
+            uint32_t a = _deepStart + (uint32_t)x * _deepSpan;
+            if (a >= DEEP_BUF_MAX)
+            {
+                break;
+            }
+            uint32_t b = min(a + _deepSpan, (uint32_t)DEEP_BUF_MAX);
+
+            int16_t dataMin;
+            int16_t dataMax;
+            queryDeep(a, b, dataMin, dataMax);
+            dataMin = min(dataMin, last);
+            dataMax = max(dataMax, last);
+            last = _deepBuff[b - 1];
+
+            byte drawX = _left + x + 27;
+            byte y0 = _top + toY(dataMax);
+            byte y1 = _top + toY(dataMin);
+            if (direct)
+            {
+                drawSpan(drawX, y0, y1);
+            }
+            else
+            {
+                _pU8g2->drawVLine(drawX, y0, y1 - y0 + 1);
+            }
         }
     }
 };
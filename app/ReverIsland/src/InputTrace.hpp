@@ -0,0 +1,424 @@
+/*!
+ * InputTrace class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "RingBuffer.hpp"
+#include "Telemetry.hpp"
+#include "Button.hpp"
+#include "SmoothAnalogRead.hpp"
+
+// 操作入力の記録と再生
+// 記録：制御周期の先頭にTICK、アナログ入力は16回読みの合計値、ボタンは変化時のみ積む
+// 再生：同じ順序で読み出されるので、記録した並びのまま取り出してreadPinへ返す
+#define TRACE_SRC_TICK 0x00
+#define TRACE_SRC_POT0 0x01
+#define TRACE_SRC_POT1 0x02
+#define TRACE_SRC_POT2 0x03
+#define TRACE_SRC_CV 0x04
+#define TRACE_SRC_SW0 0x05
+#define TRACE_SRC_SW1 0x06
+#define TRACE_SRC_STATE 0x40
+#define TRACE_SRC_END 0xFF
+
+#define TRACE_MODE_OFF 0
+#define TRACE_MODE_RECORD 1
+#define TRACE_MODE_REPLAY 2
+
+#define TRACE_BUF_SIZE 2048
+#define TRACE_ANALOG_SAMPLES 16
+
+struct __attribute__((packed)) TraceEvent
+{
+    uint32_t micros;
+    uint8_t source;
+    uint16_t value;
+};
+
+#define TRACE_EVENTS_PER_FRAME (FRAME_PAYLOAD_MAX / sizeof(TraceEvent))
+
+class InputTrace
+{
+public:
+    InputTrace()
+    {
+        begin(TRACE_MODE_OFF);
+    }
+
+    byte getMode()
+    {
+        return _mode;
+    }
+
+    bool isRecording()
+    {
+        return _mode == TRACE_MODE_RECORD;
+    }
+
+    bool isReplaying()
+    {
+        return _mode == TRACE_MODE_REPLAY;
+    }
+
+    /// @brief 記録中のあふれ、再生中の順序不一致
+    bool hasError()
+    {
+        return _error;
+    }
+
+    void startRecord()
+    {
+        begin(TRACE_MODE_RECORD);
+    }
+
+    void startReplay()
+    {
+        begin(TRACE_MODE_REPLAY);
+    }
+
+    void stop()
+    {
+        if (_mode == TRACE_MODE_RECORD)
+        {
+            // 終端。値はあふれの有無
+            push(TRACE_SRC_END, _error ? 1 : 0);
+        }
+        _mode = TRACE_MODE_OFF;
+    }
+
+    /// @brief 再生用のイベント追加。空きがなければ何もしない
+    /// @return 入らなければfalse
+    bool feed(const TraceEvent *pEvents, uint16_t count)
+    {
+        if (_mode != TRACE_MODE_REPLAY || !_buff.push(pEvents, count))
+        {
+            return false;
+        }
+
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            if (pEvents[i].source == TRACE_SRC_TICK)
+            {
+                _fedTicks++;
+            }
+            else if (pEvents[i].source == TRACE_SRC_END)
+            {
+                _endOfTrace = true;
+            }
+        }
+        return true;
+    }
+
+    uint16_t getFree()
+    {
+        return _buff.free();
+    }
+
+    /// @brief 再生時、次の制御周期分のイベントが揃っているか
+    bool isReady()
+    {
+        if (_mode != TRACE_MODE_REPLAY)
+        {
+            return true;
+        }
+
+        uint32_t remain = _fedTicks - _consumedTicks;
+        if (_endOfTrace && remain == 0)
+        {
+            _mode = TRACE_MODE_OFF;
+            return true;
+        }
+
+        // 次のTICKが届いていれば現在の周期は揃っている
+        return remain >= 2 || (_endOfTrace && remain >= 1);
+    }
+
+    /// @brief 開始直後で内部状態の保存/復元が必要か
+    bool isStatePending()
+    {
+        return _mode != TRACE_MODE_OFF && _statePending;
+    }
+
+    void clearStatePending()
+    {
+        _statePending = false;
+    }
+
+    /// @brief 制御周期の先頭で呼ぶ
+    void tick()
+    {
+        if (_mode == TRACE_MODE_RECORD)
+        {
+            _clockMicros = micros();
+            push(TRACE_SRC_TICK, 0);
+        }
+        else if (_mode == TRACE_MODE_REPLAY)
+        {
+            TraceEvent event;
+            if (!_buff.pop(event) || event.source != TRACE_SRC_TICK)
+            {
+                fail();
+                return;
+            }
+            _clockMicros = event.micros;
+            _consumedTicks++;
+        }
+    }
+
+    /// @brief 記録/再生中の時刻。TICKごとに更新
+    uint32_t getClockMicros()
+    {
+        return _clockMicros;
+    }
+
+    unsigned long getClockMillis()
+    {
+        return _clockMicros / 1000;
+    }
+
+    /// @brief 記録時は値を積み、再生時は次のイベントを取り出す
+    /// @param source
+    /// @param value
+    /// @return 再生できればtrue
+    bool trace(byte source, uint16_t &value)
+    {
+        if (_mode == TRACE_MODE_RECORD)
+        {
+            push(source, value);
+            return false;
+        }
+        else if (_mode == TRACE_MODE_REPLAY)
+        {
+            TraceEvent event;
+            if (!_buff.pop(event) || event.source != source)
+            {
+                fail();
+                return false;
+            }
+            value = event.value;
+            return true;
+        }
+        return false;
+    }
+
+    /// @brief 再生時、次のイベントが指定元のものなら取り出す（ボタンの変化用）
+    bool replayIfNext(byte source, uint16_t &value)
+    {
+        TraceEvent event;
+        if (_mode != TRACE_MODE_REPLAY || !_buff.peek(event) || event.source != source)
+        {
+            return false;
+        }
+
+        _buff.pop(event);
+        value = event.value;
+        return true;
+    }
+
+    /// @brief 内部状態を記録、または再生時に復元する
+    template <typename T>
+    void state(T &value)
+    {
+        uint16_t tmp = (uint16_t)value;
+        if (trace(TRACE_SRC_STATE, tmp))
+        {
+            value = (T)tmp;
+        }
+    }
+
+    void state(unsigned long &value)
+    {
+        uint16_t lo = value & 0xFFFF;
+        uint16_t hi = value >> 16;
+        state(lo);
+        state(hi);
+        value = ((unsigned long)hi << 16) | lo;
+    }
+
+    /// @brief 記録したイベントをフレームにして送信バッファへ移す
+    /// @param telemetry
+    void flush(Telemetry &telemetry)
+    {
+        if (_mode == TRACE_MODE_REPLAY)
+        {
+            return;
+        }
+
+        TraceEvent events[TRACE_EVENTS_PER_FRAME];
+        while (_buff.available() > 0 &&
+               telemetry.getFree() >= FRAME_HEADER_SIZE + sizeof(events) + FRAME_FOOTER_SIZE)
+        {
+            byte count = 0;
+            while (count < TRACE_EVENTS_PER_FRAME && _buff.pop(events[count]))
+            {
+                count++;
+            }
+            telemetry.pushFrame(FRAME_TYPE_TRACE, events, count * sizeof(TraceEvent));
+        }
+    }
+
+protected:
+    RingBuffer<TraceEvent, TRACE_BUF_SIZE> _buff;
+    byte _mode;
+    bool _error;
+    bool _statePending;
+    bool _endOfTrace;
+    uint32_t _fedTicks;
+    uint32_t _consumedTicks;
+    uint32_t _clockMicros;
+
+    void begin(byte mode)
+    {
+        _buff.clear();
+        _error = false;
+        _statePending = true;
+        _endOfTrace = false;
+        _fedTicks = 0;
+        _consumedTicks = 0;
+        _clockMicros = micros();
+        _mode = mode;
+    }
+
+    void push(byte source, uint16_t value)
+    {
+        TraceEvent event = {(uint32_t)micros(), source, value};
+        if (!_buff.push(event))
+        {
+            _error = true;
+        }
+    }
+
+    void fail()
+    {
+        _error = true;
+        _mode = TRACE_MODE_OFF;
+    }
+};
+
+/// @brief 記録/再生に対応したアナログ入力
+class TraceAnalogRead : public SmoothAnalogReadBase<TraceAnalogRead>
+{
+    friend class SmoothAnalogReadBase<TraceAnalogRead>;
+
+public:
+    void attachTrace(InputTrace *pTrace, byte source)
+    {
+        _pTrace = pTrace;
+        _source = source;
+        _count = 0;
+        _sum = 0;
+    }
+
+    /// @brief フィルタの状態を記録/復元
+    void traceState()
+    {
+        _pTrace->state(_value);
+    }
+
+protected:
+    InputTrace *_pTrace = NULL;
+    byte _source;
+    byte _count;
+    uint16_t _sum;
+
+    /// @brief analogRead内で16回連続して呼ばれる前提で、16回分の合計を1イベントにする
+    /// 再生時は合計が一致するように分配して返すので平均値は記録時と同じになる
+    uint16_t readPin()
+    {
+        if (_pTrace == NULL || _pTrace->getMode() == TRACE_MODE_OFF)
+        {
+            _count = 0;
+            return readPinDirect();
+        }
+
+        if (_pTrace->isRecording())
+        {
+            uint16_t value = readPinDirect();
+            _sum += value;
+            if (++_count >= TRACE_ANALOG_SAMPLES)
+            {
+                _pTrace->trace(_source, _sum);
+                _count = 0;
+                _sum = 0;
+            }
+            return value;
+        }
+
+        if (_count == 0 && !_pTrace->trace(_source, _sum))
+        {
+            return readPinDirect();
+        }
+
+        uint16_t value = (_sum / TRACE_ANALOG_SAMPLES) + (_count < (_sum % TRACE_ANALOG_SAMPLES) ? 1 : 0);
+        _count = (_count + 1) % TRACE_ANALOG_SAMPLES;
+        return value;
+    }
+};
+
+/// @brief 記録/再生に対応したボタン
+class TraceButton : public ButtonBase<TraceButton>
+{
+    friend class ButtonBase<TraceButton>;
+
+public:
+    void attachTrace(InputTrace *pTrace, byte source)
+    {
+        _pTrace = pTrace;
+        _source = source;
+        _level = HIGH;
+    }
+
+    /// @brief チャタ取りとホールド判定の状態を記録/復元
+    void traceState()
+    {
+        _pTrace->state(_pinState);
+        _pTrace->state(_holdStage);
+        _pTrace->state(_lastMillis);
+        _pTrace->state(_level);
+    }
+
+protected:
+    InputTrace *_pTrace = NULL;
+    byte _source;
+    byte _level;
+
+    byte readPin()
+    {
+        if (_pTrace == NULL || _pTrace->getMode() == TRACE_MODE_OFF)
+        {
+            _level = readPinDirect();
+            return _level;
+        }
+
+        uint16_t value = 0;
+        if (_pTrace->isRecording())
+        {
+            value = readPinDirect();
+            if (value != _level)
+            {
+                _pTrace->trace(_source, value);
+            }
+        }
+        else if (!_pTrace->replayIfNext(_source, value))
+        {
+            return _level;
+        }
+
+        _level = value;
+        return _level;
+    }
+
+    unsigned long readMillis()
+    {
+        if (_pTrace == NULL || _pTrace->getMode() == TRACE_MODE_OFF)
+        {
+            return millis();
+        }
+        return _pTrace->getClockMillis();
+    }
+};
@@ -0,0 +1,197 @@
+/*!
+ * LabelCache class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#define LABEL_CACHE_ENTRIES 8
+#define LABEL_CACHE_TEXT_LEN 24
+// 1エントリの最大バイト数(3ページ x 128列)
+#define LABEL_CACHE_BYTES 384
+
+/// @brief 変わらない文字列の描画結果をバッファの並びのまま覚えておき、次からは転写する
+/// 描画色がXOR(2)でフォントが背景を塗らない(setFontMode(1))ときだけ使う。
+/// このときは描く前後の差分がグリフの点だけになり、転写も同じXORで済むので下に何が描いてあっても結果が変わらない
+/// 背景を塗るモードでは差分が下の絵で変わるので、そのままdrawStrする
+class LabelCache
+{
+public:
+    LabelCache()
+    {
+        _pU8g2 = NULL;
+        _next = 0;
+        _hitCount = 0;
+        _missCount = 0;
+        clear();
+    }
+
+    void init(U8G2 *pU8g2)
+    {
+        _pU8g2 = pU8g2;
+        clear();
+    }
+
+    void clear()
+    {
+        for (byte i = 0; i < LABEL_CACHE_ENTRIES; ++i)
+        {
+            _entries[i].valid = false;
+        }
+    }
+
+    /// @brief drawStrの代わり。フォントは呼び出し前にsetFontしておくこと
+    /// @return 文字列の幅(drawStrと同じ)
+    int drawStr(int x, int y, const char *str)
+    {
+        u8g2_t *pU8g2 = _pU8g2->getU8g2();
+        if (pU8g2->draw_color != 2 || !pU8g2->font_decode.is_transparent || strlen(str) >= LABEL_CACHE_TEXT_LEN)
+        {
+            return _pU8g2->drawStr(x, y, str);
+        }
+
+        const void *pFont = pU8g2->font;
+        for (byte i = 0; i < LABEL_CACHE_ENTRIES; ++i)
+        {
+            Entry &entry = _entries[i];
+            if (entry.valid && entry.x == x && entry.y == y && entry.pFont == pFont &&
+                entry.rotation == pU8g2->cb && strcmp(entry.text, str) == 0)
+            {
+                blit(entry);
+                _hitCount++;
+                return entry.advance;
+            }
+        }
+
+        _missCount++;
+        int advance = capture(_entries[_next], x, y, pFont, str);
+        _next = (_next + 1) % LABEL_CACHE_ENTRIES;
+        return advance;
+    }
+
+    uint32_t getHitCount()
+    {
+        return _hitCount;
+    }
+
+    uint32_t getMissCount()
+    {
+        return _missCount;
+    }
+
+protected:
+    struct Entry
+    {
+        bool valid;
+        int16_t x;
+        int16_t y;
+        const void *pFont;
+        const void *rotation;
+        char text[LABEL_CACHE_TEXT_LEN];
+        byte page;
+        byte pages;
+        byte column;
+        byte width;
+        int16_t advance;
+        byte data[LABEL_CACHE_BYTES];
+    };
+
+    U8G2 *_pU8g2;
+    Entry _entries[LABEL_CACHE_ENTRIES];
+    byte _next;
+    uint32_t _hitCount;
+    uint32_t _missCount;
+    // 差分を取るための退避先
+    byte _scratch[1024];
+
+    /// @brief 実際に描き、描く前との差分を覚える
+    int capture(Entry &entry, int x, int y, const void *pFont, const char *str)
+    {
+        byte *pBuff = _pU8g2->getBufferPtr();
+        uint16_t lineBytes = _pU8g2->getBufferTileWidth() << 3;
+        uint16_t size = lineBytes * _pU8g2->getBufferTileHeight();
+        entry.valid = false;
+        if (size > sizeof(_scratch))
+        {
+            return _pU8g2->drawStr(x, y, str);
+        }
+
+        memcpy(_scratch, pBuff, size);
+        int advance = _pU8g2->drawStr(x, y, str);
+
+        // 変化した範囲を探す
+        int pageMin = 255, pageMax = -1, colMin = 255, colMax = -1;
+        for (uint16_t i = 0; i < size; ++i)
+        {
+            if (pBuff[i] == _scratch[i])
+            {
+                continue;
+            }
+            int page = i / lineBytes;
+            int col = i % lineBytes;
+            pageMin = min(pageMin, page);
+            pageMax = max(pageMax, page);
+            colMin = min(colMin, col);
+            colMax = max(colMax, col);
+        }
+
+        if (pageMax < 0)
+        {
+            // 空白だけなど
+            pageMin = 0;
+            pageMax = -1;
+            colMin = 0;
+            colMax = -1;
+        }
+
+        byte pages = pageMax - pageMin + 1;
+        byte width = colMax - colMin + 1;
+        if (pages * width > LABEL_CACHE_BYTES)
+        {
+            return advance;
+        }
+
+        for (byte p = 0; p < pages; ++p)
+        {
+            const byte *pAfter = &pBuff[(pageMin + p) * lineBytes + colMin];
+            const byte *pBefore = &_scratch[(pageMin + p) * lineBytes + colMin];
+            for (byte c = 0; c < width; ++c)
+            {
+                entry.data[p * width + c] = pAfter[c] ^ pBefore[c];
+            }
+        }
+
+        entry.x = x;
+        entry.y = y;
+        entry.pFont = pFont;
+        entry.rotation = _pU8g2->getU8g2()->cb;
+        strcpy(entry.text, str);
+        entry.page = pageMin;
+        entry.pages = pages;
+        entry.column = colMin;
+        entry.width = width;
+        entry.advance = advance;
+        entry.valid = true;
+        return advance;
+    }
+
+    void blit(const Entry &entry)
+    {
+        byte *pBuff = _pU8g2->getBufferPtr();
+        uint16_t lineBytes = _pU8g2->getBufferTileWidth() << 3;
+        const byte *pData = entry.data;
+        for (byte p = 0; p < entry.pages; ++p)
+        {
+            byte *pLine = &pBuff[(entry.page + p) * lineBytes + entry.column];
+            for (byte c = 0; c < entry.width; ++c)
+            {
+                pLine[c] ^= *pData++;
+            }
+        }
+    }
+};
@@ -10,20 +10,29 @@
 #include <Arduino.h>
 #include <U8g2lib.h>
 #include "GpioSet.h"
-
-#ifdef PROTO
-#define TITLE_ROW 3
-#define POTS_ROW 0
-#else
-#define TITLE_ROW 0
-#define POTS_ROW 1
-#endif
+#include "LabelCache.hpp"
+#include "ProbeBus.hpp"
 
 byte mode0 = 0;
 byte mode1 = 1;
 byte mode2 = 2;
-
-static const char *_assignMode[] = {"off", "absolute", "relative"};
+byte mode3 = 3;
+byte mode4 = 4;
+byte mode5 = 5;
+byte mode6 = 6;
+byte mode7 = 7;
+byte mode8 = 8;
+byte mode9 = 9;
+
+static const char *_assignMode[] = {"off", "absolute", "relative", "preset"};
+static const char *_trigMode[] = {"auto", "normal", "single"};
+static const char *_trigEdge[] = {"rise", "fall"};
+static const char *_scopeDisp[] = {"normal", "average", "persist", "deep"};
+static const char *_linkMode[] = {"off", "leader", "follower"};
+static const char *_onOff[] = {"off", "on"};
+
+// タイトルとパラメタ名はプリセットやページが変わるまで同じなので描画結果を使い回す
+static LabelCache labelCache;
 
 class ParamGroup
 {
@@ -35,6 +44,7 @@ public:
     void init(U8G2 *pU8g2)
     {
         _pU8g2 = pU8g2;
+        labelCache.init(pU8g2);
         _offsetX = 0;
         _maxWidth = 127;
         _height = 16;
@@ -73,33 +83,62 @@ public:
     void dispParamGroup(uint16_t values[POTS_MAX])
     {
         static char disp_buf[20] = {0};
+        static char label_buf[20] = {0};
         _pU8g2->setFont(u8g2_font_6x13_tf);
 
         // pots
         for (byte i = 0; i < 3; ++i)
         {
             // setting label and values
+            // 名前と区切りは固定なのでキャッシュから、値だけ毎回描く
             byte valueItem = (byte)(*_pValueItems[i]);
+            const char *pValueText = NULL;
             switch (_DispMode[i])
             {
-            case 0:
-                strcpy(disp_buf, _pValueName[i]);
-                break;
             case 1:
-                sprintf(disp_buf, "%s:%03d", _pValueName[i], valueItem);
+                sprintf(disp_buf, "%03d", valueItem);
+                pValueText = disp_buf;
                 break;
             case 2:
-                sprintf(disp_buf, "%s:%s", _pValueName[i], _assignMode[valueItem]);
+                pValueText = _assignMode[valueItem];
+                break;
+            case 3:
+                pValueText = _trigMode[valueItem];
+                break;
+            case 4:
+                pValueText = _trigEdge[valueItem];
+                break;
+            case 5:
+                pValueText = _scopeDisp[valueItem];
+                break;
+            case 6:
+                pValueText = valueItem == 0 ? "cv pin" : probeNames[valueItem - 1];
+                break;
+            case 7:
+                pValueText = valueItem == 0 ? "off" : probeNames[valueItem - 1];
+                break;
+            case 8:
+                pValueText = _linkMode[valueItem];
+                break;
+            case 9:
+                pValueText = _onOff[valueItem];
                 break;
-            
             default:
-                strcpy(disp_buf, _pValueName[i]);
                 break;
             }
 
-            byte height = _height * (i + POTS_ROW);
+            byte height = _height * (i + Board::POTS_ROW);
             _pU8g2->drawFrame(_offsetX, height, _maxWidth, _frameHeight);
-            _pU8g2->drawStr(_offsetX + 2, height, disp_buf);
+            if (pValueText == NULL)
+            {
+                labelCache.drawStr(_offsetX + 2, height, _pValueName[i]);
+            }
+            else
+            {
+                sprintf(label_buf, "%s:", _pValueName[i]);
+                int width = labelCache.drawStr(_offsetX + 2, height, label_buf);
+                _pU8g2->drawStr(_offsetX + 2 + width, height, pValueText);
+            }
 
             byte value = (byte)constrain(map(valueItem, _MinItems[i], _MaxItems[i], 1, _maxWidth - 1), 1, _maxWidth - 1);
 
@@ -120,11 +159,9 @@ public:
 
     void dispTitle()
     {
-        static char disp_buf[20] = {0};
         // Setting title
         _pU8g2->setFont(u8g2_font_8x13B_tf);
-        strcpy(disp_buf, _pTitle);
-        _pU8g2->drawStr(0, _height * TITLE_ROW, disp_buf);
+        labelCache.drawStr(0, _height * Board::TITLE_ROW, _pTitle);
     }
 
     void dispTitle(byte index, const char *mapName)
@@ -133,7 +170,7 @@ public:
         // Setting title
         _pU8g2->setFont(u8g2_font_8x13B_tf);
         sprintf(disp_buf, "%s%d: %s", mapName, index, _pTitle);
-        _pU8g2->drawStr(0, _height * TITLE_ROW, disp_buf);
+        labelCache.drawStr(0, _height * Board::TITLE_ROW, disp_buf);
     }
 
 protected:
@@ -0,0 +1,80 @@
+/*!
+ * Preset bank metadata
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * このファイルは tools/fv1_bank.py が ../fv1/banks.json から生成する。直接編集しないこと
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define PRESET_BANK_COUNT 3
+#define PRESET_BANK_PROGRAMS 24
+
+// バンク名(ROM/EEPROM切り替え順)
+const static char *bankNames[PRESET_BANK_COUNT] = {"R", "A", "B"};
+
+// プリセット名とパラメタ名
+const static char *names[PRESET_BANK_PROGRAMS][4] = {
+    // INTERNAL PRESETS
+    {"ChorusReverb", "Reverb Mix  ", "Chorus Rate ", "Chorus Mix  "},
+    {"FlangrReverb", "Reverb Mix  ", "Flanger Rate", "Flanger Mix "},
+    {"Tremolo-rev ", "Reverb Mix  ", "Tremolo Rate", "Tremolo Mix "},
+    {"Pitch shift ", "Pitch Semi  ", "------------", "------------"},
+    {"Pitch-echo  ", "Pitch Shift ", "Echo Delay  ", "Echo Mix    "},
+    {"Test        ", "------------", "------------", "------------"},
+    {"Reverb 1    ", "Reverb Time ", "HF Filter   ", "LF Filter   "},
+    {"Reverb 2    ", "Reverb Time ", "HF Filter   ", "LF Filter   "},
+    // EEPROM A (example) marksard selection vol.1
+    {"ShimmerRvOct", "Shimmer     ", "Time        ", "Damping     "}, // dattorro-shimmer_oct_var-lvl(Dattorro Mix Reverb)  dattorro-shimmer_oct_var-lvl.spn
+    {"Plate Reverb", "Reverb level", "Reverb time ", "Damping     "}, // Plate Reverb - Dattorro(Dattorro)  dattorro.spn
+    {"Echo Reverb ", "Delay       ", "Repeat      ", "Reverb      "}, // Echo Reverb(Spin Semi)  3K_V1_4_ECHO-REV.spn
+    {"3TCascadeChr", "Time 1      ", "Time 2      ", "Time 3      "}, // Triple Tap Cascaded Delay - Stereo w/ Chorus(Graham Biswell)  tripple_echo_cascaded_stereo+chorus.spn
+    {"SnglTapeEcRv", "Time        ", "Feedback    ", "Damping     "}, // Single Head Tape Echo + Reverb(No name)  dv103-1head-pp-2_1-4xreverb.spn
+    {"Flanger     ", "Speed       ", "Depth       ", "Feedback    "}, // Flanger(Firesledge)  05_bass-fv1-p0-flanger.spn
+    {"Rv+Flnge+LP ", "Reverb      ", "Flanger     ", "LPF         "}, // Reverb+Flange+LP(Dave Spinkler)  dance_ir_fla_l.spn
+    {"Rv+Pitch+LP ", "Reverb      ", "Pitch       ", "Filter      "}, // Reverb+Pitch+LP(Dave Spinkler)  dance_ir_ptz_l.spn
+    // EEPROM B (example)
+    {"Phaser OD   ", "Speed       ", "Depth       ", "Feedback    "}, // Phaser OD(Firesledge)  bass-fv1-p1-phaser.spn
+    {"Distortion  ", "Gain        ", "Tone        ", "Dry/Wet mix "}, // Distortion(Firesledge)  bass-fv1-p5-disto.spn
+    {"Bit crusher ", "P1          ", "P2          ", "P3          "}, // Bit crusher(Frank Thomson)  crusher.spn
+    {"Wah         ", "Reverb      ", "Sensitivity ", "FilterQLevel"}, // Wah(Spin Semi)  GA_DEMO_WAH.spn
+    {"OilCan Delay", "Time & Rate ", "Chorus Width", "Feedback    "}, // Oil can delay(Digital Larry)  oil-can-delay.spn
+    {"Soft Clip OD", "Gain Thresh ", "Volume      ", "Tone        "}, // Soft Clipping Overdrive(Jeroen Korterik)  softclipping_overdrive.spn
+    {"St2FlngMTapD", "Feedback    ", "Reso & Time ", "Return Level"}, // Stereo Dual Flange Multi Tap Delay(Digital Larry)  stereo-dual-flange-multi-tap-delay.spn
+    {"StRingModChr", "Blend       ", "CarrierOffst", "Chorus      "}, // Stereo Ring Modulators w/ Chorus(Digital Larry)  stereo-ring-modulators-with-chorus.spn
+};
+
+// パラメタごとの不感帯(12bit LSB)
+const static byte deadbands[PRESET_BANK_PROGRAMS][POTS_MAX] = {
+    // R
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    // A
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    // B
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+    {8, 8, 8},
+};
@@ -0,0 +1,147 @@
+/*!
+ * PresetBrowser class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// 押し続けたときの送りは8回ごとに間隔を半分にし、この回数まで縮める
+#define BROWSE_REPEAT_ACCEL_STEP 8
+#define BROWSE_REPEAT_ACCEL_MAX 2
+
+/// @brief プリセットの選び送り
+/// ボタンで送っている間は表示だけを先に切り替え、止まってから一定時間たつか確定操作で1回だけ切り替える
+/// 送るたびにFV-1がプログラムを読み直すのを防ぐ
+class PresetBrowser
+{
+public:
+    PresetBrowser()
+    {
+        setTiming(0, 100000);
+        _count = 1;
+        cancel();
+    }
+
+    /// @brief 送りの設定
+    /// @param settleMicros 最後に送ってから確定するまでの時間。0なら送るたびに確定する
+    /// @param repeatMicros 押し続けたときの送り間隔
+    void setTiming(uint32_t settleMicros, uint32_t repeatMicros)
+    {
+        _settleMicros = settleMicros;
+        _repeatMicros = max(repeatMicros, (uint32_t)1000);
+    }
+
+    bool isBrowsing()
+    {
+        return _browsing;
+    }
+
+    /// @brief 表示するプリセット番号。送っていなければ-1
+    int8_t getPreviewIndex()
+    {
+        return _browsing ? _index : -1;
+    }
+
+    /// @brief 1つ送る
+    /// @param current 現在確定しているプリセット番号
+    /// @param count プリセット数
+    /// @param dir +1/-1
+    void step(int8_t current, byte count, int8_t dir, uint32_t now)
+    {
+        if (!_browsing)
+        {
+            _browsing = true;
+            _base = current;
+            _index = current;
+        }
+        _count = count;
+        _index = (_index + dir + count) % count;
+        _stepMicros = now;
+    }
+
+    /// @brief 押し続けによる送りを始める。送っている途中のときだけ
+    /// @return 始めたらtrue。送っていなければfalse(呼び出し側で長押しとして扱う)
+    bool startRepeat(int8_t dir, uint32_t now)
+    {
+        if (!_browsing)
+        {
+            return false;
+        }
+        _repeatDir = dir;
+        _repeats = 0;
+        _repeatNext = now;
+        return true;
+    }
+
+    /// @brief ボタンを押している間は確定を待たせる
+    void hold(uint32_t now)
+    {
+        if (_browsing)
+        {
+            _stepMicros = now;
+        }
+    }
+
+    void stopRepeat()
+    {
+        _repeatDir = 0;
+    }
+
+    void cancel()
+    {
+        _browsing = false;
+        _repeatDir = 0;
+        _index = 0;
+        _base = 0;
+    }
+
+    /// @brief 制御周期ごとに呼ぶ
+    /// @param current 現在確定しているプリセット番号。送り始めから変わっていたら(自動操作など)送りを取りやめる
+    /// @param commitNow trueならすぐに確定する
+    /// @return 確定したプリセット番号。確定しなければ-1
+    int8_t update(int8_t current, bool commitNow, uint32_t now)
+    {
+        if (!_browsing)
+        {
+            return -1;
+        }
+        if (current != _base)
+        {
+            cancel();
+            return -1;
+        }
+
+        if (_repeatDir != 0 && (int32_t)(now - _repeatNext) >= 0)
+        {
+            _index = (_index + _repeatDir + _count) % _count;
+            _stepMicros = now;
+            _repeats++;
+            byte shift = min(_repeats / BROWSE_REPEAT_ACCEL_STEP, BROWSE_REPEAT_ACCEL_MAX);
+            _repeatNext = now + (_repeatMicros >> shift);
+        }
+
+        if (commitNow || (_repeatDir == 0 && now - _stepMicros >= _settleMicros))
+        {
+            int8_t index = _index;
+            cancel();
+            return index;
+        }
+        return -1;
+    }
+
+protected:
+    uint32_t _settleMicros;
+    uint32_t _repeatMicros;
+    bool _browsing;
+    int8_t _base;
+    int8_t _index;
+    byte _count;
+    uint32_t _stepMicros;
+    int8_t _repeatDir;
+    uint16_t _repeats;
+    uint32_t _repeatNext;
+};
@@ -0,0 +1,109 @@
+/*!
+ * ProbeBus class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "RingBuffer.hpp"
+
+// 制御周期の中の信号。オシロスコープの入力に選べる
+#define PROBE_POT0 0    // 平滑化後のポット値
+#define PROBE_POT1 1
+#define PROBE_POT2 2
+#define PROBE_TARGET0 3 // CVとポットを合わせた目標値(不感帯の前)
+#define PROBE_TARGET1 4
+#define PROBE_TARGET2 5
+#define PROBE_PWM0 6    // FV-1へ出したPWM値
+#define PROBE_PWM1 7
+#define PROBE_PWM2 8
+#define PROBE_CV 9      // 制御側で読んだCV(平滑化後)
+#define PROBE_SIGNAL_MAX 10
+#define PROBE_OFF 0xFF
+
+// 1サンプルの間隔。publishを呼ぶ制御タスクの周期と合わせること
+#define PROBE_PERIOD_MICROS 1000
+#define PROBE_BUF_SIZE 512
+
+static const char *probeNames[PROBE_SIGNAL_MAX] = {
+    "pot0", "pot1", "pot2", "tgt0", "tgt1", "tgt2", "pwm0", "pwm1", "pwm2", "cv"};
+
+/// @brief 選んだ2信号の1周期分
+struct ProbeSample
+{
+    int16_t a;
+    int16_t b;
+};
+
+/// @brief 制御コアの信号を表示コアへ流す
+/// 制御コアは周期中にset()で値を置き、終わりにpublish()で選ばれている2つだけをリングバッファへ積む
+/// 読み出し側が追いつかなければ新しいサンプルを捨てる
+class ProbeBus
+{
+public:
+    ProbeBus()
+    {
+        _selectA = PROBE_OFF;
+        _selectB = PROBE_OFF;
+        for (byte i = 0; i < PROBE_SIGNAL_MAX; ++i)
+        {
+            _values[i] = 0;
+        }
+    }
+
+    /// @brief 流す信号を選ぶ。読み出し側から呼ぶこと。変わったら溜まっている分は捨てる
+    /// @param a PROBE_*。PROBE_OFFなら何も流さない
+    /// @param b PROBE_*。PROBE_OFFなら0を流す
+    void select(byte a, byte b)
+    {
+        if (a == _selectA && b == _selectB)
+        {
+            return;
+        }
+        _selectA = a;
+        _selectB = b;
+        _buff.clear();
+    }
+
+    inline void set(byte signal, int16_t value)
+    {
+        _values[signal] = value;
+    }
+
+    /// @brief 制御周期の終わりに1回呼ぶ
+    void publish()
+    {
+        byte a = _selectA;
+        byte b = _selectB;
+        if (a >= PROBE_SIGNAL_MAX)
+        {
+            return;
+        }
+
+        ProbeSample sample;
+        sample.a = _values[a];
+        sample.b = b < PROBE_SIGNAL_MAX ? _values[b] : 0;
+        _buff.push(sample);
+    }
+
+    /// @brief 読み出し側から
+    bool pop(ProbeSample &sample)
+    {
+        return _buff.pop(sample);
+    }
+
+    /// @brief 溜まっている分を捨てる。読み出し側から
+    void flush()
+    {
+        _buff.clear();
+    }
+
+protected:
+    volatile byte _selectA;
+    volatile byte _selectB;
+    int16_t _values[PROBE_SIGNAL_MAX];
+    RingBuffer<ProbeSample, PROBE_BUF_SIZE> _buff;
+};
@@ -0,0 +1,130 @@
+/*!
+ * RingBuffer class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/// @brief 書き込み側1つ、読み出し側1つのロックフリーリングバッファ
+/// @tparam T 要素の型
+/// @tparam N 要素数（2のべき乗）
+template <typename T, uint16_t N>
+class RingBuffer
+{
+    static_assert((N & (N - 1)) == 0, "N must be power of 2");
+
+public:
+    RingBuffer()
+    {
+        clear();
+    }
+
+    /// @brief 内容を破棄（読み出し側から呼ぶこと）
+    void clear()
+    {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /// @brief 書き込み可能な要素数
+    uint16_t free() const
+    {
+        return N - available();
+    }
+
+    /// @brief 読み出し可能な要素数
+    uint16_t available() const
+    {
+        return (uint16_t)(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire));
+    }
+
+    /// @brief 1要素書き込み
+    /// @return 空きがなければfalse
+    bool push(const T &value)
+    {
+        uint16_t head = _head.load(std::memory_order_relaxed);
+        if ((uint16_t)(head - _tail.load(std::memory_order_acquire)) >= N)
+        {
+            return false;
+        }
+
+        _buff[head & (N - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief 複数要素をまとめて書き込み。全部入らない場合は何もしない
+    /// @return 空きがなければfalse
+    bool push(const T *values, uint16_t count)
+    {
+        uint16_t head = _head.load(std::memory_order_relaxed);
+        if ((uint16_t)(N - (head - _tail.load(std::memory_order_acquire))) < count)
+        {
+            return false;
+        }
+
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            _buff[(head + i) & (N - 1)] = values[i];
+        }
+        _head.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief 先頭要素を読み出さずに参照
+    /// @return 空ならfalse
+    bool peek(T &value) const
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = _buff[tail & (N - 1)];
+        return true;
+    }
+
+    /// @brief 1要素読み出し
+    /// @return 空ならfalse
+    bool pop(T &value)
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = _buff[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// @brief 折り返さずに連続して読み出せる領域を取得
+    /// @param ppData 先頭ポインタ
+    /// @return 要素数
+    uint16_t peekContiguous(const T **ppData) const
+    {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        uint16_t count = (uint16_t)(_head.load(std::memory_order_acquire) - tail);
+        uint16_t index = tail & (N - 1);
+        *ppData = &_buff[index];
+        return min(count, (uint16_t)(N - index));
+    }
+
+    /// @brief peekContiguousで参照した要素を読み捨てる
+    void consume(uint16_t count)
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+protected:
+    T _buff[N];
+    // インデックスは折り返さずに加算し、参照時にマスクする
+    std::atomic<uint16_t> _head{0};
+    std::atomic<uint16_t> _tail{0};
+};
@@ -0,0 +1,293 @@
+/*!
+ * Scheduler class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <pico/critical_section.h>
+#include <pico/time.h>
+#include <hardware/sync.h>
+
+#define TASK_CORE0 0
+#define TASK_CORE1 1
+#define TASK_CORE_ANY 2
+
+#define TASK_NAME_LEN 8
+
+// 周期タスクがないときに眠る上限(us)
+#define SCHED_IDLE_MAX 10000
+
+/// @brief タスク定義と実行統計
+/// periodが0のタスクはsignal()されたときだけ動く
+struct SchedulerTask
+{
+    const char *name;
+    void (*func)();
+    uint32_t period;   // 周期(us)
+    uint32_t deadline; // 起動予定時刻からの締め切り(us)
+    byte priority;     // 大きいほど優先
+    byte core;         // TASK_CORE0/1/ANY
+
+    // 以下は実行時に更新。定義では省く
+    uint32_t release = 0;
+    volatile bool pending = false;
+    volatile bool running = false;
+    uint32_t runs = 0;
+    uint32_t overruns = 0;
+    uint32_t skips = 0;
+    uint32_t execMax = 0;
+    uint32_t execTotal = 0;
+    uint32_t latencyMax = 0;
+};
+
+/// @brief 実行統計の送信形式
+struct __attribute__((packed)) SchedulerTaskStats
+{
+    char name[TASK_NAME_LEN];
+    uint8_t core;
+    uint8_t priority;
+    uint32_t period;
+    uint32_t deadline;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t skips;
+    uint32_t execMax;
+    uint32_t execAve;
+    uint32_t latencyMax;
+};
+
+/// @brief 両コアで共有する協調型スケジューラ
+/// 各コアのloopからrun()を呼ぶ。起動時刻を過ぎたタスクのうち優先度が高いもの、
+/// 同じなら締め切りが近いものを1つ実行して戻る
+class Scheduler
+{
+public:
+    Scheduler()
+    {
+        _pTasks = NULL;
+        _count = 0;
+        // もう片方のコアはbegin()より前からrun()を呼ぶので、ロックはここで用意しておく
+        critical_section_init(&_critSec);
+    }
+
+    void begin(SchedulerTask *pTasks, byte count)
+    {
+        uint32_t now = micros();
+        for (byte i = 0; i < count; ++i)
+        {
+            SchedulerTask &task = pTasks[i];
+            task.release = now;
+            task.pending = false;
+            task.running = false;
+            resetStats(task);
+        }
+
+        // タスク表を書き終えてから数を見せる。run()は数を読んでから表を読む
+        _pTasks = pTasks;
+        __atomic_store_n(&_count, count, __ATOMIC_RELEASE);
+    }
+
+    byte getCount()
+    {
+        return __atomic_load_n(&_count, __ATOMIC_ACQUIRE);
+    }
+
+    /// @brief イベント起動。周期タスクなら次の周期を待たずに1回実行する
+    void signal(byte id)
+    {
+        if (id < getCount())
+        {
+            __atomic_store_n(&_pTasks[id].pending, true, __ATOMIC_RELAXED);
+            // 眠っているもう片方のコアを起こす
+            __sev();
+        }
+    }
+
+    /// @brief 1タスク実行。動かせるタスクがなければ次の起動時刻まで眠って戻る
+    /// @param core 呼び出し元のコア番号
+    /// @return 実行したらtrue
+    bool run(byte core)
+    {
+        // もう片方のコアがbegin()する前に呼ばれることがある
+        byte count = getCount();
+        if (count == 0)
+        {
+            return false;
+        }
+
+        uint32_t now = micros();
+        uint32_t wake;
+        if (!findReady(core, count, now, wake))
+        {
+            // ロックは取らない。signal()の__sevか起動時刻のタイマで起きる
+            int32_t remain = (int32_t)(wake - now);
+            if (remain > 0)
+            {
+                best_effort_wfe_or_timeout(make_timeout_time_us(remain));
+            }
+            return false;
+        }
+
+        SchedulerTask *pTask = NULL;
+        critical_section_enter_blocking(&_critSec);
+        for (byte i = 0; i < count; ++i)
+        {
+            SchedulerTask &task = _pTasks[i];
+            if ((task.core != core && task.core != TASK_CORE_ANY) || task.running)
+            {
+                continue;
+            }
+
+            bool ready = isPending(task) || (task.period > 0 && (int32_t)(now - task.release) >= 0);
+            if (!ready)
+            {
+                continue;
+            }
+
+            if (pTask == NULL ||
+                task.priority > pTask->priority ||
+                (task.priority == pTask->priority &&
+                 (int32_t)((task.release + task.deadline) - (pTask->release + pTask->deadline)) < 0))
+            {
+                pTask = &task;
+            }
+        }
+
+        // ANYのタスクを両コアで同時に取らないよう、実行中の印をつけてから抜ける
+        // イベントもロックの中で受け取る。ここより後のsignal()は次の実行になる
+        bool byEvent = false;
+        if (pTask != NULL)
+        {
+            pTask->running = true;
+            byEvent = isPending(*pTask) && (pTask->period == 0 || (int32_t)(now - pTask->release) < 0);
+            __atomic_store_n(&pTask->pending, false, __ATOMIC_RELAXED);
+        }
+        critical_section_exit(&_critSec);
+
+        if (pTask == NULL)
+        {
+            return false;
+        }
+
+        uint32_t release = byEvent ? now : pTask->release;
+
+        uint32_t start = micros();
+        pTask->func();
+        uint32_t end = micros();
+
+        updateStats(*pTask, release, start, end);
+        if (!byEvent)
+        {
+            // 位相を保って次の周期へ。周期ごと取りこぼしたら飛ばして数える
+            pTask->release += pTask->period;
+            if ((int32_t)(end - pTask->release) >= (int32_t)pTask->period)
+            {
+                uint32_t missed = (end - pTask->release) / pTask->period;
+                pTask->skips += missed;
+                pTask->release += missed * pTask->period;
+            }
+        }
+        pTask->running = false;
+        return true;
+    }
+
+    /// @brief 実行統計の取得
+    void getStats(byte id, SchedulerTaskStats &stats)
+    {
+        SchedulerTask &task = _pTasks[id];
+        memset(&stats, 0, sizeof(stats));
+        // 終端なしで詰める
+        for (byte i = 0; i < TASK_NAME_LEN && task.name[i] != '\0'; ++i)
+        {
+            stats.name[i] = task.name[i];
+        }
+        stats.core = task.core;
+        stats.priority = task.priority;
+        stats.period = task.period;
+        stats.deadline = task.deadline;
+        stats.runs = task.runs;
+        stats.overruns = task.overruns;
+        stats.skips = task.skips;
+        stats.execMax = task.execMax;
+        stats.execAve = task.runs > 0 ? task.execTotal / task.runs : 0;
+        stats.latencyMax = task.latencyMax;
+    }
+
+    void resetStats()
+    {
+        for (byte i = 0; i < getCount(); ++i)
+        {
+            resetStats(_pTasks[i]);
+        }
+    }
+
+protected:
+    SchedulerTask *_pTasks;
+    byte _count; // getCount()で読む
+    critical_section_t _critSec;
+
+    /// @brief signal()はロックを取らないので、フラグはアトミックに読み書きする
+    static bool isPending(SchedulerTask &task)
+    {
+        return __atomic_load_n(&task.pending, __ATOMIC_RELAXED);
+    }
+
+    /// @brief ロックなしで起動できるタスクがあるかを見る
+    /// 読み違えても次の呼び出しで拾い直すだけなので、確定はrun()のロックの中で行う
+    /// @param wake なければ次に起動するタスクの時刻
+    bool findReady(byte core, byte count, uint32_t now, uint32_t &wake)
+    {
+        wake = now + SCHED_IDLE_MAX;
+        for (byte i = 0; i < count; ++i)
+        {
+            SchedulerTask &task = _pTasks[i];
+            if (task.core != core && task.core != TASK_CORE_ANY)
+            {
+                continue;
+            }
+            if (isPending(task))
+            {
+                return true;
+            }
+            if (task.period > 0)
+            {
+                if ((int32_t)(now - task.release) >= 0)
+                {
+                    return true;
+                }
+                if ((int32_t)(task.release - wake) < 0)
+                {
+                    wake = task.release;
+                }
+            }
+        }
+        return false;
+    }
+
+    void resetStats(SchedulerTask &task)
+    {
+        task.runs = 0;
+        task.overruns = 0;
+        task.skips = 0;
+        task.execMax = 0;
+        task.execTotal = 0;
+        task.latencyMax = 0;
+    }
+
+    void updateStats(SchedulerTask &task, uint32_t release, uint32_t start, uint32_t end)
+    {
+        uint32_t exec = end - start;
+        task.runs++;
+        task.execTotal += exec;
+        task.execMax = max(task.execMax, exec);
+        task.latencyMax = max(task.latencyMax, start - release);
+        if (task.deadline > 0 && end - release > task.deadline)
+        {
+            task.overruns++;
+        }
+    }
+};
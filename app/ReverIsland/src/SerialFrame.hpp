@@ -0,0 +1,155 @@
+/*!
+ * SerialFrame
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// フレーム形式
+// [SYNC0][SYNC1][TYPE][LEN][PAYLOAD x LEN][SUM0][SUM1]
+// SUMはTYPE～PAYLOADのFletcher-16。マルチバイト値はリトルエンディアン
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_HEADER_SIZE 4
+#define FRAME_FOOTER_SIZE 2
+#define FRAME_PAYLOAD_MAX 255
+#define FRAME_SIZE_MAX (FRAME_HEADER_SIZE + FRAME_PAYLOAD_MAX + FRAME_FOOTER_SIZE)
+
+#define FRAME_TYPE_TELEMETRY 0x01
+#define FRAME_TYPE_TRACE 0x02
+#define FRAME_TYPE_TASK_STATS 0x03
+#define FRAME_TYPE_AUTOMATION 0x04
+#define FRAME_TYPE_SCOPE_MEASURE 0x05
+#define FRAME_TYPE_CONTROL_VM 0x06
+#define FRAME_TYPE_BOOT 0x07
+#define FRAME_TYPE_DISPLAY_MIRROR 0x08
+// 本体どうしの連携(UART)
+#define FRAME_TYPE_LINK_PRESET 0x10
+#define FRAME_TYPE_LINK_POTS 0x11
+
+static uint16_t fletcher16(const byte *pData, uint16_t length)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        // 除算を避けて剰余を取る
+        sum1 += pData[i];
+        if (sum1 >= 255)
+            sum1 -= 255;
+        sum2 += sum1;
+        if (sum2 >= 255)
+            sum2 -= 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+/// @brief フレームを組み立てる
+/// @param pFrame FRAME_SIZE_MAXバイト
+/// @return フレームのバイト数
+static uint16_t buildFrame(byte *pFrame, byte type, const void *pPayload, byte length)
+{
+    const byte *pData = (const byte *)pPayload;
+    pFrame[0] = FRAME_SYNC0;
+    pFrame[1] = FRAME_SYNC1;
+    pFrame[2] = type;
+    pFrame[3] = length;
+    for (byte i = 0; i < length; ++i)
+    {
+        pFrame[FRAME_HEADER_SIZE + i] = pData[i];
+    }
+
+    uint16_t sum = fletcher16(&pFrame[2], length + 2);
+    pFrame[FRAME_HEADER_SIZE + length] = sum & 0xFF;
+    pFrame[FRAME_HEADER_SIZE + length + 1] = sum >> 8;
+    return FRAME_HEADER_SIZE + length + FRAME_FOOTER_SIZE;
+}
+
+/// @brief 受信バイト列からフレームを組み立てる
+/// フレーム外のバイトは1バイトコマンドとして扱う
+class FrameReader
+{
+public:
+    FrameReader()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _stage = 0;
+        _index = 0;
+    }
+
+    /// @brief 1バイト入力
+    /// @param value
+    /// @return 0:処理中 1:フレーム完成 2:1バイトコマンド
+    byte put(byte value)
+    {
+        switch (_stage)
+        {
+        case 0:
+            if (value == FRAME_SYNC0)
+            {
+                _stage = 1;
+                return 0;
+            }
+            _command = value;
+            return 2;
+        case 1:
+            _stage = value == FRAME_SYNC1 ? 2 : 0;
+            return 0;
+        case 2:
+            _frame[0] = value;
+            _stage = 3;
+            return 0;
+        case 3:
+            _frame[1] = value;
+            _index = 0;
+            _stage = 4;
+            return 0;
+        default:
+            _frame[2 + _index] = value;
+            _index++;
+            // TYPE,LEN + PAYLOAD + SUM x2
+            if (_index < _frame[1] + FRAME_FOOTER_SIZE)
+            {
+                return 0;
+            }
+
+            _stage = 0;
+            uint16_t sum = _frame[2 + _frame[1]] | (_frame[3 + _frame[1]] << 8);
+            return sum == fletcher16(_frame, _frame[1] + 2) ? 1 : 0;
+        }
+    }
+
+    byte getType()
+    {
+        return _frame[0];
+    }
+
+    byte getLength()
+    {
+        return _frame[1];
+    }
+
+    const byte *getPayload()
+    {
+        return &_frame[2];
+    }
+
+    byte getCommand()
+    {
+        return _command;
+    }
+
+protected:
+    byte _stage;
+    uint16_t _index;
+    byte _command;
+    byte _frame[2 + FRAME_PAYLOAD_MAX + FRAME_FOOTER_SIZE];
+};
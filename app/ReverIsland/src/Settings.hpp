@@ -11,29 +11,102 @@
 #include <U8g2lib.h>
 #include "GpioSet.h"
 #include "ParamGroup.hpp"
+#include "Presets.hpp"
 
-#define EXSETMENU_MAX 1
+#define EXSETMENU_MAX 8
 
 // プリセット名やパラメタ名などは、EEPROMには入ってないしEEPROMを直接読まないのでここで都度定義する必要がある
 const static char *settingNames[EXSETMENU_MAX][4] = {
     // INTERNAL PRESETS
     {"CV Assig Setting", "Mode       ", "Dest Pot No", "Depth      "},
+    {"CV Preset Select", "Hysteresis%", "Settle ms  ", "Slots      "},
+    {"Scope Trigger   ", "Mode       ", "Edge       ", "Level      "},
+    {"Scope Capture   ", "Pre-trig   ", "Holdoff    ", "-----------"},
+    {"Scope Display   ", "Mode       ", "Avg 2^n    ", "Persist Dcy"},
+    {"Scope Probe     ", "Source A   ", "Source B   ", "-----------"},
+    {"Preset Browse   ", "Settle x100", "Repeat x10 ", "-----------"},
+    {"Unit Link       ", "Mode       ", "Send Pots  ", "-----------"},
 };
 
 extern byte mode0;
 extern byte mode1;
 extern byte mode2;
+extern byte mode3;
+extern byte mode4;
+extern byte mode5;
+extern byte mode6;
+extern byte mode7;
+extern byte mode8;
+extern byte mode9;
 
 extern byte minValue;
-static byte maxCVMode = 2;
+static byte maxCVMode = 3;
 static byte maxCV2Pot = POTS_MAX - 1;
 static byte maxCVDepth = 100;
+static byte maxCVHysteresis = 50;
+static byte maxCVSettle = 100;
+static byte minCVSlots = 2;
+static byte maxCVSlots = PRESET_TOTAL;
+static byte maxTrigMode = 2;
+static byte maxTrigEdge = 1;
+static byte maxTrigLevel = 127;
+static byte maxPreTrig = 90;
+static byte maxHoldoff = 127;
+static byte maxNone = 1;
+static byte maxScopeDisp = 3;
+static byte minShift = 1;
+static byte maxShift = 6;
+static byte maxProbe = PROBE_SIGNAL_MAX;
+static byte maxBrowseSettle = 30;
+static byte minBrowseRepeat = 2;
+static byte maxBrowseRepeat = 50;
+static byte maxLinkMode = 2;
 static ParamGroup settingGroup[EXSETMENU_MAX];
 
 byte assignCVMode = 0;
 byte assignCV2Pot = 2;
 byte assignCVDepth = 50;
 
+// CVでのプリセット選択(CV Assig Modeがpresetのとき)
+#define CV_MODE_PRESET 3
+// CV全域をSlots等分してプリセット0から割り当てる
+byte cvPresetHysteresis = 20;
+byte cvPresetSettle = 2;
+byte cvPresetSlots = PRESET_TOTAL;
+
+// オシロスコープのトリガ設定
+// Levelは0で自動（直前の波形の中間）、1～127で0～5V
+// Holdoffは8サンプル単位
+byte scopeTrigMode = 0;
+byte scopeTrigEdge = 0;
+byte scopeTrigLevel = 0;
+byte scopePreTrig = 10;
+byte scopeHoldoff = 0;
+static byte noneValue = 0;
+
+// オシロスコープの表示設定
+// Avgは2^nフレームの平均、Persist Dcyは残光が1フレームで1/2^nずつ減る
+// deepは1回の長い取り込みをポット0でズーム、ポット1でパンして見る
+byte scopeDispMode = 0;
+byte scopeAvgShift = 3;
+byte scopePersistShift = 3;
+
+// オシロスコープの入力。0はCVピン(Bは表示なし)、1以降は制御周期の中の信号(PROBE_*+1)
+// Bは2本目の波形で、Aがプローブのときだけ使う
+byte scopeProbeA = 0;
+byte scopeProbeB = 0;
+
+// ボタンでのプリセット送り
+// Settleは最後に送ってから切り替えるまでの時間(100ms単位)。0なら押すたびに切り替える
+// Repeatは送っている途中で長押ししたときの送り間隔(10ms単位)
+byte presetSettle = 4;
+byte presetRepeat = 15;
+
+// 本体どうしの連携(UnitLink.hpp)。0:off 1:先導 2:追従
+// Send Potsは先導側のときパラメタ値も送る
+byte linkMode = 0;
+byte linkPots = 0;
+
 static byte *settingValues[EXSETMENU_MAX][POTS_MAX][4] =
 {
     {
@@ -41,6 +114,41 @@ static byte *settingValues[EXSETMENU_MAX][POTS_MAX][4] =
         {&assignCV2Pot, &minValue, &maxCV2Pot, &mode1},
         {&assignCVDepth, &minValue, &maxCVDepth, &mode1}, 
     },
+    {
+        {&cvPresetHysteresis, &minValue, &maxCVHysteresis, &mode1},
+        {&cvPresetSettle, &minValue, &maxCVSettle, &mode1},
+        {&cvPresetSlots, &minCVSlots, &maxCVSlots, &mode1},
+    },
+    {
+        {&scopeTrigMode, &minValue, &maxTrigMode, &mode3},
+        {&scopeTrigEdge, &minValue, &maxTrigEdge, &mode4},
+        {&scopeTrigLevel, &minValue, &maxTrigLevel, &mode1},
+    },
+    {
+        {&scopePreTrig, &minValue, &maxPreTrig, &mode1},
+        {&scopeHoldoff, &minValue, &maxHoldoff, &mode1},
+        {&noneValue, &minValue, &maxNone, &mode0},
+    },
+    {
+        {&scopeDispMode, &minValue, &maxScopeDisp, &mode5},
+        {&scopeAvgShift, &minShift, &maxShift, &mode1},
+        {&scopePersistShift, &minShift, &maxShift, &mode1},
+    },
+    {
+        {&scopeProbeA, &minValue, &maxProbe, &mode6},
+        {&scopeProbeB, &minValue, &maxProbe, &mode7},
+        {&noneValue, &minValue, &maxNone, &mode0},
+    },
+    {
+        {&presetSettle, &minValue, &maxBrowseSettle, &mode1},
+        {&presetRepeat, &minBrowseRepeat, &maxBrowseRepeat, &mode1},
+        {&noneValue, &minValue, &maxNone, &mode0},
+    },
+    {
+        {&linkMode, &minValue, &maxLinkMode, &mode8},
+        {&linkPots, &minValue, &maxNone, &mode9},
+        {&noneValue, &minValue, &maxNone, &mode0},
+    },
 };
 
 void initSettings(U8G2 *pU8g2)
@@ -53,12 +161,12 @@ void initSettings(U8G2 *pU8g2)
     }
 }
 
-void dispSettings(U8G2 *pU8g2, uint16_t values[POTS_MAX])
+void dispSettings(U8G2 *pU8g2, byte index, uint16_t values[POTS_MAX])
 {
     pU8g2->clearBuffer();
 
-    settingGroup[0].dispParamGroup(values);
-    settingGroup[0].dispTitle();
+    settingGroup[index].dispParamGroup(values);
+    settingGroup[index].dispTitle();
 
     pU8g2->sendBuffer();
 }
\ No newline at end of file
@@ -8,16 +8,14 @@
 #pragma once
 
 #include <Arduino.h>
+#include "Board.hpp"
 
-class SmoothAnalogRead
+/// @brief 平均＋ローパスのアナログ入力。ピンの読み方は派生側のreadPinで決める
+/// 仮想関数にせず静的に呼び分けるので、16回読みのループ内で読み出しが展開される
+template <typename Derived>
+class SmoothAnalogReadBase
 {
 public:
-    SmoothAnalogRead() {}
-    SmoothAnalogRead(byte pin)
-    {
-        init(pin);
-    }
-    
     /// @brief ピン設定
     /// @param pin
     void init(byte pin)
@@ -25,12 +23,13 @@ public:
         _pin = pin;
         _value = 0;
         _valueOld = 65535;
-        pinMode(pin, INPUT);
+        _rawValue = 0;
+        Board::initAnalog(pin);
     }
 
     uint16_t analogReadDirect()
     {
-        return readPin();
+        return self().readPin();
     }
 
     uint16_t analogRead(bool smooth = true)
@@ -40,7 +39,7 @@ public:
         int aval = 0;
         for (byte i = 0; i < 16; ++i)
         {
-            aval += readPin();
+            aval += self().readPin();
         }
         // 実測による調整
         // 10bit
@@ -48,19 +47,46 @@ public:
         // _value = (_value * 0.8) + (aval * 0.2014);
         // 12bit
         aval = max(((aval >> 4) - 16), 0);
+        _rawValue = aval;
         _value = (_value * 0.95) + (aval * 0.05044);
-        // Serial.print(aval);
-        // Serial.print(",");
-        // Serial.println(_value);
         _value = smooth ? _value : aval;
         return _value;
     }
 
+    /// @brief 起動時用。多めに読んだ平均でフィルタを埋め、ローパスの立ち上がりを待たない
+    /// @param count 読む回数(256まで)
+    uint16_t seed(uint16_t count = 64)
+    {
+        uint32_t aval = 0;
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            aval += self().readPin();
+        }
+        _rawValue = max((int)(aval / count) - 16, 0);
+        _value = _rawValue;
+        _valueOld = _value;
+        return _value;
+    }
+
+    /// @brief フィルタの値を直接置く
+    void setValue(uint16_t value)
+    {
+        _value = value;
+        _valueOld = value;
+    }
+
     uint16_t getValue()
     {
         return _value;
     }
 
+    /// @brief フィルタ前の値（16回平均のみ）
+    /// @return
+    uint16_t getRawValue()
+    {
+        return _rawValue;
+    }
+
     bool hasChanged()
     {
         return _valueOld != _value;
@@ -70,11 +96,35 @@ protected:
     byte _pin;
     uint16_t _value;
     uint16_t _valueOld;
+    uint16_t _rawValue;
+
+    Derived &self()
+    {
+        return *static_cast<Derived *>(this);
+    }
 
     /// @brief ピン値読込
     /// @return
-    virtual uint16_t readPin()
+    inline uint16_t readPinDirect()
+    {
+        return Board::analogRead(_pin);
+    }
+};
+
+class SmoothAnalogRead : public SmoothAnalogReadBase<SmoothAnalogRead>
+{
+    friend class SmoothAnalogReadBase<SmoothAnalogRead>;
+
+public:
+    SmoothAnalogRead() {}
+    SmoothAnalogRead(byte pin)
+    {
+        init(pin);
+    }
+
+protected:
+    inline uint16_t readPin()
     {
-        return ::analogRead(_pin);
+        return readPinDirect();
     }
 };
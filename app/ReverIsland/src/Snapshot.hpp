@@ -0,0 +1,107 @@
+/*!
+ * Snapshot class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "Board.hpp"
+#include "SerialFrame.hpp"
+
+#define SNAPSHOT_MAGIC 0x52495331 // "RIS1"
+#define SNAPSHOT_VERSION 2
+// EEPROMはフラッシュの1セクタを使う。arduino-picoでは256バイト以上
+#define SNAPSHOT_EEPROM_SIZE 256
+// 最後に変わってからこれだけ落ち着いたら書く。フラッシュの書き換え回数を抑える
+#define SNAPSHOT_IDLE_MICROS 5000000
+
+/// @brief 電源を切る前の状態。起動時にこれで出力とフィルタを戻す
+struct __attribute__((packed)) SnapshotData
+{
+    uint32_t magic;
+    byte version;
+    int8_t presetIndex;
+    uint16_t paramValues[POTS_MAX]; // FV-1へ出していた値
+    uint16_t potValues[POTS_MAX];   // ポットのフィルタ後の値
+    byte linkMode;                  // 本体どうしの連携の設定
+    byte linkPots;
+    uint16_t sum;
+};
+
+/// @brief 状態をフラッシュへ保存する
+/// 書き込み中(数十ms)はもう一方のコアも止まるので、状態が落ち着いたときに変わった分だけ書く
+class Snapshot
+{
+public:
+    Snapshot()
+    {
+        _begun = false;
+        _dirty = false;
+        _changedMicros = 0;
+        memset(&_saved, 0, sizeof(SnapshotData));
+        memset(&_pending, 0, sizeof(SnapshotData));
+    }
+
+    /// @brief 保存されている状態を読む
+    /// @return 有効な状態があればtrue
+    bool load(SnapshotData &data)
+    {
+        begin();
+        EEPROM.get(0, data);
+        bool valid = data.magic == SNAPSHOT_MAGIC && data.version == SNAPSHOT_VERSION &&
+                     data.sum == fletcher16((const byte *)&data, sizeof(SnapshotData) - sizeof(uint16_t));
+        if (valid)
+        {
+            _saved = data;
+        }
+        return valid;
+    }
+
+    /// @brief 現在の状態を渡す。落ち着いていれば書く
+    /// @return 書いたらtrue
+    bool update(const SnapshotData &current, uint32_t now)
+    {
+        SnapshotData data = current;
+        data.magic = SNAPSHOT_MAGIC;
+        data.version = SNAPSHOT_VERSION;
+        data.sum = fletcher16((const byte *)&data, sizeof(SnapshotData) - sizeof(uint16_t));
+        if (memcmp(&data, &_pending, sizeof(SnapshotData)) != 0)
+        {
+            _pending = data;
+            _changedMicros = now;
+            _dirty = memcmp(&data, &_saved, sizeof(SnapshotData)) != 0;
+            return false;
+        }
+        if (!_dirty || now - _changedMicros < SNAPSHOT_IDLE_MICROS)
+        {
+            return false;
+        }
+
+        begin();
+        EEPROM.put(0, _pending);
+        EEPROM.commit();
+        _saved = _pending;
+        _dirty = false;
+        return true;
+    }
+
+protected:
+    bool _begun;
+    bool _dirty;
+    uint32_t _changedMicros;
+    SnapshotData _saved;
+    SnapshotData _pending;
+
+    void begin()
+    {
+        if (!_begun)
+        {
+            EEPROM.begin(SNAPSHOT_EEPROM_SIZE);
+            _begun = true;
+        }
+    }
+};
@@ -0,0 +1,125 @@
+/*!
+ * Telemetry class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "RingBuffer.hpp"
+#include "SerialFrame.hpp"
+#include "GpioSet.h"
+
+#define TELEMETRY_BUF_SIZE 4096
+
+/// @brief 制御周期1回分の計測値
+struct __attribute__((packed)) TelemetryRecord
+{
+    uint32_t micros;
+    uint16_t potRaw[POTS_MAX];
+    uint16_t potValue[POTS_MAX];
+    uint16_t cvRaw;
+    uint16_t cvValue;
+    uint16_t pwm[POTS_MAX];
+    uint8_t presetIndex;
+    uint8_t dispMode;
+};
+
+class Telemetry
+{
+public:
+    Telemetry()
+    {
+        _enable = false;
+        _dropCount = 0;
+    }
+
+    void start()
+    {
+        _buff.clear();
+        _dropCount = 0;
+        _enable = true;
+    }
+
+    void stop()
+    {
+        _enable = false;
+    }
+
+    bool isEnabled()
+    {
+        return _enable;
+    }
+
+    /// @brief バッファがあふれて捨てたフレーム数
+    uint32_t getDropCount()
+    {
+        return _dropCount;
+    }
+
+    /// @brief 送信バッファの空きバイト数
+    uint16_t getFree()
+    {
+        return _buff.free();
+    }
+
+    /// @brief フレームを組み立ててバッファへ入れる。満杯なら捨てて即戻る
+    /// @param type フレーム種別
+    /// @param pPayload
+    /// @param length
+    /// @return 入らなければfalse
+    bool pushFrame(byte type, const void *pPayload, byte length)
+    {
+        byte frame[FRAME_SIZE_MAX];
+        uint16_t size = buildFrame(frame, type, pPayload, length);
+        if (!_buff.push(frame, size))
+        {
+            _dropCount++;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool push(const TelemetryRecord &record)
+    {
+        if (!_enable)
+        {
+            return false;
+        }
+
+        return pushFrame(FRAME_TYPE_TELEMETRY, &record, sizeof(TelemetryRecord));
+    }
+
+    /// @brief 出力先の空き分だけ書き出す。ブロックしない
+    /// @param stream USB CDCなど
+    void drain(Stream &stream)
+    {
+        int writable = stream.availableForWrite();
+        while (writable > 0)
+        {
+            const byte *pData;
+            uint16_t count = _buff.peekContiguous(&pData);
+            if (count == 0)
+            {
+                break;
+            }
+
+            count = min(count, (uint16_t)writable);
+            count = stream.write(pData, count);
+            if (count == 0)
+            {
+                break;
+            }
+            _buff.consume(count);
+            writable -= count;
+        }
+    }
+
+protected:
+    RingBuffer<byte, TELEMETRY_BUF_SIZE> _buff;
+    volatile bool _enable;
+    uint32_t _dropCount;
+};
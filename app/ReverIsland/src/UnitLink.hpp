@@ -0,0 +1,258 @@
+/*!
+ * UnitLink class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <pico/rand.h>
+#include "SerialFrame.hpp"
+#include "GpioSet.h"
+
+#define LINK_MODE_OFF 0
+#define LINK_MODE_LEADER 1
+#define LINK_MODE_FOLLOWER 2
+
+// 1フレーム(最大13バイト)が制御周期1回より十分短く送れる速さ
+#define LINK_BAUD 500000
+// 後から電源を入れた追従側も揃うよう、変化がなくてもこの間隔で送り直す
+#define LINK_HEARTBEAT_MICROS 500000
+// この間ポット値が来なければ追従側は自分のポットに戻す
+#define LINK_POTS_TIMEOUT_MICROS 1000000
+
+/// @brief プリセットの通知。連番は変えたときだけ進む(送り直しは同じ連番)
+/// 先導側は起動ごとにepochを選び直す。再起動して連番が1から戻っても追従側は別の通知として受ける
+struct __attribute__((packed)) LinkPreset
+{
+    uint32_t epoch;
+    byte seq;
+    int8_t presetIndex;
+};
+
+/// @brief FV-1へ出しているパラメタ値
+struct __attribute__((packed)) LinkPots
+{
+    uint16_t values[POTS_MAX];
+};
+
+/// @brief 複数の本体のプリセットとパラメタを揃える
+/// 先導側は制御周期の終わりにpublish()で変化をフレームにして送り、追従側は次の周期の始めにreceive()で反映する
+/// 送信は出力側の空きがあるときだけ行いブロックしない。取りこぼしは定期的な送り直しで埋まる
+class UnitLink
+{
+public:
+    UnitLink()
+    {
+        _pStream = NULL;
+        _mode = LINK_MODE_OFF;
+        _pots = false;
+        _epoch = 0;
+        _seq = 0;
+        _sentIndex = -1;
+        _sentMicros = 0;
+        _potsSent = false;
+        _appliedEpoch = 0;
+        _appliedSeq = -1;
+        _potsActive = false;
+        _potsMicros = 0;
+        _rxCount = 0;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            _sentPots[i] = 0;
+            _potValues[i] = 0;
+        }
+    }
+
+    void begin(Stream *pStream)
+    {
+        _pStream = pStream;
+        _epoch = get_rand_32();
+    }
+
+    /// @brief 動作の切り替え
+    /// @param mode LINK_MODE_*
+    /// @param pots 先導側のときポット値も送る
+    void setMode(byte mode, bool pots)
+    {
+        if (mode == _mode && pots == _pots)
+        {
+            return;
+        }
+        _mode = mode;
+        _pots = pots;
+        // 切り替えたら最初から送り直し、受けた値も捨てる
+        _sentIndex = -1;
+        _potsSent = false;
+        _appliedSeq = -1;
+        _potsActive = false;
+        _reader.reset();
+    }
+
+    byte getMode()
+    {
+        return _mode;
+    }
+
+    /// @brief 受けた正しいフレーム数
+    uint32_t getRxCount()
+    {
+        return _rxCount;
+    }
+
+    /// @brief 先導側。変化があれば送る。制御周期ごとに呼ぶ
+    void publish(int8_t presetIndex, const uint16_t values[POTS_MAX], uint32_t now)
+    {
+        if (_mode != LINK_MODE_LEADER || _pStream == NULL)
+        {
+            return;
+        }
+
+        bool heartbeat = now - _sentMicros >= LINK_HEARTBEAT_MICROS;
+        if (presetIndex != _sentIndex || heartbeat)
+        {
+            LinkPreset preset;
+            preset.epoch = _epoch;
+            preset.seq = presetIndex != _sentIndex ? _seq + 1 : _seq;
+            preset.presetIndex = presetIndex;
+            if (write(FRAME_TYPE_LINK_PRESET, &preset, sizeof(LinkPreset)))
+            {
+                _seq = preset.seq;
+                _sentIndex = presetIndex;
+                _sentMicros = now;
+            }
+        }
+
+        if (!_pots)
+        {
+            return;
+        }
+
+        bool changed = !_potsSent || heartbeat;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            changed = changed || values[i] != _sentPots[i];
+        }
+        // 追従側の期限切れより短い間隔で必ず送る
+        changed = changed || now - _potsMicros >= LINK_POTS_TIMEOUT_MICROS / 4;
+        if (!changed)
+        {
+            return;
+        }
+
+        LinkPots pots;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            pots.values[i] = values[i];
+        }
+        if (write(FRAME_TYPE_LINK_POTS, &pots, sizeof(LinkPots)))
+        {
+            for (byte i = 0; i < POTS_MAX; ++i)
+            {
+                _sentPots[i] = values[i];
+            }
+            _potsSent = true;
+            _potsMicros = now;
+        }
+    }
+
+    /// @brief 追従側。届いている分を読む。制御周期の始めに呼ぶ
+    /// 送り直しは通知しないので、手元で変えたプリセットは先導側が次に変えるか再起動するまで保つ
+    /// @param preset 新しいプリセットの通知
+    /// @return 新しいプリセットの通知があればtrue
+    bool receive(uint32_t now, LinkPreset &preset)
+    {
+        if (_mode != LINK_MODE_FOLLOWER || _pStream == NULL)
+        {
+            return false;
+        }
+
+        bool result = false;
+        while (_pStream->available() > 0)
+        {
+            if (_reader.put(_pStream->read()) != 1)
+            {
+                continue;
+            }
+
+            _rxCount++;
+            if (_reader.getType() == FRAME_TYPE_LINK_PRESET && _reader.getLength() == sizeof(LinkPreset))
+            {
+                LinkPreset received;
+                memcpy(&received, _reader.getPayload(), sizeof(LinkPreset));
+                if (received.epoch != _appliedEpoch || received.seq != _appliedSeq)
+                {
+                    _appliedEpoch = received.epoch;
+                    _appliedSeq = received.seq;
+                    preset = received;
+                    result = true;
+                }
+            }
+            else if (_reader.getType() == FRAME_TYPE_LINK_POTS && _reader.getLength() == sizeof(LinkPots))
+            {
+                LinkPots pots;
+                memcpy(&pots, _reader.getPayload(), sizeof(LinkPots));
+                for (byte i = 0; i < POTS_MAX; ++i)
+                {
+                    _potValues[i] = pots.values[i];
+                }
+                _potsActive = true;
+                _potsMicros = now;
+            }
+        }
+
+        if (_potsActive && now - _potsMicros >= LINK_POTS_TIMEOUT_MICROS)
+        {
+            _potsActive = false;
+        }
+        return result;
+    }
+
+    /// @brief 追従側。先導側のポット値で上書きするか
+    bool isPotActive()
+    {
+        return _mode == LINK_MODE_FOLLOWER && _potsActive;
+    }
+
+    uint16_t getPotValue(byte index)
+    {
+        return _potValues[index];
+    }
+
+protected:
+    Stream *_pStream;
+    FrameReader _reader;
+    byte _mode;
+    bool _pots;
+
+    // 先導側
+    uint32_t _epoch;
+    byte _seq;
+    int8_t _sentIndex;
+    uint32_t _sentMicros;
+    bool _potsSent;
+    uint16_t _sentPots[POTS_MAX];
+
+    // 追従側
+    uint32_t _appliedEpoch;
+    int16_t _appliedSeq;
+    bool _potsActive;
+    uint32_t _potsMicros; // 先導側では最後に送った時刻
+    uint16_t _potValues[POTS_MAX];
+    uint32_t _rxCount;
+
+    /// @brief 1フレーム丸ごと入るときだけ書く
+    bool write(byte type, const void *pPayload, byte length)
+    {
+        byte frame[FRAME_SIZE_MAX];
+        uint16_t size = buildFrame(frame, type, pPayload, length);
+        if (_pStream->availableForWrite() < size)
+        {
+            return false;
+        }
+        _pStream->write(frame, size);
+        return true;
+    }
+};
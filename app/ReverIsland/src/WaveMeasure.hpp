@@ -0,0 +1,187 @@
+/*!
+ * WaveMeasure class
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/// @brief 1回の取り込みの測定結果。テレメトリにもこの並びで送る
+struct __attribute__((packed)) ScopeMeasure
+{
+    uint32_t micros;    // 取り込み終了時刻
+    uint32_t periodNs;  // 周期。立ち上がりが2回未満なら0
+    uint32_t freqMilli; // 周波数(mHz)。周期が0なら0
+    uint16_t vpp;       // 以下ADC値
+    uint16_t mean;
+    uint16_t rms;
+    uint16_t duty;      // 0.1%単位
+    uint16_t samples;
+    uint16_t edges;     // 立ち上がりの回数
+};
+
+/// @brief 波形の測定。サンプルごとに積算だけを行い、終わりに1回だけ割り算する
+/// 取り込みの長さによらず1サンプルあたりの処理は一定
+/// 周期は中間レベルの立ち上がり(ヒステリシス付き)の間隔を、隣り合う2点の直線補間で1/256サンプルまで求める
+class WaveMeasure
+{
+public:
+    WaveMeasure()
+    {
+        begin(2048, 64);
+    }
+
+    /// @brief 積算開始
+    /// @param level 周期とデューティを判定するレベル
+    /// @param hysteresis 立ち上がりとみなす前にlevelからこれだけ下がっている必要がある
+    void begin(int16_t level, int16_t hysteresis)
+    {
+        _level = level;
+        _hysteresis = hysteresis;
+        _count = 0;
+        _sum = 0;
+        _sumSq = 0;
+        _min = INT16_MAX;
+        _max = INT16_MIN;
+        _armed = false;
+        _edges = 0;
+        _high = 0;
+        _prev = 0;
+        _startMicros = micros();
+        _endMicros = _startMicros;
+    }
+
+    /// @brief 1サンプル積算
+    inline void put(int16_t value)
+    {
+        if (_count == 0)
+        {
+            _startMicros = micros();
+        }
+
+        _sum += value;
+        _sumSq += (uint32_t)((int32_t)value * value);
+        _min = min(_min, value);
+        _max = max(_max, value);
+
+        if (value >= _level)
+        {
+            _high++;
+            if (_armed && _count > 0)
+            {
+                // 前のサンプルからの補間位置(1/256サンプル)
+                uint32_t cross = ((uint32_t)(_count - 1) << 8) + (((int32_t)(_level - _prev) << 8) / (value - _prev));
+                if (_edges == 0)
+                {
+                    _firstCross = cross;
+                    _firstHigh = _high;
+                }
+                _lastCross = cross;
+                _lastHigh = _high;
+                _edges++;
+                _armed = false;
+            }
+        }
+        else if (value < _level - _hysteresis)
+        {
+            _armed = true;
+        }
+
+        _prev = value;
+        _count++;
+    }
+
+    /// @brief 積算を終えて結果を出す
+    void end(ScopeMeasure &result)
+    {
+        _endMicros = micros();
+        result.micros = _endMicros;
+        result.samples = min(_count, (uint32_t)UINT16_MAX);
+        result.edges = _edges;
+        result.periodNs = 0;
+        result.freqMilli = 0;
+        result.duty = 0;
+        if (_count == 0)
+        {
+            result.vpp = 0;
+            result.mean = 0;
+            result.rms = 0;
+            return;
+        }
+
+        result.vpp = _max - _min;
+        result.mean = _sum / (int32_t)_count;
+        result.rms = isqrt(_sumSq / _count);
+
+        uint32_t span = _lastCross - _firstCross;
+        if (_edges < 2 || span == 0 || _count < 2)
+        {
+            return;
+        }
+
+        // サンプル間隔は取り込み時間の実測から。変換時間のばらつきも含めた平均になる
+        uint64_t elapsedNs = (uint64_t)(_endMicros - _startMicros) * 1000;
+        uint64_t periodNs = (elapsedNs * span) / (((uint64_t)(_count - 1) * (_edges - 1)) << 8);
+        periodNs = min(periodNs, (uint64_t)UINT32_MAX);
+        result.periodNs = periodNs;
+        result.freqMilli = periodNs > 0 ? 1000000000000ULL / periodNs : 0;
+        uint32_t duty = (uint64_t)(_lastHigh - _firstHigh) * 1000 / max(span >> 8, (uint32_t)1);
+        result.duty = min(duty, (uint32_t)1000);
+    }
+
+    int16_t getMin()
+    {
+        return _min;
+    }
+
+    int16_t getMax()
+    {
+        return _max;
+    }
+
+protected:
+    int16_t _level;
+    int16_t _hysteresis;
+    uint32_t _count;
+    int32_t _sum;
+    uint64_t _sumSq;
+    int16_t _min;
+    int16_t _max;
+    bool _armed;
+    uint16_t _edges;
+    uint32_t _high;
+    uint32_t _firstHigh;
+    uint32_t _lastHigh;
+    uint32_t _firstCross;
+    uint32_t _lastCross;
+    int16_t _prev;
+    uint32_t _startMicros;
+    uint32_t _endMicros;
+
+    static uint16_t isqrt(uint32_t value)
+    {
+        uint32_t result = 0;
+        uint32_t bit = 1UL << 30;
+        while (bit > value)
+        {
+            bit >>= 2;
+        }
+        while (bit != 0)
+        {
+            if (value >= result + bit)
+            {
+                value -= result + bit;
+                result = (result >> 1) + bit;
+            }
+            else
+            {
+                result >>= 1;
+            }
+            bit >>= 2;
+        }
+        return result;
+    }
+};
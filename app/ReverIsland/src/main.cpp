@@ -12,24 +12,72 @@
 #include "EzOscilloscope.hpp"
 #include "Presets.hpp"
 #include "Settings.hpp"
+#include "Telemetry.hpp"
+#include "InputTrace.hpp"
+#include "Scheduler.hpp"
+#include "Automation.hpp"
+#include "CVQuantizer.hpp"
+#include "ControlVM.hpp"
+#include "ProbeBus.hpp"
+#include "PresetBrowser.hpp"
+#include "Snapshot.hpp"
+#include "BootLog.hpp"
+#include "DisplayMirror.hpp"
+#include "UnitLink.hpp"
 #include "GpioSet.h"
 
 // 操作関係
-static Button sw0;
-static Button sw1;
-static SmoothAnalogRead pots[POTS_MAX];
+static TraceButton sw0;
+static TraceButton sw1;
+static TraceAnalogRead pots[POTS_MAX];
 static uint potSlices[POTS_MAX] = {0};
 static uint potChs[POTS_MAX] = {PWM_CHAN_A, PWM_CHAN_B, PWM_CHAN_A};
-static uint pwmPotGpios[POTS_MAX] = {PWM_POT0, PWM_POT1, PWM_POT2};
+static uint pwmPotGpios[POTS_MAX] = {Board::PWM_POT0, Board::PWM_POT1, Board::PWM_POT2};
 
-static SmoothAnalogRead cv;
+static TraceAnalogRead cv;
+static CVQuantizer cvPreset;
+// オシロスコープはCPU 2から読むので制御用とは別に持つ
+static SmoothAnalogRead cvScope;
 static EzOscilloscope ezOscillo;
 
 // 表示関係
 static U8G2_SSD1306_128X64_NONAME_F_HW_I2C u8g2(U8G2_R2, /* reset=*/U8X8_PIN_NONE);
 static int8_t presetIndex = 0;
+// 送りの途中で表示だけ先に切り替えているプリセット。-1なら確定済み
+static volatile int8_t previewIndex = -1;
+static PresetBrowser presetBrowser;
 static uint16_t potValues[POTS_MAX] = {0};
 static uint16_t potSettingValues[POTS_MAX] = {0};
+// 画面のUSBへの写し
+static DisplayMirror displayMirror;
+
+// 計測関係
+static Telemetry telemetry;
+static InputTrace inputTrace;
+static FrameReader frameReader;
+static uint16_t potPulseValues[POTS_MAX] = {0};
+static ProbeBus probeBus;
+
+// 自動操作
+static Automation<PRESET_TOTAL> automation;
+
+// 本体どうしの連携
+static UnitLink unitLink;
+
+// 操作スクリプト。プリセットごとに持つ
+static ControlVM<PRESET_TOTAL> controlVM;
+static byte buttonStates[2] = {0};
+
+// 起動と電源断をまたぐ状態
+static Snapshot snapshot;
+static BootLog bootLog;
+
+// タスク関係
+#define TASK_CONTROL 0
+#define TASK_USB 1
+#define TASK_DISPLAY 2
+#define TASK_SNAPSHOT 3
+static Scheduler scheduler;
 
 void initOLED()
 {
@@ -37,18 +85,21 @@ void initOLED()
     u8g2.setContrast(40);
     u8g2.setFontPosTop();
     u8g2.setDrawColor(2);
-#ifndef PROTO
-    u8g2.setFlipMode(1);
-#endif
+    // 文字もXORで重ねる。背景を塗るとポットの三角形と重なる行を消してしまい、ラベルのキャッシュも使えない
+    u8g2.setFontMode(1);
+    if (Board::DISPLAY_FLIP)
+    {
+        u8g2.setFlipMode(1);
+    }
     initPresets(&u8g2);
     initSettings(&u8g2);
 }
 
+static_assert(PRESET_BANK_COUNT <= Board::ROM_SELECT_MAX, "board has fewer ROM selections than preset banks");
+
 void initRomBit()
 {
-    pinMode(T0, OUTPUT);
-    pinMode(ROM1, OUTPUT);
-    pinMode(ROM2, OUTPUT);
+    Board::initOutput(Board::ROM_MASK);
 }
 
 // プリセットの現在値から現在のROM/EEPROM切り替え設定を行う
@@ -62,43 +113,13 @@ void setRomBit(byte index)
     }
 
     mapIndexOld = mapIndex;
-    byte t0 = LOW;
-    byte rom1 = LOW;
-    byte rom2 = LOW;
-    switch (mapIndex)
-    {
-    case 0:
-        t0 = LOW;
-        rom1 = HIGH;
-        rom2 = HIGH;
-        break;
-    case 1:
-        t0 = HIGH;
-        rom1 = LOW;
-        rom2 = HIGH;
-        break;
-    case 2:
-        t0 = HIGH;
-        rom1 = HIGH;
-        rom2 = LOW;
-        break;
-    default:
-        t0 = LOW;
-        rom1 = HIGH;
-        rom2 = HIGH;
-        break;
-    }
-
-    digitalWrite(T0, t0);
-    digitalWrite(ROM1, rom1);
-    digitalWrite(ROM2, rom2);
+    // 切り替えの組み合わせは基板定義にある
+    Board::setRomSelect(mapIndex);
 }
 
 void initPresetBit()
 {
-    pinMode(S0, OUTPUT);
-    pinMode(S1, OUTPUT);
-    pinMode(S2, OUTPUT);
+    Board::initOutput(Board::PRESET_MASK);
 }
 
 // プリセットの現在値からプリセット設定を行う
@@ -112,9 +133,7 @@ void setPresetBit(byte index)
 
     indexOld = index;
     // presetIndexは8以上入るがretReadで3bitしか読んでないので問題なし
-    digitalWrite(S0, bitRead(index, 0));
-    digitalWrite(S1, bitRead(index, 1));
-    digitalWrite(S2, bitRead(index, 2));
+    Board::setPresetSelect(index);
 }
 
 void initPWMPotsOut()
@@ -146,30 +165,30 @@ su constrainCyclic(su value, su min, su max)
 
 void initController()
 {
-    // internal regulator output mode -> PWM
-    pinMode(23, OUTPUT);
-    digitalWrite(23, HIGH);
+    bootLog.mark(BOOT_SETUP);
 
-    // ADC解像度とパルス出力解像度はあわせること
-    analogReadResolution(POTS_BIT);
-    sw0.init(SW0);
-    sw1.init(SW1);
-    sw0.setHoldTime(1000);
-    sw1.setHoldTime(1000);
-    pots[0].init(POT0);
-    pots[1].init(POT1);
-    pots[2].init(POT2);
+    // 制御周期やUSBのタスクが使うものは、表示のコアの初期化(I2Cで約25ms)を待たずにここで用意する
+    initPresetValues();
+    displayMirror.init();
+
+    // internal regulator output mode -> PWM
+    Board::initOutput(1u << Board::SMPS_MODE);
+    Board::digitalWrite(Board::SMPS_MODE, HIGH);
 
-    // 空読みして内部状態を安定させる
-    for (byte i = 0; i < 255; ++i)
+    // 前回の状態。FV-1へは入力を読む前に出し、音が既定値で鳴る時間をなくす
+    SnapshotData saved;
+    bool restored = snapshot.load(saved);
+    if (restored)
     {
-        pots[0].analogRead();
-        pots[1].analogRead();
-        pots[2].analogRead();
+        presetIndex = constrain(saved.presetIndex, 0, PRESET_TOTAL - 1);
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            paramValues[i] = min(saved.paramValues[i], (uint16_t)POTS_MAX_VALUE);
+        }
+        linkMode = min(saved.linkMode, (byte)LINK_MODE_FOLLOWER);
+        linkPots = saved.linkPots != 0;
     }
-
-    cv.init(CV);
-    ezOscillo.init(&u8g2, &cv, POTS_ROW * 16);
+    bootLog.mark(BOOT_SNAPSHOT);
 
     initRomBit();
     setRomBit(presetIndex);
@@ -178,11 +197,67 @@ void initController()
     setPresetBit(presetIndex);
 
     initPWMPotsOut();
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        pwm_set_chan_level(potSlices[i], potChs[i], paramValues[i]);
+        potPulseValues[i] = paramValues[i];
+    }
+    bootLog.mark(BOOT_OUTPUTS);
+
+    // ADCは直接読むので12bit。パルス出力解像度はあわせること
+    sw0.init(Board::SW0);
+    sw1.init(Board::SW1);
+    sw0.setHoldTime(1000);
+    sw1.setHoldTime(1000);
+    pots[0].init(Board::POT0);
+    pots[1].init(Board::POT1);
+    pots[2].init(Board::POT2);
+
+    // 多めに1回読んでフィルタを埋める。保存時から動いていなければ保存値を使い、値を飛ばさない
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        uint16_t value = pots[i].seed();
+        uint16_t diff = value > saved.potValues[i] ? value - saved.potValues[i] : saved.potValues[i] - value;
+        if (restored && diff <= PARAM_PICKUP_WINDOW)
+        {
+            pots[i].setValue(saved.potValues[i]);
+        }
+    }
+
+    cv.init(Board::CV);
+    cv.seed();
+    cvScope.init(Board::CV);
+    ezOscillo.init(&u8g2, &cvScope, Board::POTS_ROW * 16);
+    ezOscillo.attachProbe(&probeBus);
+
+    sw0.attachTrace(&inputTrace, TRACE_SRC_SW0);
+    sw1.attachTrace(&inputTrace, TRACE_SRC_SW1);
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        pots[i].attachTrace(&inputTrace, TRACE_SRC_POT0 + i);
+    }
+    cv.attachTrace(&inputTrace, TRACE_SRC_CV);
+    bootLog.mark(BOOT_INPUTS);
+
+    // 制御周期1回分(500kbpsで約50バイト)より多く受けられるようにする
+    Serial1.setTX(Board::LINK_TX);
+    Serial1.setRX(Board::LINK_RX);
+    Serial1.setFIFOSize(256);
+    Serial1.begin(LINK_BAUD);
+    unitLink.begin(&Serial1);
 }
 
 extern byte assignCVMode;
 extern byte assignCV2Pot;
 extern byte assignCVDepth;
+extern byte cvPresetHysteresis;
+extern byte cvPresetSettle;
+extern byte cvPresetSlots;
+
+// スコープの深いキャプチャ表示中はポット0/1をズーム/パンに使う。パラメタは借りる前の位置のまま
+#define SCOPE_POTS 2
+static bool potsBorrowed = false;
+static uint16_t heldPots[POTS_MAX] = {0};
 
 static byte unlock[3] = {0};
 void resetUnlock()
@@ -193,82 +268,175 @@ void resetUnlock()
     }
 }
 
+// 不感帯を超えたときだけ目標値へ動かす。端は不感帯によらず張り付かせる
+uint16_t applyDeadband(uint16_t current, uint16_t target, byte deadband)
+{
+    uint16_t diff = current > target ? current - target : target - current;
+    if (diff > deadband || (diff > 0 && (target == 0 || target == POTS_MAX_VALUE)))
+    {
+        return target;
+    }
+    return current;
+}
+
+// 次のupdatePresetsValuesで必ずPWMを書き直させる
+void invalidatePotPulse()
+{
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        potPulseValues[i] = 0xFFFF;
+    }
+}
+
+// 制御周期の時刻。入力の記録/再生中はそれに合わせる
+uint32_t getControlMicros()
+{
+    return inputTrace.getMode() == TRACE_MODE_OFF ? micros() : inputTrace.getClockMicros();
+}
+
+// 操作スクリプトを1回実行する。出力しなかったものは通常の処理に任せる
+// @return 出力したもののビットマスク(VM_OUT_*)
+byte runControlVM(const uint16_t *readValues, uint16_t cvValue, int32_t *outputs)
+{
+    controlVM.select(presetIndex);
+    if (!controlVM.isActive())
+    {
+        return 0;
+    }
+
+    int32_t inputs[VM_IN_MAX];
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        inputs[VM_IN_POT0 + i] = readValues[i];
+        inputs[VM_IN_PARAM0 + i] = paramValues[i];
+    }
+    inputs[VM_IN_CV] = cvValue;
+    inputs[VM_IN_SW0] = buttonStates[0];
+    inputs[VM_IN_SW1] = buttonStates[1];
+    inputs[VM_IN_TIME] = (int32_t)(getControlMicros() / 1000);
+    inputs[VM_IN_PRESET] = presetIndex;
+    return controlVM.run(inputs, outputs);
+}
+
 void updatePresetsValues()
 {
-    // ポット処理更新
+    uint16_t readValues[POTS_MAX];
     for (byte i = 0; i < POTS_MAX; ++i)
     {
         uint16_t readValue = pots[i].analogRead();
-        byte value = (*(byte *)(values[presetIndex][i][0]));
+        if (potsBorrowed && i < SCOPE_POTS)
+        {
+            readValue = heldPots[i];
+        }
+        else
+        {
+            heldPots[i] = readValue;
+        }
+        readValues[i] = readValue;
+    }
+
+    // CVは1周期に1回だけ読む。プリセット選択中はupdateCVPresetが読んだ値を使う
+    uint16_t cvRead = 0;
+    bool cvModulate = assignCVMode != CV_MODE_PRESET && assignCVDepth > 0;
+    if (cvModulate || controlVM.isActive())
+    {
+        cvRead = assignCVMode == CV_MODE_PRESET ? cv.getValue() : cv.analogRead();
+    }
+
+    int32_t vmOutputs[VM_OUT_MAX];
+    byte vmMask = runControlVM(readValues, cvRead, vmOutputs);
+
+    // ポット処理更新
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        uint16_t readValue = readValues[i];
+        uint16_t value = paramValues[i];
         byte min = (*(byte *)values[presetIndex][i][1]);
         byte max = (*(byte *)values[presetIndex][i][2]);
-        byte pot8bit = constrain(map(readValue, 0, POTS_MAX_VALUE, min, max), min, max);
-        if (pot8bit == value)
+        uint16_t diff = readValue > value ? readValue - value : value - readValue;
+        if (diff <= PARAM_PICKUP_WINDOW)
         {
             unlock[i] = 1;
         }
 
-        uint16_t potPulseValue = 0;
+        uint16_t target = value;
+        automation.setLastValue(i, value);
+        if (automation.isPotActive(i))
+        {
+            // 自動操作中はポットもCVも使わない。戻ったときは拾い直しから
+            target = automation.getPotValue(i);
+            unlock[i] = 0;
+        }
+        else if (unitLink.isPotActive())
+        {
+            // 先導側のパラメタに合わせる。止まったら拾い直し
+            target = unitLink.getPotValue(i);
+            unlock[i] = 0;
+        }
+        else if (vmMask & (1 << (VM_OUT_PARAM0 + i)))
+        {
+            // スクリプトが出力したときも同じく、戻ったら拾い直し
+            target = constrain(vmOutputs[VM_OUT_PARAM0 + i], 0, POTS_MAX_VALUE);
+            unlock[i] = 0;
+        }
         // CV入力の加算処理
-        if (assignCV2Pot == i && assignCVDepth > 0)
+        else if (cvModulate && assignCV2Pot == i)
         {
-            uint16_t cvValue = cv.analogRead() * (0.01 * assignCVDepth);
+            uint16_t cvValue = cvRead * (0.01 * assignCVDepth);
             uint16_t uniHalfPoint = (uint16_t)(POTS_MAX_VALUE * (0.01 * assignCVDepth)) >> 1;
 
-            byte cv8bit = constrain(map(cvValue, 0, POTS_MAX_VALUE, min, max), min, max);
-            byte uniHalfPoint8bit = constrain(map(uniHalfPoint, 0, POTS_MAX_VALUE, min, max), min, max);
-
-            uint16_t addCv = 0;
-            byte addCv8bit = 0;
-
             if (assignCVMode == 0)
             {
-                addCv = readValue;
-                addCv8bit = pot8bit;
+                target = readValue;
             }
             else if (assignCVMode == 1)
             {
-                addCv = constrain(readValue + cvValue, 0, POTS_MAX_VALUE);
-                addCv8bit = constrain(pot8bit + cv8bit, min, max);
+                target = constrain(readValue + cvValue, 0, POTS_MAX_VALUE);
             }
             else if (assignCVMode == 2)
             {
                 long cvUni = constrain((long)(cvValue - uniHalfPoint), -POTS_MAX_VALUE, POTS_MAX_VALUE);
-                addCv = constrain(readValue + cvUni, 0, POTS_MAX_VALUE);
-
-                int16_t cv8bitUni = constrain((int16_t)(cv8bit - uniHalfPoint8bit), -max, max);
-                addCv8bit = constrain(pot8bit + cv8bitUni, min, max);
+                target = constrain(readValue + cvUni, 0, POTS_MAX_VALUE);
             }
-
-            potPulseValue = addCv;
-            (*(byte *)(values[presetIndex][i][0])) = addCv8bit;
-            // FV-1へポットの値をパルス出力
-            pwm_set_chan_level(potSlices[i], potChs[i], potPulseValue);
-            // Serial.print("2,");
         }
         else if (unlock[i])
         {
-            potPulseValue = readValue;
-            (*(byte *)(values[presetIndex][i][0])) = pot8bit;
-            // FV-1へポットの値をパルス出力
-            pwm_set_chan_level(potSlices[i], potChs[i], potPulseValue);
-            // Serial.print("1,");
+            target = readValue;
         }
-        else
+
+        probeBus.set(PROBE_POT0 + i, readValue);
+        probeBus.set(PROBE_TARGET0 + i, target);
+        value = applyDeadband(value, target, deadbands[presetIndex][i]);
+        paramValues[i] = value;
+        lastPot[i] = constrain(map(value, 0, POTS_MAX_VALUE, min, max), min, max);
+
+        // FV-1へポットの値をパルス出力。変化したときだけレジスタを書く
+        if (potPulseValues[i] != value)
         {
-            potPulseValue = map(value, min, max, 0, POTS_MAX_VALUE);
-            // FV-1へポットの値をパルス出力
-            pwm_set_chan_level(potSlices[i], potChs[i], potPulseValue);
-            // Serial.print("0,");
+            pwm_set_chan_level(potSlices[i], potChs[i], value);
+            potPulseValues[i] = value;
         }
+        probeBus.set(PROBE_PWM0 + i, value);
         potValues[i] = readValue;
     }
-        // Serial.println("");
+    probeBus.set(PROBE_CV, cv.getValue());
+    probeBus.publish();
+
+    if (vmMask & (1 << VM_OUT_PRESET))
+    {
+        int8_t index = constrain(vmOutputs[VM_OUT_PRESET], 0, PRESET_TOTAL - 1);
+        if (index != presetIndex)
+        {
+            presetIndex = index;
+            setRomBit(presetIndex);
+            setPresetBit(presetIndex);
+        }
+    }
 }
 
+static byte settingIndex = 0;
 void updateSettings()
 {
-    byte settingIndex = 0;
     // ポット処理更新
     for (byte i = 0; i < POTS_MAX; ++i)
     {
@@ -291,37 +459,185 @@ void updateSettings()
     }
 }
 
+// 自動操作の進行。プリセット変更はボタンと同じ扱い
+void updateAutomation()
+{
+    int8_t index = presetIndex;
+    if (automation.update(getControlMicros(), &index))
+    {
+        presetIndex = constrain(index, 0, PRESET_TOTAL - 1);
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+    }
+}
+
+// 先導側からのプリセット変更。ボタンと同じ扱いで、届いた周期のうちに切り替える
+void updateLinkReceive()
+{
+    unitLink.setMode(linkMode, linkPots != 0);
+    LinkPreset preset = {};
+    if (!unitLink.receive(getControlMicros(), preset))
+    {
+        return;
+    }
+
+    if (preset.presetIndex >= 0 && preset.presetIndex < PRESET_TOTAL && preset.presetIndex != presetIndex)
+    {
+        presetIndex = preset.presetIndex;
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+    }
+}
+
+// CVでのプリセット選択。ステップの直後に切り替わるよう平滑化前の値で判定する
+void updateCVPreset()
+{
+    if (assignCVMode != CV_MODE_PRESET)
+    {
+        cvPreset.reset();
+        return;
+    }
+
+    cvPreset.setRange(cvPresetSlots, cvPresetHysteresis, (uint32_t)cvPresetSettle * 1000);
+    int8_t slot = cvPreset.update(cv.analogRead(false), getControlMicros());
+    if (slot >= 0 && slot != presetIndex)
+    {
+        presetIndex = slot;
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+    }
+}
+
 static byte dispMode = 0;
+
+// 押されているボタン
+static bool buttonDown[2] = {false, false};
+
+// 両ボタン同時押しの判定
+// @return 0:なし 1:同時押しになった 2:同時押しの途中または離した(ほかの操作にしない)
+byte updateButtonChord(byte stateSw0, byte stateSw1)
+{
+    static bool chord = false;
+    bool *down = buttonDown;
+    byte states[2] = {stateSw0, stateSw1};
+    for (byte i = 0; i < 2; ++i)
+    {
+        if (states[i] == 1)
+        {
+            down[i] = true;
+        }
+        else if (states[i] == 2 || states[i] == 4)
+        {
+            down[i] = false;
+        }
+    }
+
+    if (down[0] && down[1])
+    {
+        byte result = chord ? 2 : 1;
+        chord = true;
+        return result;
+    }
+    if (chord)
+    {
+        // 両方離すまでは同時押しの続き
+        chord = down[0] || down[1];
+        return 2;
+    }
+    return 0;
+}
+
+// プリセット送りの確定。同時押しならすぐに確定する
+void updatePresetBrowse(bool commitNow)
+{
+    presetBrowser.setTiming((uint32_t)presetSettle * 100000, (uint32_t)presetRepeat * 10000);
+    uint32_t now = getControlMicros();
+    if (buttonDown[0] || buttonDown[1])
+    {
+        presetBrowser.hold(now);
+    }
+    int8_t index = presetBrowser.update(presetIndex, commitNow, now);
+    if (index >= 0 && index != presetIndex)
+    {
+        presetIndex = index;
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+    }
+    previewIndex = presetBrowser.getPreviewIndex();
+}
+
+// スコープ表示中のポットの割り当て。深いキャプチャのときだけポット0/1をズーム/パンに借りる
+void updateScopePots()
+{
+    bool borrow = dispMode == 1 && scopeDispMode == DISP_MODE_DEEP;
+    if (borrow)
+    {
+        ezOscillo.setDeepView(pots[0].getValue(), pots[1].getValue());
+    }
+    else if (potsBorrowed)
+    {
+        // 返すときはポットが今の値を拾い直すまで追従しない
+        for (byte i = 0; i < SCOPE_POTS; ++i)
+        {
+            unlock[i] = 0;
+        }
+    }
+    potsBorrowed = borrow;
+}
+
 void updateController()
 {
     static byte lastPresetIndex = presetIndex;
+    inputTrace.tick();
+    updateLinkReceive();
+    updateAutomation();
+    updateCVPreset();
+    updateScopePots();
     byte stateSw0 = sw0.getState();
     byte stateSw1 = sw1.getState();
+    buttonStates[0] = stateSw0;
+    buttonStates[1] = stateSw1;
+    byte chord = updateButtonChord(stateSw0, stateSw1);
     if (dispMode == 0)
     {
         updatePresetsValues();
-        // ボタン処理：プリセット変更
-        if (stateSw0 == 2)
+        // ボタン処理：プリセット送り。送っている間は表示だけ変え、切り替えはupdatePresetBrowseで
+        // 送りの途中の長押しは早送り、そうでなければ画面切り替え
+        // 両ボタン同時押しの途中はどちらの操作にもしない
+        uint32_t now = getControlMicros();
+        if (chord != 0)
         {
-            presetIndex = constrainCyclic(presetIndex + 1, 0, PRESET_TOTAL - 1);
-            setRomBit(presetIndex);
-            setPresetBit(presetIndex);
+            presetBrowser.stopRepeat();
+        }
+        else if (stateSw0 == 2)
+        {
+            presetBrowser.step(presetIndex, PRESET_TOTAL, 1, now);
         }
         else if (stateSw0 == 3)
         {
-            dispMode = 1;
-            resetUnlock();
+            if (!presetBrowser.startRepeat(1, now))
+            {
+                dispMode = 1;
+                ezOscillo.arm();
+                resetUnlock();
+            }
         }
         else if (stateSw1 == 2)
         {
-            presetIndex = constrainCyclic(presetIndex - 1, 0, PRESET_TOTAL - 1);
-            setRomBit(presetIndex);
-            setPresetBit(presetIndex);
+            presetBrowser.step(presetIndex, PRESET_TOTAL, -1, now);
         }
         else if (stateSw1 == 3)
         {
-            dispMode = 2;
-            resetUnlock();
+            if (!presetBrowser.startRepeat(-1, now))
+            {
+                dispMode = 2;
+                resetUnlock();
+            }
+        }
+
+        if (stateSw0 == 4 || stateSw1 == 4)
+        {
+            presetBrowser.stopRepeat();
         }
     }
     else if (dispMode == 1)
@@ -349,16 +665,22 @@ void updateController()
     else if (dispMode == 2)
     {
         updateSettings();
+        // ボタン処理：設定ページ切り替え
         if (stateSw0 == 2)
         {
+            settingIndex = constrainCyclic(settingIndex + 1, 0, EXSETMENU_MAX - 1);
+            resetUnlock();
         }
         else if (stateSw0 == 3)
         {
             dispMode = 1;
+            ezOscillo.arm();
             resetUnlock();
         }
         else if (stateSw1 == 2)
         {
+            settingIndex = constrainCyclic(settingIndex - 1, 0, EXSETMENU_MAX - 1);
+            resetUnlock();
         }
         else if (stateSw1 == 3)
         {
@@ -366,43 +688,352 @@ void updateController()
             resetUnlock();
         }
     }
-    
+
+    updatePresetBrowse(chord == 1);
+
+    // 先導側はこの周期で決まったプリセットとパラメタを送る
+    unitLink.publish(presetIndex, paramValues, getControlMicros());
 }
 
-// CPU 1は操作系専用
-void setup()
+// 制御周期ごとの値をテレメトリへ積む
+void updateTelemetry()
 {
-    Serial.begin(9600);
-    initController();
+    if (!telemetry.isEnabled())
+    {
+        return;
+    }
+
+    TelemetryRecord record;
+    record.micros = micros();
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        record.potRaw[i] = pots[i].getRawValue();
+        record.potValue[i] = pots[i].getValue();
+        record.pwm[i] = potPulseValues[i];
+    }
+    record.cvRaw = cv.getRawValue();
+    record.cvValue = cv.getValue();
+    record.presetIndex = presetIndex;
+    record.dispMode = dispMode;
+    telemetry.push(record);
 }
 
-void loop()
+// 入力記録/再生の開始時に、結果に影響する内部状態を記録または復元する
+void traceState()
 {
-    updateController();
-    delay(1);
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        pots[i].traceState();
+        inputTrace.state(unlock[i]);
+        inputTrace.state(paramValues[i]);
+        inputTrace.state(lastPot[i]);
+    }
+    cv.traceState();
+    sw0.traceState();
+    sw1.traceState();
+    inputTrace.state(presetIndex);
+    inputTrace.state(dispMode);
+    inputTrace.state(settingIndex);
+    inputTrace.state(assignCVMode);
+    inputTrace.state(assignCV2Pot);
+    inputTrace.state(assignCVDepth);
+    inputTrace.state(cvPresetHysteresis);
+    inputTrace.state(cvPresetSettle);
+    inputTrace.state(cvPresetSlots);
+    inputTrace.state(scopeDispMode);
+    inputTrace.state(potsBorrowed);
+    for (byte i = 0; i < SCOPE_POTS; ++i)
+    {
+        inputTrace.state(heldPots[i]);
+    }
+    inputTrace.state(presetSettle);
+    inputTrace.state(presetRepeat);
+    inputTrace.state(linkMode);
+    inputTrace.state(linkPots);
+
+    // 記録と再生で同じ状態から始める
+    cvPreset.reset();
+    presetBrowser.cancel();
+
+    if (inputTrace.isReplaying())
+    {
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+        invalidatePotPulse();
+    }
 }
 
-// CPU 2は表示専用
-void setup1()
+// 入力記録/再生の進行。再生データが揃っていなければfalse
+bool updateTrace()
 {
-    initOLED();
-    dispPresets(&u8g2, presetIndex, potValues);
+    if (!inputTrace.isReady())
+    {
+        return false;
+    }
+
+    if (inputTrace.isStatePending())
+    {
+        traceState();
+        inputTrace.clearStatePending();
+    }
+    return true;
 }
 
-void loop1()
+// タスクごとの実行統計をフレームで送る
+void sendTaskStats()
+{
+    for (byte i = 0; i < scheduler.getCount(); ++i)
+    {
+        SchedulerTaskStats stats;
+        scheduler.getStats(i, stats);
+        telemetry.pushFrame(FRAME_TYPE_TASK_STATS, &stats, sizeof(SchedulerTaskStats));
+    }
+}
+
+// 起動の節目の時刻を送る
+void sendBootLog()
+{
+    uint32_t milestones[BOOT_MILESTONE_MAX];
+    bootLog.get(milestones);
+    telemetry.pushFrame(FRAME_TYPE_BOOT, milestones, sizeof(milestones));
+}
+
+// 操作スクリプトの転送。最後のフレームか失敗したときに[スロット][結果][命令番号]を返す
+void loadControlVM()
+{
+    byte reply[3];
+    reply[1] = controlVM.load(frameReader.getPayload(), frameReader.getLength(), reply[0], reply[2]);
+    if (reply[1] != VM_LOAD_PENDING)
+    {
+        telemetry.pushFrame(FRAME_TYPE_CONTROL_VM, reply, sizeof(reply));
+    }
+}
+
+void onSerialFrame()
+{
+    switch (frameReader.getType())
+    {
+    case FRAME_TYPE_TRACE:
+        inputTrace.feed((const TraceEvent *)frameReader.getPayload(), frameReader.getLength() / sizeof(TraceEvent));
+        break;
+    case FRAME_TYPE_AUTOMATION:
+        automation.load(frameReader.getPayload(), frameReader.getLength());
+        break;
+    case FRAME_TYPE_CONTROL_VM:
+        loadControlVM();
+        break;
+    default:
+        break;
+    }
+}
+
+// USBからの1バイトコマンドとフレーム
+// T:テレメトリ開始 t:テレメトリ停止
+// R:入力記録開始 r:入力記録停止 P:入力再生開始 p:入力再生停止
+// S:タスク統計送信 s:タスク統計クリア
+// A:自動操作開始 a:自動操作停止
+// B:起動の節目送信
+// M:画面の写し開始 m:画面の写し停止
+void updateSerialCommand()
+{
+    while (Serial.available() > 0)
+    {
+        // 再生中は再生バッファに空きがあるときだけ受ける
+        if (inputTrace.isReplaying() && inputTrace.getFree() < TRACE_EVENTS_PER_FRAME)
+        {
+            break;
+        }
+
+        byte result = frameReader.put(Serial.read());
+        if (result == 1)
+        {
+            onSerialFrame();
+            continue;
+        }
+        else if (result != 2)
+        {
+            continue;
+        }
+
+        switch (frameReader.getCommand())
+        {
+        case 'T':
+            telemetry.start();
+            break;
+        case 't':
+            telemetry.stop();
+            break;
+        case 'R':
+            inputTrace.startRecord();
+            break;
+        case 'r':
+            inputTrace.stop();
+            break;
+        case 'P':
+            inputTrace.startReplay();
+            break;
+        case 'p':
+            inputTrace.stop();
+            break;
+        case 'S':
+            sendTaskStats();
+            break;
+        case 's':
+            scheduler.resetStats();
+            break;
+        case 'A':
+            automation.start(getControlMicros());
+            break;
+        case 'a':
+            automation.stop();
+            break;
+        case 'B':
+            sendBootLog();
+            break;
+        case 'M':
+            displayMirror.start();
+            break;
+        case 'm':
+            displayMirror.stop();
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// 操作系。1msごと
+void controlTask()
+{
+    byte lastPresetIndex = presetIndex;
+    int8_t lastPreviewIndex = previewIndex;
+    byte lastDispMode = dispMode;
+    byte lastSettingIndex = settingIndex;
+
+    updateSerialCommand();
+    if (updateTrace())
+    {
+        updateController();
+        updateTelemetry();
+    }
+
+    // 画面が切り替わるときは次のフレームを待たずに描く
+    if (lastPresetIndex != presetIndex || lastPreviewIndex != previewIndex || lastDispMode != dispMode || lastSettingIndex != settingIndex)
+    {
+        scheduler.signal(TASK_DISPLAY);
+    }
+}
+
+// スコープの測定結果。取り込みごとに1回送る
+void updateScopeTelemetry()
+{
+    static uint32_t seq = 0;
+    ScopeMeasure measure;
+    if (telemetry.isEnabled() && ezOscillo.getMeasure(measure, seq))
+    {
+        telemetry.pushFrame(FRAME_TYPE_SCOPE_MEASURE, &measure, sizeof(ScopeMeasure));
+    }
+}
+
+// USBへの送信。操作系の合間に流す
+void usbTask()
+{
+    updateScopeTelemetry();
+    // U8G2_R2で描いているのでバッファは180度回っている。基板ごとの反転は表示器側の設定なので関係しない
+    displayMirror.send(telemetry, true);
+    inputTrace.flush(telemetry);
+    telemetry.drain(Serial);
+}
+
+// 状態の保存。入力の記録/再生中は保存しない
+void snapshotTask()
+{
+    if (inputTrace.getMode() != TRACE_MODE_OFF)
+    {
+        return;
+    }
+
+    SnapshotData data;
+    data.presetIndex = presetIndex;
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        data.paramValues[i] = paramValues[i];
+        data.potValues[i] = pots[i].getValue();
+    }
+    data.linkMode = linkMode;
+    data.linkPots = linkPots;
+    snapshot.update(data, micros());
+}
+
+// 表示系。30fps
+void displayTask()
 {
     switch (dispMode)
     {
     case 0:
-        dispPresets(&u8g2, presetIndex, potValues);
+    {
+        int8_t preview = previewIndex;
+        dispPresets(&u8g2, preview >= 0 ? preview : presetIndex, potValues, preview >= 0);
         break;
+    }
     case 1:
+        ezOscillo.setTrigger(scopeTrigMode, scopeTrigEdge,
+                             scopeTrigLevel == 0 ? TRIG_LEVEL_AUTO : map(scopeTrigLevel, 1, 127, 0, DATA_MAX_VALUE),
+                             scopePreTrig, scopeHoldoff << 3);
+        ezOscillo.setDisplay(scopeDispMode, scopeAvgShift, scopePersistShift);
+        ezOscillo.setProbe(scopeProbeA == 0 ? PROBE_OFF : scopeProbeA - 1, scopeProbeB == 0 ? PROBE_OFF : scopeProbeB - 1);
         ezOscillo.play();
+        if (ezOscillo.isAcquiring())
+        {
+            // 深いキャプチャの続き。次の周期を待つとその間のサンプルが欠ける
+            scheduler.signal(TASK_DISPLAY);
+        }
         break;
     case 2:
-        dispSettings(&u8g2, potSettingValues);
+        dispSettings(&u8g2, settingIndex, potSettingValues);
         break;
     }
-    // 30fpsで更新
-    delay(33);
+
+    // 描き終えた画面を写すだけ。差分と符号化はusbTaskで
+    displayMirror.capture(u8g2.getBufferPtr());
+}
+
+// 並びはTASK_*と合わせること
+static SchedulerTask tasks[] = {
+    // name, func, period, deadline, priority, core
+    {"control", controlTask, 1000, 1000, 3, TASK_CORE0},
+    {"usb", usbTask, 2000, 10000, 1, TASK_CORE0},
+    {"display", displayTask, 33333, 33333, 1, TASK_CORE1},
+    {"snapshot", snapshotTask, 100000, 1000000, 0, TASK_CORE0},
+};
+
+// CPU 1は操作系専用
+void setup()
+{
+    initController();
+    // USB CDCなのでボーレートは実際の転送速度に関係しない
+    Serial.begin(115200);
+    scheduler.begin(tasks, sizeof(tasks) / sizeof(SchedulerTask));
+    bootLog.mark(BOOT_READY);
+}
+
+void loop()
+{
+    scheduler.run(TASK_CORE0);
+}
+
+// CPU 2は表示専用
+// CPU 1の出力の初期化と並んで動く
+void setup1()
+{
+    bootLog.mark(BOOT_OLED_SETUP);
+    initOLED();
+    bootLog.mark(BOOT_OLED_READY);
+    dispPresets(&u8g2, presetIndex, potValues);
+    bootLog.mark(BOOT_FIRST_FRAME);
+}
+
+void loop1()
+{
+    scheduler.run(TASK_CORE1);
 }
@@ -0,0 +1,146 @@
+#
+# Reverb Island automation uploader
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# 時刻つきのパラメタ操作を実機に転送して再生する
+#   python automation.py upload COM3 show.auto [--start]
+#   python automation.py start COM3
+#   python automation.py stop COM3
+#   python automation.py dump show.auto
+# スクリプトは1行1イベント。時刻は開始からの秒、#以降はコメント
+#   0.0    preset 3
+#   1.5    pot 0 4095 2000     # ポット0を2000msかけて4095へ
+#   6.0    release 0           # ポット0を手に戻す
+#   8.0    loop                # 先頭に戻る
+# シリアル通信には pyserial が必要
+#
+
+import argparse
+import struct
+import sys
+
+from telemetry_csv import FRAME_SYNC, fletcher16
+
+FRAME_TYPE_AUTOMATION = 0x04
+FRAME_PAYLOAD_MAX = 255
+
+# Automation.hpp の AutomationEvent と同じ並び
+EVENT = struct.Struct("<IBBHH")
+EVENTS_PER_FRAME = (FRAME_PAYLOAD_MAX - 2) // EVENT.size
+EVENTS_MAX = 1024
+
+EVENT_PRESET = 0x01
+EVENT_POT = 0x02
+EVENT_RELEASE = 0x03
+EVENT_LOOP = 0x04
+EVENT_NAMES = {EVENT_PRESET: "preset", EVENT_POT: "pot", EVENT_RELEASE: "release", EVENT_LOOP: "loop"}
+
+POTS_MAX = 3
+POTS_MAX_VALUE = 4095
+PRESET_TOTAL = 24
+
+
+def build_frame(frame_type, payload):
+    body = bytes([frame_type, len(payload)]) + payload
+    s = fletcher16(body)
+    return FRAME_SYNC + body + bytes([s & 0xFF, s >> 8])
+
+
+def parse_script(path):
+    """(micros, type, target, value, ramp) のリスト。時刻順、同時刻は記述順"""
+    events = []
+    with open(path) as f:
+        for line_no, line in enumerate(f, 1):
+            words = line.split("#", 1)[0].split()
+            if not words:
+                continue
+            try:
+                micros = int(round(float(words[0]) * 1e6))
+                name = words[1]
+                args = [int(w) for w in words[2:]]
+                if name == "preset" and len(args) == 1 and 0 <= args[0] < PRESET_TOTAL:
+                    events.append((micros, EVENT_PRESET, 0, args[0], 0))
+                elif (name == "pot" and len(args) in (2, 3) and 0 <= args[0] < POTS_MAX
+                      and 0 <= args[1] <= POTS_MAX_VALUE):
+                    ramp = args[2] if len(args) == 3 else 0
+                    events.append((micros, EVENT_POT, args[0], args[1], min(max(ramp, 0), 0xFFFF)))
+                elif name == "release" and len(args) == 1 and 0 <= args[0] < POTS_MAX:
+                    events.append((micros, EVENT_RELEASE, args[0], 0, 0))
+                elif name == "loop" and not args and micros > 0:
+                    events.append((micros, EVENT_LOOP, 0, 0, 0))
+                else:
+                    raise ValueError
+            except (ValueError, IndexError):
+                sys.exit("%s:%d: bad event: %s" % (path, line_no, line.strip()))
+
+    events.sort(key=lambda e: e[0])
+    if len(events) > EVENTS_MAX:
+        sys.exit("%s: %d events (max %d)" % (path, len(events), EVENTS_MAX))
+    return events
+
+
+def build_frames(events):
+    frames = []
+    for index in range(0, len(events), EVENTS_PER_FRAME):
+        payload = struct.pack("<H", index)
+        for event in events[index:index + EVENTS_PER_FRAME]:
+            payload += EVENT.pack(*event)
+        frames.append(build_frame(FRAME_TYPE_AUTOMATION, payload))
+    return frames
+
+
+def upload(args):
+    import serial
+
+    events = parse_script(args.script)
+    with serial.Serial(args.port, timeout=0.1) as port:
+        # 転送すると再生は止まる
+        for frame in build_frames(events):
+            port.write(frame)
+        if args.start:
+            port.write(b"A")
+        port.flush()
+    print("%d events sent" % len(events), file=sys.stderr)
+
+
+def command(args):
+    import serial
+
+    with serial.Serial(args.port, timeout=0.1) as port:
+        port.write(b"A" if args.command == "start" else b"a")
+        port.flush()
+
+
+def dump(args):
+    print("micros,type,target,value,ramp_ms")
+    for micros, event_type, target, value, ramp in parse_script(args.script):
+        print("%d,%s,%d,%d,%d" % (micros, EVENT_NAMES[event_type], target, value, ramp))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island automation")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("upload", help="upload automation script to device")
+    p.add_argument("port")
+    p.add_argument("script")
+    p.add_argument("--start", action="store_true", help="start playback after upload")
+    p.set_defaults(func=upload)
+
+    for name in ("start", "stop"):
+        p = sub.add_parser(name, help="%s playback" % name)
+        p.add_argument("port")
+        p.set_defaults(func=command)
+
+    p = sub.add_parser("dump", help="print parsed script as csv")
+    p.add_argument("script")
+    p.set_defaults(func=dump)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,205 @@
+#
+# Reverb Island FV-1 program bank builder
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# バンク定義(app/ReverIsland/fv1/banks.json)から
+#   - EEPROMに書くバンクのイメージ(.bin/.hex) : .spnを asfv1 でアセンブルして8本まとめる
+#   - ファームウェア用のプリセット名ヘッダ(src/PresetBank.h)
+# を作る。ヘッダはPlatformIOのビルド前にも自動で作り直す(fv1/pio_bank.py)
+#   python fv1_bank.py                 ヘッダとイメージを作る
+#   python fv1_bank.py --header-only   ヘッダだけ作る(asfv1不要)
+# アセンブルには asfv1 (pip install asfv1) が必要
+#
+
+import argparse
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+BANK_PROGRAMS = 8
+POTS_MAX = 3
+PROGRAM_SIZE = 512
+# 空きスロットはSKP 0,0(NOP)で埋める。asfv1と同じ
+NOP = struct.pack(">I", 0x00000011)
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+APP = os.path.join(HERE, "..", "app", "ReverIsland")
+DEFAULT_MANIFEST = os.path.join(APP, "fv1", "banks.json")
+DEFAULT_HEADER = os.path.join(APP, "src", "PresetBank.h")
+
+
+class BankError(Exception):
+    pass
+
+
+def load_manifest(path):
+    with open(path, encoding="utf-8") as f:
+        manifest = json.load(f)
+
+    label_length = manifest.get("labelLength", 12)
+    for bank in manifest["banks"]:
+        if bank.get("type") not in ("rom", "eeprom"):
+            raise BankError("bank %s: type must be rom or eeprom" % bank.get("name"))
+        if len(bank["programs"]) != BANK_PROGRAMS:
+            raise BankError("bank %s: %d programs (need %d)" % (bank["name"], len(bank["programs"]), BANK_PROGRAMS))
+        for program in bank["programs"]:
+            labels = [program["title"]] + [p for p in program["params"] if p is not None]
+            if len(program["params"]) != POTS_MAX:
+                raise BankError("%s: need %d params" % (program["title"], POTS_MAX))
+            for label in labels:
+                if len(label) > label_length:
+                    raise BankError("%s: '%s' is longer than %d" % (program["title"], label, label_length))
+                if '"' in label or "\\" in label:
+                    raise BankError("%s: '%s' has unsupported character" % (program["title"], label))
+            deadband = program.get("deadband", manifest.get("deadband", 8))
+            if isinstance(deadband, int):
+                deadband = [deadband] * POTS_MAX
+            if len(deadband) != POTS_MAX or any(d < 0 or d > 255 for d in deadband):
+                raise BankError("%s: deadband must be 0-255 x %d" % (program["title"], POTS_MAX))
+            program["deadband"] = deadband
+    return manifest
+
+
+def render_header(manifest, manifest_name):
+    width = manifest.get("labelLength", 12)
+
+    def label(text):
+        return '"%s"' % (text if text is not None else "-" * width).ljust(width)
+
+    total = len(manifest["banks"]) * BANK_PROGRAMS
+    lines = [
+        "/*!",
+        " * Preset bank metadata",
+        " * Copyright 2023 marksard",
+        " * This software is released under the MIT license.",
+        " * see https://opensource.org/licenses/MIT",
+        " *",
+        " * このファイルは tools/fv1_bank.py が %s から生成する。直接編集しないこと" % manifest_name,
+        " */",
+        "",
+        "#pragma once",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "#define PRESET_BANK_COUNT %d" % len(manifest["banks"]),
+        "#define PRESET_BANK_PROGRAMS %d" % total,
+        "",
+        "// バンク名(ROM/EEPROM切り替え順)",
+        "const static char *bankNames[PRESET_BANK_COUNT] = {%s};" % ", ".join(
+            '"%s"' % b["name"] for b in manifest["banks"]),
+        "",
+        "// プリセット名とパラメタ名",
+        "const static char *names[PRESET_BANK_PROGRAMS][4] = {",
+    ]
+    for bank in manifest["banks"]:
+        lines.append("    // %s" % bank.get("comment", bank["name"]))
+        for program in bank["programs"]:
+            row = "    {%s}," % ", ".join(label(t) for t in [program["title"]] + program["params"])
+            if program.get("source"):
+                row += " // %s  %s" % (program.get("credit", ""), program["source"])
+            lines.append(row.rstrip())
+    lines += [
+        "};",
+        "",
+        "// パラメタごとの不感帯(12bit LSB)",
+        "const static byte deadbands[PRESET_BANK_PROGRAMS][POTS_MAX] = {",
+    ]
+    for bank in manifest["banks"]:
+        lines.append("    // %s" % bank["name"])
+        for program in bank["programs"]:
+            lines.append("    {%s}," % ", ".join(str(d) for d in program["deadband"]))
+    lines += ["};", ""]
+    return "\r\n".join(lines)
+
+
+def write_header(manifest_path=DEFAULT_MANIFEST, header_path=DEFAULT_HEADER):
+    """内容が変わったときだけ書く。毎回書くと全体が再ビルドになる"""
+    manifest = load_manifest(manifest_path)
+    text = render_header(manifest, os.path.relpath(manifest_path, os.path.dirname(header_path)).replace("\\", "/"))
+    data = text.encode("utf-8")
+    if os.path.exists(header_path):
+        with open(header_path, "rb") as f:
+            if f.read() == data:
+                return False
+    with open(header_path, "wb") as f:
+        f.write(data)
+    return True
+
+
+def assemble(asfv1, source, clamp):
+    with tempfile.TemporaryDirectory() as tmp:
+        out = os.path.join(tmp, "program.bin")
+        cmd = [asfv1, "-q", "-b"] + (["-c"] if clamp else []) + [source, out]
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        if result.returncode != 0:
+            raise BankError("%s: asfv1 failed\n%s" % (source, result.stderr.strip()))
+        with open(out, "rb") as f:
+            data = f.read()
+    if len(data) > PROGRAM_SIZE:
+        raise BankError("%s: %d bytes (max %d)" % (source, len(data), PROGRAM_SIZE))
+    # 128命令に満たない分はNOPで埋める
+    return data + NOP * ((PROGRAM_SIZE - len(data)) // len(NOP))
+
+
+def intel_hex(data):
+    lines = []
+    for address in range(0, len(data), 16):
+        chunk = data[address:address + 16]
+        record = bytes([len(chunk), address >> 8, address & 0xFF, 0x00]) + chunk
+        lines.append(":%s%02X" % (record.hex().upper(), (-sum(record)) & 0xFF))
+    lines.append(":00000001FF")
+    return "\n".join(lines) + "\n"
+
+
+def build_images(manifest, manifest_dir, out_dir, asfv1, clamp):
+    os.makedirs(out_dir, exist_ok=True)
+    for bank in manifest["banks"]:
+        if bank["type"] != "eeprom":
+            continue
+        image = bytearray()
+        for program in bank["programs"]:
+            if program.get("source"):
+                source = os.path.join(manifest_dir, program["source"])
+                if not os.path.exists(source):
+                    raise BankError("%s: source not found" % source)
+                image += assemble(asfv1, source, clamp)
+            else:
+                image += NOP * (PROGRAM_SIZE // len(NOP))
+        base = os.path.join(out_dir, "bank_%s" % bank["name"])
+        with open(base + ".bin", "wb") as f:
+            f.write(image)
+        with open(base + ".hex", "w") as f:
+            f.write(intel_hex(image))
+        print("%s.bin: %d bytes" % (base, len(image)), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island FV-1 program bank builder")
+    parser.add_argument("--manifest", default=DEFAULT_MANIFEST)
+    parser.add_argument("--header", default=DEFAULT_HEADER)
+    parser.add_argument("--out", help="image output directory (default: <manifest dir>/build)")
+    parser.add_argument("--header-only", action="store_true", help="generate header without assembling")
+    parser.add_argument("--asfv1", default="asfv1", help="assembler command")
+    parser.add_argument("--clamp", action="store_true", help="clamp out of range operands instead of failing")
+    args = parser.parse_args()
+
+    try:
+        if write_header(args.manifest, args.header):
+            print("%s updated" % args.header, file=sys.stderr)
+        if not args.header_only:
+            manifest_dir = os.path.dirname(os.path.abspath(args.manifest))
+            build_images(load_manifest(args.manifest), manifest_dir,
+                         args.out or os.path.join(manifest_dir, "build"), args.asfv1, args.clamp)
+    except BankError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
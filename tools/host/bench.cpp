@@ -0,0 +1,331 @@
+/*!
+ * Host microbenchmark
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * ファームウェアのヘッダをスタブ環境でビルドし、1回あたりの処理時間と
+ * ヒープ確保回数を測る。数値はホストCPUのものなので、実機との比較ではなく
+ * 変更前後の相対比較に使うこと
+ *   bench [iterations]
+ */
+
+#include <new>
+#include <chrono>
+#include "../../app/ReverIsland/src/main.cpp"
+
+static volatile uint32_t allocCount = 0;
+static volatile uint32_t sink = 0;
+
+void *operator new(size_t size)
+{
+    allocCount = allocCount + 1;
+    void *p = malloc(size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    (void)size;
+    free(p);
+}
+
+/// @brief 簡易乱数（ADCノイズ代わり）
+static uint32_t lcg()
+{
+    static uint32_t seed = 12345;
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 16;
+}
+
+template <typename F>
+void bench(const char *name, uint32_t iterations, F func)
+{
+    // 暖機
+    for (uint32_t i = 0; i < iterations / 10 + 1; ++i)
+    {
+        func(i);
+    }
+
+    uint32_t allocStart = allocCount;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        func(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    uint32_t allocs = allocCount - allocStart;
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    printf("%-40s %12.1f ns/call %10.3f alloc/call\n", name, ns, (double)allocs / iterations);
+}
+
+class NoisyAnalogRead : public SmoothAnalogReadBase<NoisyAnalogRead>
+{
+    friend class SmoothAnalogReadBase<NoisyAnalogRead>;
+
+public:
+    uint16_t center = 2048;
+
+protected:
+    uint16_t readPin()
+    {
+        return center + (lcg() & 0x3F) - 32;
+    }
+};
+
+class BenchOscilloscope : public EzOscilloscope
+{
+public:
+    void fillSine(float cycles)
+    {
+        for (int i = 0; i < DATA_BUF_MAX; ++i)
+        {
+            _dataBuff[i] = 2048 + 1500 * sin(2.0 * M_PI * cycles * i / DATA_BUF_MAX) + (int)(lcg() & 0x1F) - 16;
+        }
+    }
+
+    /// @brief 最適化で計算が消えないよう、呼ぶたびに1サンプルだけ変える
+    void touch(uint32_t i)
+    {
+        _dataBuff[i % DATA_BUF_HALF] ^= 1;
+    }
+
+    void calc()
+    {
+        calcData();
+    }
+
+    void draw()
+    {
+        drawData();
+    }
+
+    int16_t getRangeMax()
+    {
+        return _rangeMax;
+    }
+
+    void average()
+    {
+        updateAverage();
+    }
+
+    void persist()
+    {
+        updatePersist();
+    }
+
+    void drawPersistence()
+    {
+        drawPersist();
+    }
+
+    /// @brief 深いキャプチャを正弦で埋めてピラミッドを作る
+    void fillDeep(float cycles)
+    {
+        for (int i = 0; i < DEEP_BUF_MAX; ++i)
+        {
+            _deepBuff[i] = 2048 + 1500 * sin(2.0 * M_PI * cycles * i / DEEP_BUF_MAX) + (int)(lcg() & 0x1F) - 16;
+        }
+        buildPyramid();
+        _deepReady = true;
+    }
+
+    void pyramid()
+    {
+        buildPyramid();
+    }
+
+    void drawDeepView(uint16_t zoom, uint16_t pan)
+    {
+        setDeepView(zoom, pan);
+        calcDeepView();
+        drawDeep();
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    sim::realTime = false;
+
+    initController();
+    // 実機と同じ描画設定にする(XOR描画でないとラベルキャッシュが効かない)
+    initOLED();
+
+    printf("%-40s %20s %20s\n", "benchmark", "time", "heap");
+
+    Button button(Board::SW0);
+    bench("Button::getState", iterations, [&](uint32_t i) {
+        // 64回ごとに押下/解放を切り替える
+        sim::digitalPins[Board::SW0] = (i >> 6) & 1;
+        sink = sink + button.getState();
+    });
+
+    NoisyAnalogRead analog;
+    analog.init(Board::POT0);
+    bench("SmoothAnalogRead::analogRead", iterations, [&](uint32_t i) {
+        (void)i;
+        sink = sink + analog.analogRead();
+    });
+
+    BenchOscilloscope scope;
+    scope.init(&u8g2, &cvScope, Board::POTS_ROW * 16);
+    scope.fillSine(3.3);
+    bench("EzOscilloscope::calcData", iterations, [&](uint32_t i) {
+        scope.touch(i);
+        scope.calc();
+        sink = sink + scope.getRangeMax();
+    });
+
+    u8g2.clearBuffer();
+    bench("EzOscilloscope::drawData", iterations, [&](uint32_t i) {
+        (void)i;
+        scope.draw();
+    });
+
+    scope.setDisplay(DISP_MODE_AVERAGE, 3, 3);
+    bench("EzOscilloscope::updateAverage", iterations, [&](uint32_t i) {
+        scope.touch(i);
+        scope.average();
+    });
+
+    scope.fillSine(3.3);
+    scope.calc();
+    bench("EzOscilloscope::updatePersist", iterations, [&](uint32_t i) {
+        scope.touch(i);
+        scope.persist();
+    });
+
+    bench("EzOscilloscope::drawPersist", iterations, [&](uint32_t i) {
+        (void)i;
+        scope.drawPersistence();
+    });
+
+    scope.fillDeep(400);
+    bench("EzOscilloscope::buildPyramid", max(iterations / 100, 1u), [&](uint32_t i) {
+        scope.touch(i);
+        scope.pyramid();
+    });
+
+    bench("EzOscilloscope::drawDeep (full)", iterations, [&](uint32_t i) {
+        scope.drawDeepView(DATA_MAX_VALUE, i & DATA_MAX_VALUE);
+    });
+
+    bench("EzOscilloscope::drawDeep (x24 pan)", iterations, [&](uint32_t i) {
+        scope.drawDeepView(2000, i & DATA_MAX_VALUE);
+    });
+
+    WaveMeasure measure;
+    measure.begin(2048, 128);
+    bench("WaveMeasure::put", iterations, [&](uint32_t i) {
+        measure.put(2048 + 1500 * ((i >> 5) & 1) - 750 + (int)(lcg() & 0x1F));
+    });
+    ScopeMeasure result;
+    measure.end(result);
+    sink = sink + result.edges;
+
+    // 分岐なしの最長プログラムで1周期あたりの上限を見る
+    static ControlVM<1> vm;
+    byte payload[FRAME_PAYLOAD_MAX];
+    for (byte offset = 0; offset < VM_PROGRAM_MAX;)
+    {
+        byte count = min((int)VM_INSTRUCTIONS_PER_FRAME, VM_PROGRAM_MAX - offset);
+        payload[0] = 0;
+        payload[1] = offset;
+        payload[2] = offset + count >= VM_PROGRAM_MAX;
+        for (byte i = 0; i < count; ++i)
+        {
+            byte pc = offset + i;
+            VMInstruction inst = {VM_OP_MULQ, (byte)(pc & 7), (byte)((pc + 1) & 7), (byte)(8 + (pc & 3))};
+            if (pc < 4)
+            {
+                inst = {VM_OP_IN, (byte)(8 + pc), pc, 0};
+            }
+            else if ((pc & 7) == 7)
+            {
+                inst = {VM_OP_OUT, (byte)(pc & 7), (byte)(pc & 3), 0};
+            }
+            memcpy(&payload[VM_FRAME_HEADER + i * sizeof(VMInstruction)], &inst, sizeof(VMInstruction));
+        }
+        byte slot, errorPc;
+        vm.load(payload, VM_FRAME_HEADER + count * sizeof(VMInstruction), slot, errorPc);
+        offset += count;
+    }
+    int32_t vmInputs[VM_IN_MAX] = {0};
+    int32_t vmOutputs[VM_OUT_MAX];
+    bench("ControlVM::run (64 ops)", iterations, [&](uint32_t i) {
+        vmInputs[i & 3] = i & POTS_MAX_VALUE;
+        sink = sink + vm.run(vmInputs, vmOutputs) + vmOutputs[0];
+    });
+
+    bench("ParamGroup::dispParamGroup", iterations, [&](uint32_t i) {
+        potValues[0] = i & POTS_MAX_VALUE;
+        ps[0].dispParamGroup(potValues);
+    });
+
+    bench("dispPresets", iterations, [&](uint32_t i) {
+        potValues[1] = i & POTS_MAX_VALUE;
+        dispPresets(&u8g2, (i >> 10) % PRESET_TOTAL, potValues);
+    });
+    printf("%-40s %12u hit %10u miss\n", "  LabelCache", labelCache.getHitCount(), labelCache.getMissCount());
+
+    // 表示コアの負担はcaptureだけ。sendはUSB側のコアで、描画1回ぶんの小さな変化を送る
+    DisplayMirror mirror;
+    Telemetry mirrorOut;
+    mirror.init();
+    mirror.start();
+    bench("DisplayMirror::capture", iterations, [&](uint32_t i) {
+        (void)i;
+        mirror.capture(u8g2.getBufferPtr());
+    });
+    bench("DisplayMirror::send (small delta)", iterations, [&](uint32_t i) {
+        u8g2.getBufferPtr()[(i * 37) % MIRROR_FRAME_SIZE] ^= 0x5A;
+        mirror.capture(u8g2.getBufferPtr());
+        sink = sink + mirror.send(mirrorOut, true);
+        mirrorOut.drain(Serial);
+    });
+    printf("%-40s %12.1f bytes/frame\n", "  encoded", (double)mirror.getByteCount() / max(mirror.getSendCount(), 1u));
+
+    const char *cvModeNames[] = {
+        "updatePresetsValues (cv off)",
+        "updatePresetsValues (cv absolute)",
+        "updatePresetsValues (cv relative)",
+    };
+    for (byte mode = 0; mode < 3; ++mode)
+    {
+        assignCVMode = mode;
+        assignCV2Pot = 2;
+        assignCVDepth = 50;
+        bench(cvModeNames[mode], iterations, [&](uint32_t i) {
+            sim::analogPins[Board::POT0] = i & POTS_MAX_VALUE;
+            sim::analogPins[Board::POT2] = (i * 7) & POTS_MAX_VALUE;
+            sim::analogPins[Board::CV] = (i * 13) & POTS_MAX_VALUE;
+            updatePresetsValues();
+        });
+    }
+
+    // 手を離したポットはADCノイズだけが乗る。このときのPWM書き込み回数を見る
+    assignCVDepth = 0;
+    uint32_t pwmWrites = sim::pwmWriteCount;
+    bench("updatePresetsValues (pots idle)", iterations, [&](uint32_t i) {
+        (void)i;
+        sim::analogPins[Board::POT0] = 1000 + (lcg() & 0x0F);
+        sim::analogPins[Board::POT1] = 2000 + (lcg() & 0x0F);
+        sim::analogPins[Board::POT2] = 3000 + (lcg() & 0x0F);
+        updatePresetsValues();
+    });
+    printf("%-40s %12.3f writes/call\n", "  pwm_set_chan_level", (double)(sim::pwmWriteCount - pwmWrites) / (iterations + iterations / 10 + 1));
+
+    return sink == 0xFFFFFFFF;
+}
@@ -0,0 +1,680 @@
+/*!
+ * FV-1 emulator
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * アセンブル済みFV-1プログラム(512バイト、ビッグエンディアン128命令)をホストで実行する
+ * 同じプログラムをLANES個のインスタンスで同時に回す。状態はレーン方向に並べてあり、
+ * 命令ごとのレーンループがそのままベクトル化される
+ * 実機と数値は一致しない。主な差分:
+ *   - 遅延メモリは24bit固定小数点のまま持つ(実機は14bit浮動小数点)
+ *   - LFOの振幅、クロスフェード形状、ランプ速度の換算は近似
+ *   - ポット入力はフィルタなし
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define FV1_PROGRAM_WORDS 128
+#define FV1_PROGRAM_SIZE (FV1_PROGRAM_WORDS * 4)
+#define FV1_DELAY_SIZE 32768
+#define FV1_REG_COUNT 64
+#define FV1_SAMPLE_RATE 32768
+
+// ACCはS.23。1.0はこの値に飽和する
+#define FV1_ACC_MAX 0x7FFFFF
+#define FV1_ACC_MIN (-0x800000)
+
+// レジスタ
+#define FV1_SIN0_RATE 0x00
+#define FV1_SIN0_RANGE 0x01
+#define FV1_SIN1_RATE 0x02
+#define FV1_SIN1_RANGE 0x03
+#define FV1_RMP0_RATE 0x04
+#define FV1_RMP0_RANGE 0x05
+#define FV1_RMP1_RATE 0x06
+#define FV1_RMP1_RANGE 0x07
+#define FV1_POT0 0x10
+#define FV1_POT1 0x11
+#define FV1_POT2 0x12
+#define FV1_ADCL 0x14
+#define FV1_ADCR 0x15
+#define FV1_DACL 0x16
+#define FV1_DACR 0x17
+#define FV1_ADDR_PTR 0x18
+
+// 命令
+#define FV1_OP_RDA 0x00
+#define FV1_OP_RMPA 0x01
+#define FV1_OP_WRA 0x02
+#define FV1_OP_WRAP 0x03
+#define FV1_OP_RDAX 0x04
+#define FV1_OP_RDFX 0x05
+#define FV1_OP_WRAX 0x06
+#define FV1_OP_WRHX 0x07
+#define FV1_OP_WRLX 0x08
+#define FV1_OP_MAXX 0x09
+#define FV1_OP_MULX 0x0A
+#define FV1_OP_LOG 0x0B
+#define FV1_OP_EXP 0x0C
+#define FV1_OP_SOF 0x0D
+#define FV1_OP_AND 0x0E
+#define FV1_OP_OR 0x0F
+#define FV1_OP_XOR 0x10
+#define FV1_OP_SKP 0x11
+#define FV1_OP_WLDX 0x12
+#define FV1_OP_JAM 0x13
+#define FV1_OP_CHO 0x14
+
+// SKP条件
+#define FV1_SKP_NEG 0x01
+#define FV1_SKP_GEZ 0x02
+#define FV1_SKP_ZRO 0x04
+#define FV1_SKP_ZRC 0x08
+#define FV1_SKP_RUN 0x10
+
+// CHO
+#define FV1_CHO_RDA 0
+#define FV1_CHO_SOF 2
+#define FV1_CHO_RDAL 3
+#define FV1_CHO_COS 0x01
+#define FV1_CHO_REG 0x02
+#define FV1_CHO_COMPC 0x04
+#define FV1_CHO_COMPA 0x08
+#define FV1_CHO_RPTR2 0x10
+#define FV1_CHO_NA 0x20
+
+/// @brief デコード済み命令
+struct Fv1Instruction
+{
+    uint8_t op;
+    uint8_t reg;   // レジスタ番号、SKP条件、CHO種別
+    uint8_t flags; // CHOフラグ、LFO番号
+    uint8_t skip;  // SKPで飛ばす命令数、CHOのLFO番号
+    int32_t c;     // 係数。固定小数点のまま
+    int32_t d;     // 加算値。ACCの単位(S.23)に換算済み
+    int32_t addr;  // 遅延アドレス、マスク、LFO設定値
+};
+
+template <int LANES>
+class Fv1Emulator
+{
+public:
+    Fv1Emulator()
+    {
+        memset(_program, 0, sizeof(_program));
+        for (int i = 0; i < FV1_PROGRAM_WORDS; ++i)
+        {
+            _program[i].op = FV1_OP_SKP;
+        }
+        _pDelay = new int32_t[FV1_DELAY_SIZE * LANES];
+        reset();
+    }
+
+    ~Fv1Emulator()
+    {
+        delete[] _pDelay;
+    }
+
+    Fv1Emulator(const Fv1Emulator &) = delete;
+    Fv1Emulator &operator=(const Fv1Emulator &) = delete;
+
+    /// @brief プログラム読込。状態は初期化する
+    /// @param pData 512バイト(asfv1 -bの出力、EEPROMイメージの1スロット)
+    void load(const uint8_t *pData)
+    {
+        for (int i = 0; i < FV1_PROGRAM_WORDS; ++i)
+        {
+            uint32_t word = ((uint32_t)pData[i * 4] << 24) | ((uint32_t)pData[i * 4 + 1] << 16) |
+                            ((uint32_t)pData[i * 4 + 2] << 8) | pData[i * 4 + 3];
+            _program[i] = decode(word);
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        memset(_acc, 0, sizeof(_acc));
+        memset(_pacc, 0, sizeof(_pacc));
+        memset(_lr, 0, sizeof(_lr));
+        memset(_regs, 0, sizeof(_regs));
+        memset(_pDelay, 0, sizeof(int32_t) * FV1_DELAY_SIZE * LANES);
+        for (int n = 0; n < 2; ++n)
+        {
+            for (int l = 0; l < LANES; ++l)
+            {
+                _sin[n][l] = 0;
+                _cos[n][l] = FV1_ACC_MAX;
+                _ramp[n][l] = 0;
+            }
+        }
+        _delayPtr = 0;
+        _firstRun = true;
+    }
+
+    /// @brief ポット入力
+    /// @param lane
+    /// @param pot 0-2
+    /// @param value 0.0-1.0をS.23で
+    void setPot(int lane, int pot, int32_t value)
+    {
+        _regs[FV1_POT0 + pot][lane] = sat24(value);
+    }
+
+    /// @brief 1サンプル処理
+    /// @param pInL レーンごとの入力(S.23)
+    /// @param pInR
+    /// @param pOutL レーンごとの出力(S.23)
+    /// @param pOutR
+    void process(const int32_t *pInL, const int32_t *pInR, int32_t *pOutL, int32_t *pOutR)
+    {
+        for (int l = 0; l < LANES; ++l)
+        {
+            _regs[FV1_ADCL][l] = sat24(pInL[l]);
+            _regs[FV1_ADCR][l] = sat24(pInR[l]);
+            _skip[l] = 0;
+        }
+        _skipping = 0;
+        _allActive = true;
+
+        for (int pc = 0; pc < FV1_PROGRAM_WORDS; ++pc)
+        {
+            execute(_program[pc]);
+        }
+
+        for (int l = 0; l < LANES; ++l)
+        {
+            pOutL[l] = _regs[FV1_DACL][l];
+            pOutR[l] = _regs[FV1_DACR][l];
+        }
+
+        updateLfo();
+        _delayPtr = (_delayPtr - 1) & (FV1_DELAY_SIZE - 1);
+        _firstRun = false;
+    }
+
+protected:
+    Fv1Instruction _program[FV1_PROGRAM_WORDS];
+    int32_t _acc[LANES];
+    int32_t _pacc[LANES];
+    int32_t _regs[FV1_REG_COUNT][LANES];
+    int32_t *_pDelay; // [アドレス][レーン]
+    int32_t _sin[2][LANES];
+    int32_t _cos[2][LANES];
+    int32_t _ramp[2][LANES]; // 1/256サンプル単位の位置
+    int32_t _lr[LANES]; // 最後に遅延メモリから読んだ値(WRAP用)
+    uint8_t _skip[LANES];
+    bool _active[LANES];
+    bool _allActive;
+    int _skipping; // SKP中のレーン数
+    int32_t _delayPtr;
+    bool _firstRun;
+
+    static inline int32_t sat24(int64_t value)
+    {
+        return value > FV1_ACC_MAX ? FV1_ACC_MAX : value < FV1_ACC_MIN ? FV1_ACC_MIN : (int32_t)value;
+    }
+
+    /// @brief 固定小数点の積
+    /// @param value S.23
+    /// @param coef 小数部fracBitsの固定小数点
+    static inline int32_t mul(int32_t value, int32_t coef, int fracBits)
+    {
+        return sat24(((int64_t)value * coef) >> fracBits);
+    }
+
+    static inline int32_t abs24(int32_t value)
+    {
+        return value < 0 ? sat24(-(int64_t)value) : value;
+    }
+
+    /// @brief 24bit値を符号拡張
+    static inline int32_t sext24(int32_t value)
+    {
+        return (int32_t)((uint32_t)value << 8) >> 8;
+    }
+
+    static Fv1Instruction decode(uint32_t word)
+    {
+        Fv1Instruction inst;
+        memset(&inst, 0, sizeof(inst));
+        inst.op = word & 0x1F;
+        switch (inst.op)
+        {
+        case FV1_OP_RDA:
+        case FV1_OP_RMPA:
+        case FV1_OP_WRA:
+        case FV1_OP_WRAP:
+            // C:S1.9 ADDR:15bit
+            inst.c = (int32_t)word >> 21;
+            inst.addr = (word >> 5) & (FV1_DELAY_SIZE - 1);
+            break;
+        case FV1_OP_RDAX:
+        case FV1_OP_RDFX:
+        case FV1_OP_WRAX:
+        case FV1_OP_WRHX:
+        case FV1_OP_WRLX:
+        case FV1_OP_MAXX:
+        case FV1_OP_MULX:
+            // C:S1.14 REG:6bit
+            inst.c = (int32_t)word >> 16;
+            inst.reg = (word >> 5) & 0x3F;
+            break;
+        case FV1_OP_LOG:
+        case FV1_OP_EXP:
+        case FV1_OP_SOF:
+            // C:S1.14 D:S.10(LOGはS4.6だが結果が/16されるので同じ換算になる)
+            inst.c = (int32_t)word >> 16;
+            inst.d = ((int32_t)(word << 16) >> 21) << 13;
+            break;
+        case FV1_OP_AND:
+        case FV1_OP_OR:
+        case FV1_OP_XOR:
+            inst.addr = (word >> 8) & 0xFFFFFF;
+            break;
+        case FV1_OP_SKP:
+            inst.reg = word >> 27;
+            inst.skip = (word >> 21) & 0x3F;
+            break;
+        case FV1_OP_WLDX:
+            inst.flags = (word >> 29) & 1;
+            if (word & (1u << 30))
+            {
+                // WLDR F:S.15 A:2bit
+                inst.reg = 1;
+                inst.c = (int16_t)((word >> 13) & 0xFFFF);
+                inst.addr = (word >> 5) & 3;
+            }
+            else
+            {
+                // WLDS F:9bit A:15bit
+                inst.c = (word >> 20) & 0x1FF;
+                inst.addr = (word >> 5) & 0x7FFF;
+            }
+            break;
+        case FV1_OP_JAM:
+            inst.flags = (word >> 6) & 1;
+            break;
+        case FV1_OP_CHO:
+            inst.reg = word >> 30;
+            inst.flags = (word >> 24) & 0x3F;
+            inst.skip = (word >> 21) & 3;
+            if (inst.reg == FV1_CHO_SOF)
+            {
+                inst.d = (int32_t)(int16_t)((word >> 5) & 0xFFFF) << 8;
+            }
+            else
+            {
+                inst.addr = (word >> 5) & 0xFFFF;
+            }
+            break;
+        default:
+            // 未定義命令はNOP扱い
+            inst.op = FV1_OP_SKP;
+            break;
+        }
+        return inst;
+    }
+
+    /// @brief SKP中でないレーンだけfuncを実行する
+    /// 全レーンが実行中なら分岐なしで回すのでベクトル化される
+    template <typename F>
+    inline void lanes(F func)
+    {
+        if (_allActive)
+        {
+            for (int l = 0; l < LANES; ++l)
+            {
+                _pacc[l] = func(l, _pacc[l]);
+            }
+            return;
+        }
+
+        for (int l = 0; l < LANES; ++l)
+        {
+            if (_active[l])
+            {
+                _pacc[l] = func(l, _pacc[l]);
+            }
+        }
+    }
+
+    inline int32_t &delay(int32_t addr, int l)
+    {
+        return _pDelay[((addr + _delayPtr) & (FV1_DELAY_SIZE - 1)) * LANES + l];
+    }
+
+    void execute(const Fv1Instruction &inst)
+    {
+        // SKP中のレーンはこの命令を実行せず、残り命令数を減らす
+        _allActive = _skipping == 0;
+        if (!_allActive)
+        {
+            _skipping = 0;
+            for (int l = 0; l < LANES; ++l)
+            {
+                _active[l] = _skip[l] == 0;
+                _skip[l] -= _skip[l] > 0;
+                _skipping += _skip[l] > 0;
+            }
+        }
+
+        // funcはレーン番号と直前の命令前のACC(PACC)を受け、この命令前のACCを返す
+        const int32_t c = inst.c;
+        const int32_t d = inst.d;
+        const int32_t addr = inst.addr;
+        const int reg = inst.reg;
+        switch (inst.op)
+        {
+        case FV1_OP_RDA:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _lr[l] = delay(addr, l);
+                _acc[l] = sat24(acc + (int64_t)mul(_lr[l], c, 9));
+                return acc;
+            });
+            break;
+        case FV1_OP_RMPA:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _lr[l] = delay(_regs[FV1_ADDR_PTR][l] >> 8, l);
+                _acc[l] = sat24(acc + (int64_t)mul(_lr[l], c, 9));
+                return acc;
+            });
+            break;
+        case FV1_OP_WRA:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                delay(addr, l) = acc;
+                _acc[l] = mul(acc, c, 9);
+                return acc;
+            });
+            break;
+        case FV1_OP_WRAP:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                delay(addr, l) = acc;
+                _acc[l] = sat24((int64_t)mul(acc, c, 9) + _lr[l]);
+                return acc;
+            });
+            break;
+        case FV1_OP_RDAX:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = sat24(acc + (int64_t)mul(_regs[reg][l], c, 14));
+                return acc;
+            });
+            break;
+        case FV1_OP_RDFX:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                int32_t r = _regs[reg][l];
+                _acc[l] = sat24((int64_t)mul(sat24((int64_t)acc - r), c, 14) + r);
+                return acc;
+            });
+            break;
+        case FV1_OP_WRAX:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _regs[reg][l] = acc;
+                _acc[l] = mul(acc, c, 14);
+                return acc;
+            });
+            break;
+        case FV1_OP_WRHX:
+            lanes([&](int l, int32_t pacc) {
+                int32_t acc = _acc[l];
+                _regs[reg][l] = acc;
+                _acc[l] = sat24((int64_t)mul(acc, c, 14) + pacc);
+                return acc;
+            });
+            break;
+        case FV1_OP_WRLX:
+            lanes([&](int l, int32_t pacc) {
+                int32_t acc = _acc[l];
+                _regs[reg][l] = acc;
+                _acc[l] = sat24((int64_t)mul(sat24((int64_t)pacc - acc), c, 14) + pacc);
+                return acc;
+            });
+            break;
+        case FV1_OP_MAXX:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                int32_t a = abs24(mul(_regs[reg][l], c, 14));
+                int32_t b = abs24(acc);
+                _acc[l] = a > b ? a : b;
+                return acc;
+            });
+            break;
+        case FV1_OP_MULX:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = mul(acc, _regs[reg][l], 23);
+                return acc;
+            });
+            break;
+        case FV1_OP_LOG:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                // log2(|ACC|)/16 をS4.19で
+                int32_t a = abs24(acc);
+                double lg = a == 0 ? -16.0 : log2((double)a / (1 << 23));
+                int32_t value = sat24((int64_t)(lg / 16.0 * (1 << 23)));
+                _acc[l] = sat24((int64_t)mul(value, c, 14) + d);
+                return acc;
+            });
+            break;
+        case FV1_OP_EXP:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                // ACCをS4.19とみて2^x。0以上は1.0に飽和
+                double x = (double)acc / (1 << 23) * 16.0;
+                int32_t value = acc >= 0 ? FV1_ACC_MAX : (int32_t)(exp2(x) * (1 << 23));
+                _acc[l] = sat24((int64_t)mul(value, c, 14) + d);
+                return acc;
+            });
+            break;
+        case FV1_OP_SOF:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = sat24((int64_t)mul(acc, c, 14) + d);
+                return acc;
+            });
+            break;
+        case FV1_OP_AND:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = sext24(acc & addr);
+                return acc;
+            });
+            break;
+        case FV1_OP_OR:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = sext24(acc | addr);
+                return acc;
+            });
+            break;
+        case FV1_OP_XOR:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                _acc[l] = sext24(acc ^ addr);
+                return acc;
+            });
+            break;
+        case FV1_OP_SKP:
+            if (inst.skip == 0)
+            {
+                // NOP。条件0はJMP
+                break;
+            }
+            lanes([&](int l, int32_t pacc) {
+                int32_t acc = _acc[l];
+                bool jump = true;
+                if (reg & FV1_SKP_RUN)
+                    jump = jump && !_firstRun;
+                if (reg & FV1_SKP_ZRC)
+                    jump = jump && ((acc < 0) != (pacc < 0));
+                if (reg & FV1_SKP_ZRO)
+                    jump = jump && acc == 0;
+                if (reg & FV1_SKP_GEZ)
+                    jump = jump && acc >= 0;
+                if (reg & FV1_SKP_NEG)
+                    jump = jump && acc < 0;
+                if (jump)
+                {
+                    _skip[l] = inst.skip;
+                }
+                return acc;
+            });
+            _skipping = 0;
+            for (int l = 0; l < LANES; ++l)
+            {
+                _skipping += _skip[l] > 0;
+            }
+            break;
+        case FV1_OP_WLDX:
+            lanes([&](int l, int32_t) {
+                int n = inst.flags;
+                if (reg == 1)
+                {
+                    _regs[FV1_RMP0_RATE + n * 2][l] = c << 8;
+                    _regs[FV1_RMP0_RANGE + n * 2][l] = addr << 21;
+                }
+                else
+                {
+                    _regs[FV1_SIN0_RATE + n * 2][l] = c << 14;
+                    _regs[FV1_SIN0_RANGE + n * 2][l] = addr << 8;
+                }
+                return _acc[l];
+            });
+            break;
+        case FV1_OP_JAM:
+            lanes([&](int l, int32_t) {
+                _ramp[inst.flags][l] = 0;
+                return _acc[l];
+            });
+            break;
+        case FV1_OP_CHO:
+            executeCho(inst);
+            break;
+        }
+    }
+
+    /// @brief ランプの振幅(1/256サンプル単位)
+    inline int32_t rampAmp256(int n, int l)
+    {
+        return (4096 >> ((_regs[FV1_RMP0_RANGE + n * 2][l] >> 21) & 3)) << 8;
+    }
+
+    /// @brief CHOで使うLFOの値
+    /// @param offset256 遅延オフセット(1/256サンプル)
+    /// @param coef 補間係数またはクロスフェード(S.23)
+    /// @param value RDAL用の値(S.23)
+    inline void choLfo(const Fv1Instruction &inst, int l, int32_t &offset256, int32_t &coef, int32_t &value)
+    {
+        int n = inst.skip;
+        int flags = inst.flags;
+        if (n < 2)
+        {
+            int32_t range = _regs[FV1_SIN0_RANGE + n * 2][l] >> 8 & 0x7FFF;
+            int32_t v = (flags & FV1_CHO_COS) ? _cos[n][l] : _sin[n][l];
+            if (flags & FV1_CHO_COMPA)
+            {
+                v = -v;
+            }
+            offset256 = (int32_t)(((int64_t)v * range) >> 16);
+            coef = (offset256 & 0xFF) << 15;
+            value = (int32_t)(((int64_t)v * range) >> 15);
+        }
+        else
+        {
+            n -= 2;
+            int32_t amp = rampAmp256(n, l);
+            int32_t pos = _ramp[n][l];
+            if (flags & FV1_CHO_RPTR2)
+            {
+                pos += amp >> 1;
+                pos -= pos >= amp ? amp : 0;
+            }
+            if (flags & FV1_CHO_COMPA)
+            {
+                pos = amp - 1 - pos;
+            }
+            offset256 = pos;
+            // 端で0、中央で1の三角形
+            int32_t xfade = (int32_t)(((int64_t)(pos < (amp >> 1) ? pos : amp - pos) << 24) / amp);
+            xfade = xfade > FV1_ACC_MAX ? FV1_ACC_MAX : xfade;
+            coef = (flags & FV1_CHO_NA) ? xfade : (pos & 0xFF) << 15;
+            value = (flags & FV1_CHO_NA) ? xfade : (int32_t)(((int64_t)pos << 23) / amp);
+        }
+
+        if (flags & FV1_CHO_COMPC)
+        {
+            coef = FV1_ACC_MAX - coef;
+        }
+    }
+
+    void executeCho(const Fv1Instruction &inst)
+    {
+        const int32_t addr = inst.addr;
+        const int32_t d = inst.d;
+        switch (inst.reg)
+        {
+        case FV1_CHO_RDA:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                int32_t offset256, coef, value;
+                choLfo(inst, l, offset256, coef, value);
+                _lr[l] = delay(addr + (offset256 >> 8), l);
+                _acc[l] = sat24(acc + (int64_t)mul(_lr[l], coef, 23));
+                return acc;
+            });
+            break;
+        case FV1_CHO_SOF:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                int32_t offset256, coef, value;
+                choLfo(inst, l, offset256, coef, value);
+                _acc[l] = sat24((int64_t)mul(acc, coef, 23) + d);
+                return acc;
+            });
+            break;
+        case FV1_CHO_RDAL:
+            lanes([&](int l, int32_t) {
+                int32_t acc = _acc[l];
+                int32_t offset256, coef, value;
+                choLfo(inst, l, offset256, coef, value);
+                _acc[l] = sat24(value);
+                return acc;
+            });
+            break;
+        default:
+            break;
+        }
+    }
+
+    void updateLfo()
+    {
+        for (int n = 0; n < 2; ++n)
+        {
+            for (int l = 0; l < LANES; ++l)
+            {
+                // 結合型発振器。f = rate * Fs / (2^17 * 2π)
+                int32_t rate = (_regs[FV1_SIN0_RATE + n * 2][l] >> 14) & 0x1FF;
+                _sin[n][l] += (int32_t)(((int64_t)_cos[n][l] * rate) >> 17);
+                _cos[n][l] -= (int32_t)(((int64_t)_sin[n][l] * rate) >> 17);
+
+                // rate 16384で1サンプル/サンプル(4096幅で1オクターブ上)
+                int32_t amp = rampAmp256(n, l);
+                int32_t pos = _ramp[n][l] - ((int32_t)(int16_t)(_regs[FV1_RMP0_RATE + n * 2][l] >> 8) >> 6);
+                pos %= amp;
+                _ramp[n][l] = pos < 0 ? pos + amp : pos;
+            }
+        }
+    }
+};
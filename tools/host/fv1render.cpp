@@ -0,0 +1,392 @@
+/*!
+ * Host FV-1 offline renderer
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * FV-1プログラムをエミュレータで実行してWAVに書き出す
+ *   fv1render program.bin out.wav [options]
+ *     --slot N|all        バンクイメージ(4096バイト)のスロット。allで8本とも
+ *     --in input.wav      16bit PCM。32768Hz以外は線形補間で変換する
+ *     --impulse|--noise|--sine HZ  入力がないときのテスト信号(既定はimpulse)
+ *     --seconds S         長さ(既定2秒、--inがあればその長さ)
+ *     --pot P0,P1,P2      ポット値(0-4095。ファームウェアのPWM値と同じ)
+ *     --sweep N           POT Nをレーンごとに0-4095で振り、レーン数分書き出す
+ * 出力名は複数になるとき out_s<slot>_p<lane>.wav になる
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "fv1/Fv1Emulator.hpp"
+
+#define LANES 8
+#define POT_MAX_VALUE 4095
+
+struct Audio
+{
+    std::vector<int32_t> left;
+    std::vector<int32_t> right;
+};
+
+static uint32_t readLe(const uint8_t *p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static bool readFile(const char *pPath, std::vector<uint8_t> &data)
+{
+    FILE *fp = fopen(pPath, "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    uint8_t buff[4096];
+    size_t count;
+    while ((count = fread(buff, 1, sizeof(buff), fp)) > 0)
+    {
+        data.insert(data.end(), buff, buff + count);
+    }
+    fclose(fp);
+    return true;
+}
+
+/// @brief 16bit PCMのWAVを読み、32768HzのS.23に変換する
+static bool readWav(const char *pPath, Audio &audio)
+{
+    std::vector<uint8_t> data;
+    if (!readFile(pPath, data) || data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    uint32_t rate = 0;
+    size_t pos = 12;
+    while (pos + 8 <= data.size())
+    {
+        uint32_t size = readLe(&data[pos + 4], 4);
+        const uint8_t *pChunk = &data[pos + 8];
+        if (pos + 8 + size > data.size())
+        {
+            size = data.size() - pos - 8;
+        }
+
+        if (memcmp(&data[pos], "fmt ", 4) == 0 && size >= 16)
+        {
+            channels = readLe(pChunk + 2, 2);
+            rate = readLe(pChunk + 4, 4);
+            bits = readLe(pChunk + 14, 2);
+        }
+        else if (memcmp(&data[pos], "data", 4) == 0)
+        {
+            if (bits != 16 || channels == 0 || rate == 0)
+            {
+                return false;
+            }
+            size_t frames = size / (2 * channels);
+            size_t outFrames = (size_t)((double)frames * FV1_SAMPLE_RATE / rate);
+            audio.left.resize(outFrames);
+            audio.right.resize(outFrames);
+            for (size_t i = 0; i < outFrames; ++i)
+            {
+                double src = (double)i * rate / FV1_SAMPLE_RATE;
+                size_t i0 = (size_t)src;
+                size_t i1 = i0 + 1 < frames ? i0 + 1 : i0;
+                double t = src - i0;
+                for (int ch = 0; ch < 2; ++ch)
+                {
+                    int c = ch < channels ? ch : 0;
+                    int16_t s0 = (int16_t)readLe(pChunk + (i0 * channels + c) * 2, 2);
+                    int16_t s1 = (int16_t)readLe(pChunk + (i1 * channels + c) * 2, 2);
+                    int32_t value = (int32_t)((s0 + (s1 - s0) * t) * 256);
+                    (ch == 0 ? audio.left : audio.right)[i] = value;
+                }
+            }
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+static void putLe(std::vector<uint8_t> &out, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        out.push_back((value >> (i * 8)) & 0xFF);
+    }
+}
+
+static bool writeWav(const std::string &path, const Audio &audio)
+{
+    std::vector<uint8_t> out;
+    uint32_t dataSize = audio.left.size() * 4;
+    out.insert(out.end(), {'R', 'I', 'F', 'F'});
+    putLe(out, 36 + dataSize, 4);
+    out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    putLe(out, 16, 4);
+    putLe(out, 1, 2);
+    putLe(out, 2, 2);
+    putLe(out, FV1_SAMPLE_RATE, 4);
+    putLe(out, FV1_SAMPLE_RATE * 4, 4);
+    putLe(out, 4, 2);
+    putLe(out, 16, 2);
+    out.insert(out.end(), {'d', 'a', 't', 'a'});
+    putLe(out, dataSize, 4);
+    for (size_t i = 0; i < audio.left.size(); ++i)
+    {
+        putLe(out, (uint16_t)(int16_t)(audio.left[i] >> 8), 2);
+        putLe(out, (uint16_t)(int16_t)(audio.right[i] >> 8), 2);
+    }
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    bool result = fwrite(out.data(), 1, out.size(), fp) == out.size();
+    fclose(fp);
+    return result;
+}
+
+static void makeSignal(const char *pKind, double freq, size_t frames, Audio &audio)
+{
+    audio.left.assign(frames, 0);
+    audio.right.assign(frames, 0);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < frames; ++i)
+    {
+        int32_t value = 0;
+        if (strcmp(pKind, "noise") == 0)
+        {
+            seed = seed * 1664525 + 1013904223;
+            value = ((int32_t)(seed >> 8) - 0x800000) >> 2;
+        }
+        else if (strcmp(pKind, "sine") == 0)
+        {
+            value = (int32_t)(sin(2.0 * M_PI * freq * i / FV1_SAMPLE_RATE) * 0x200000);
+        }
+        else if (i == 0)
+        {
+            value = 0x400000;
+        }
+        audio.left[i] = value;
+        audio.right[i] = value;
+    }
+}
+
+static std::string outputName(const std::string &base, int slot, int lane, bool multiSlot, bool multiLane)
+{
+    if (!multiSlot && !multiLane)
+    {
+        return base;
+    }
+    std::string stem = base;
+    std::string ext = ".wav";
+    size_t dot = base.rfind('.');
+    if (dot != std::string::npos && base.find('/', dot) == std::string::npos)
+    {
+        stem = base.substr(0, dot);
+        ext = base.substr(dot);
+    }
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_s%d_p%d", slot, lane);
+    return stem + suffix + ext;
+}
+
+/// @brief スロットごとにNレーンで実行して書き出す。Nが1より大きいときはsweepのPOTをレーンで振る
+/// @param renderSeconds エミュレータの実行時間を足していく
+template <int N>
+static bool render(const std::vector<uint8_t> &image, int slotFirst, int slotLast, const Audio &input,
+                   const int pots[3], int sweep, const std::string &outPath, double &renderSeconds)
+{
+    size_t frames = input.left.size();
+    // 遅延メモリだけで1MBあるのでヒープに置く
+    Fv1Emulator<N> *pFv1 = new Fv1Emulator<N>();
+    std::vector<Audio> outputs(N);
+
+    for (int slot = slotFirst; slot <= slotLast; ++slot)
+    {
+        pFv1->load(&image[slot * FV1_PROGRAM_SIZE]);
+        for (int l = 0; l < N; ++l)
+        {
+            for (int p = 0; p < 3; ++p)
+            {
+                int value = p == sweep && N > 1 ? POT_MAX_VALUE * l / (N - 1) : pots[p];
+                pFv1->setPot(l, p, value << 11);
+            }
+            outputs[l].left.resize(frames);
+            outputs[l].right.resize(frames);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        int32_t inL[N], inR[N], outL[N], outR[N];
+        for (size_t i = 0; i < frames; ++i)
+        {
+            for (int l = 0; l < N; ++l)
+            {
+                inL[l] = input.left[i];
+                inR[l] = input.right[i];
+            }
+            pFv1->process(inL, inR, outL, outR);
+            for (int l = 0; l < N; ++l)
+            {
+                outputs[l].left[i] = outL[l];
+                outputs[l].right[i] = outR[l];
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        renderSeconds += std::chrono::duration<double>(end - start).count();
+
+        for (int l = 0; l < N; ++l)
+        {
+            std::string path = outputName(outPath, slot, l, slotFirst != slotLast, N > 1);
+            if (!writeWav(path, outputs[l]))
+            {
+                fprintf(stderr, "cannot write %s\n", path.c_str());
+                delete pFv1;
+                return false;
+            }
+        }
+    }
+    delete pFv1;
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fv1render program.bin out.wav [--slot N|all] [--in input.wav | --impulse | --noise | --sine HZ]\n"
+                    "                 [--seconds S] [--pot P0,P1,P2] [--sweep N]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage();
+        return 2;
+    }
+
+    const char *pProgramPath = argv[1];
+    std::string outPath = argv[2];
+    const char *pInPath = NULL;
+    const char *pSignal = "impulse";
+    double freq = 440;
+    double seconds = 2;
+    bool secondsSet = false;
+    int slotFirst = 0;
+    int slotLast = 0;
+    int pots[3] = {POT_MAX_VALUE / 2, POT_MAX_VALUE / 2, POT_MAX_VALUE / 2};
+    int sweep = -1;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--slot" && hasValue)
+        {
+            std::string value = argv[++i];
+            slotFirst = value == "all" ? 0 : atoi(value.c_str());
+            slotLast = value == "all" ? 7 : slotFirst;
+        }
+        else if (arg == "--in" && hasValue)
+        {
+            pInPath = argv[++i];
+        }
+        else if (arg == "--impulse" || arg == "--noise")
+        {
+            pSignal = argv[i] + 2;
+        }
+        else if (arg == "--sine" && hasValue)
+        {
+            pSignal = "sine";
+            freq = atof(argv[++i]);
+        }
+        else if (arg == "--seconds" && hasValue)
+        {
+            seconds = atof(argv[++i]);
+            secondsSet = true;
+        }
+        else if (arg == "--pot" && hasValue)
+        {
+            if (sscanf(argv[++i], "%d,%d,%d", &pots[0], &pots[1], &pots[2]) != 3)
+            {
+                usage();
+                return 2;
+            }
+        }
+        else if (arg == "--sweep" && hasValue)
+        {
+            sweep = atoi(argv[++i]);
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    std::vector<uint8_t> image;
+    if (!readFile(pProgramPath, image) || image.size() < FV1_PROGRAM_SIZE)
+    {
+        fprintf(stderr, "cannot read program %s\n", pProgramPath);
+        return 2;
+    }
+    int slots = image.size() / FV1_PROGRAM_SIZE;
+    if (slotLast >= slots)
+    {
+        slotLast = slots - 1;
+    }
+    if (slotFirst < 0 || slotFirst > slotLast || sweep > 2)
+    {
+        usage();
+        return 2;
+    }
+
+    Audio input;
+    if (pInPath != NULL)
+    {
+        if (!readWav(pInPath, input))
+        {
+            fprintf(stderr, "cannot read 16bit pcm wav %s\n", pInPath);
+            return 2;
+        }
+        if (secondsSet)
+        {
+            size_t frames = (size_t)(seconds * FV1_SAMPLE_RATE);
+            input.left.resize(frames, 0);
+            input.right.resize(frames, 0);
+        }
+    }
+    else
+    {
+        makeSignal(pSignal, freq, (size_t)(seconds * FV1_SAMPLE_RATE), input);
+    }
+    size_t frames = input.left.size();
+
+    // 振らないときは1レーンだけ回す。余分なレーンを計算すると速度の表示も狂う
+    int lanes = sweep >= 0 ? LANES : 1;
+    double renderSeconds = 0;
+    bool ok = sweep >= 0 ? render<LANES>(image, slotFirst, slotLast, input, pots, sweep, outPath, renderSeconds)
+                         : render<1>(image, slotFirst, slotLast, input, pots, sweep, outPath, renderSeconds);
+    if (!ok)
+    {
+        return 2;
+    }
+
+    double audioSeconds = (double)frames * (slotLast - slotFirst + 1) * lanes / FV1_SAMPLE_RATE;
+    fprintf(stderr, "%d program(s) x %d lanes, %.1f s audio in %.2f s (%.0fx realtime)\n",
+            slotLast - slotFirst + 1, lanes, audioSeconds, renderSeconds,
+            renderSeconds > 0 ? audioSeconds / renderSeconds : 0);
+    return 0;
+}
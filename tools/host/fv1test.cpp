@@ -0,0 +1,197 @@
+/*!
+ * Host FV-1 emulator test
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 手で組んだ短いプログラムをエミュレータに通し、出力を1サンプルずつ確かめる
+ *   fv1test
+ * 失敗した項目を表示し、1つでもあれば終了コード1
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "fv1/Fv1Emulator.hpp"
+
+// SKP 0,0
+#define FV1_NOP 0x00000011
+
+static uint32_t failCount = 0;
+
+static void check(bool ok, const char *what, long sample, long value)
+{
+    if (!ok)
+    {
+        failCount++;
+        printf("FAILED: %s at %ld (%ld)\n", what, sample, value);
+    }
+}
+
+/// @brief 命令語を512バイトのイメージ(ビッグエンディアン)にして読み込む。残りはNOP
+template <int LANES>
+static void loadWords(Fv1Emulator<LANES> &fv1, const uint32_t *pWords, int count)
+{
+    uint8_t image[FV1_PROGRAM_SIZE];
+    for (int i = 0; i < FV1_PROGRAM_WORDS; ++i)
+    {
+        uint32_t word = i < count ? pWords[i] : FV1_NOP;
+        image[i * 4] = word >> 24;
+        image[i * 4 + 1] = word >> 16;
+        image[i * 4 + 2] = word >> 8;
+        image[i * 4 + 3] = word;
+    }
+    fv1.load(image);
+}
+
+/// @brief RDA/WRA: 書いた値が遅延アドレスのサンプル数だけ後に読める
+static void testDelay()
+{
+    static const uint32_t program[] = {
+        0x40000284, // rdax ADCL,1.0
+        0x00000002, // wra 0,0
+        0x20000C80, // rda 100,0.5
+        0x000002C6, // wrax DACL,0
+    };
+    Fv1Emulator<1> *pFv1 = new Fv1Emulator<1>();
+    loadWords(*pFv1, program, 4);
+
+    for (int s = 0; s < 300; ++s)
+    {
+        int32_t inL = s == 0 ? 16384 : 0;
+        int32_t inR = 0;
+        int32_t outL, outR;
+        pFv1->process(&inL, &inR, &outL, &outR);
+        check(outL == (s == 100 ? 8192 : 0), "delay impulse", s, outL);
+    }
+    delete pFv1;
+}
+
+/// @brief WRHX/WRLX: PACCは1つ前の命令を実行する前のACC
+static void testPacc()
+{
+    static const uint32_t program[] = {
+        0x40000284, // rdax ADCL,1.0
+        0x1000000D, // sof 0.25,0
+        0x20000407, // wrhx REG0,0.5    ACC = ACC*0.5 + PACC
+        0x000002C6, // wrax DACL,0
+        0x40000284, // rdax ADCL,1.0
+        0x1000000D, // sof 0.25,0
+        0x20000428, // wrlx REG1,0.5    ACC = (PACC - ACC)*0.5 + PACC
+        0x000002E6, // wrax DACR,0
+    };
+    Fv1Emulator<1> *pFv1 = new Fv1Emulator<1>();
+    loadWords(*pFv1, program, 8);
+
+    // x/4*0.5 + x と (x - x/4)*0.5 + x
+    int32_t inL = 0x100000;
+    int32_t inR = 0;
+    for (int s = 0; s < 4; ++s)
+    {
+        int32_t outL, outR;
+        pFv1->process(&inL, &inR, &outL, &outR);
+        check(outL == 0x120000, "wrhx pacc", s, outL);
+        check(outR == 0x160000, "wrlx pacc", s, outR);
+    }
+    delete pFv1;
+}
+
+/// @brief SKP: 条件はレーンごとに判定し、飛ばしたレーンだけ命令を実行しない
+static void testSkip()
+{
+    static const uint32_t program[] = {
+        0x40000284, // rdax ADCL,1.0
+        0x08400011, // skp NEG,2
+        0x0000400D, // sof 0,0.5
+        0x000002C6, // wrax DACL,0
+        0x000002E6, // wrax DACR,0
+    };
+    Fv1Emulator<2> *pFv1 = new Fv1Emulator<2>();
+    loadWords(*pFv1, program, 5);
+
+    int32_t inL[2] = {-0x1000, 0x1000};
+    int32_t inR[2] = {0, 0};
+    for (int s = 0; s < 4; ++s)
+    {
+        int32_t outL[2], outR[2];
+        pFv1->process(inL, inR, outL, outR);
+        check(outL[0] == 0, "skp taken dacl", s, outL[0]);
+        check(outR[0] == -0x1000, "skp taken dacr", s, outR[0]);
+        check(outL[1] == 0x400000, "skp not taken dacl", s, outL[1]);
+        check(outR[1] == 0, "skp not taken dacr", s, outR[1]);
+    }
+    delete pFv1;
+}
+
+/// @brief JAM: 実行したレーンのランプだけ0に戻る
+static void testJam()
+{
+    static const uint32_t program[] = {
+        0x48000012, // wldr RMP0,16384,4096
+        0x40000284, // rdax ADCL,1.0
+        0x08200011, // skp NEG,1
+        0x00000093, // jam RMP0
+        0xC0400014, // cho rdal,RMP0
+        0x000002C6, // wrax DACL,0
+    };
+    Fv1Emulator<2> *pFv1 = new Fv1Emulator<2>();
+    loadWords(*pFv1, program, 6);
+
+    // 1サンプルで1サンプル分(256/256)下がり、4096で1周
+    int32_t inL[2] = {0x1000, -0x1000};
+    int32_t inR[2] = {0, 0};
+    for (int s = 0; s < 64; ++s)
+    {
+        int32_t outL[2], outR[2];
+        pFv1->process(inL, inR, outL, outR);
+        int32_t expect = s == 0 ? 0 : (int32_t)(((int64_t)(4096 - s) << 23) / 4096);
+        check(outL[0] == 0, "jam ramp reset", s, outL[0]);
+        check(outL[1] == expect, "jam skipped ramp", s, outL[1]);
+    }
+    delete pFv1;
+}
+
+/// @brief CHO RDA: ランプの小数部で隣り合う2サンプルを補間する
+static void testChoInterpolation()
+{
+    static const uint32_t program[] = {
+        0x5E000012, // wldr RMP0,-4096,4096
+        0x40000284, // rdax ADCL,1.0
+        0x00000002, // wra 0,0
+        0x04400C94, // cho rda,RMP0,COMPC,100
+        0x00400CB4, // cho rda,RMP0,0,101
+        0x000002C6, // wrax DACL,0
+    };
+    Fv1Emulator<1> *pFv1 = new Fv1Emulator<1>();
+    loadWords(*pFv1, program, 6);
+
+    // ランプは1サンプルで64/256進む。入力はサンプル番号*1024のランプ
+    std::vector<int32_t> outs;
+    for (int s = 0; s < 256; ++s)
+    {
+        int32_t inL = s * 1024;
+        int32_t inR = 0;
+        int32_t outL, outR;
+        pFv1->process(&inL, &inR, &outL, &outR);
+        outs.push_back(outL);
+    }
+
+    // 202: 位置50+128/256。サンプル52と51を半分ずつ(COMPC側は1-2^-23)
+    check(outs[202] == 26623 + 26112, "cho half", 202, outs[202]);
+    // 200: 位置50ちょうど。サンプル50だけ
+    check(outs[200] == 51199, "cho integer", 200, outs[200]);
+    // 203: 位置50+192/256。サンプル53を1/4、52を3/4
+    check(outs[203] == 13567 + 39936, "cho quarter", 203, outs[203]);
+}
+
+int main()
+{
+    testDelay();
+    testPacc();
+    testSkip();
+    testJam();
+    testChoInterpolation();
+
+    printf("%s\n", failCount == 0 ? "ok" : "FAILED");
+    return failCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/*!
+ * Host unit link harness
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 本体どうしの連携(UnitLink)をファームウェアごと動かして確かめる
+ *   link [seconds]                  擬似端末の組を作り、先導側と追従側を2つのプロセスで動かす
+ *   link leader TTY [seconds]       TTYにつないで先導側として動く(socatの擬似端末やUSB-UARTなど)
+ *   link follower TTY [seconds]     TTYにつないで追従側として動く
+ * 先導側はプリセットを一定間隔でランダムに変え、ポットをランダムに動かす
+ * 組で動かしたときは、変えたプリセットがすべて追従側に届いたか、届くまでの時間、
+ * 最後のパラメタ値が揃ったかを表示し、揃わなければ終了コード1
+ *   socat -d -d pty,raw,echo=0 pty,raw,echo=0 で作った擬似端末の組でも同じことができる
+ */
+
+#include <random>
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../../app/ReverIsland/src/main.cpp"
+
+#define LINK_CHANGE_MAX 1024
+// プリセットを変える間隔。最後のこの時間はポットも止めて値が揃うのを待つ
+#define LINK_CHANGE_MICROS 40000
+#define LINK_SETTLE_MICROS 300000
+
+/// @brief 2つのプロセスで共有する記録。時刻はCLOCK_MONOTONIC(us)
+struct LinkShared
+{
+    uint32_t changeCount;
+    uint64_t changeMicros[LINK_CHANGE_MAX];
+    int8_t changePreset[LINK_CHANGE_MAX];
+    uint32_t applyCount;
+    uint64_t applyMicros[LINK_CHANGE_MAX];
+    int8_t applyPreset[LINK_CHANGE_MAX];
+    uint16_t leaderParams[POTS_MAX];
+    uint16_t followerParams[POTS_MAX];
+    int8_t leaderPreset;
+    int8_t followerPreset;
+    // 先導側が止まると追従側は自分のポットに戻るので、それまでの値で比べる
+    volatile bool leaderRunning;
+};
+
+static LinkShared localShared;
+static LinkShared *pShared = &localShared;
+static std::mt19937 rng(1);
+static uint64_t endMicros = 0;
+static bool verbose = false;
+
+static uint64_t monotonicMicros()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// @brief 先導側。制御周期の前にプリセットとポットを動かす
+static void leaderControlTask()
+{
+    static uint64_t nextChange = 0;
+    uint64_t now = monotonicMicros();
+    bool settling = now + LINK_SETTLE_MICROS >= endMicros;
+    if (!settling && now >= nextChange && pShared->changeCount < LINK_CHANGE_MAX)
+    {
+        int8_t index = presetIndex;
+        while (index == presetIndex)
+        {
+            index = rng() % PRESET_TOTAL;
+        }
+        presetIndex = index;
+        setRomBit(presetIndex);
+        setPresetBit(presetIndex);
+        pShared->changeMicros[pShared->changeCount] = now;
+        pShared->changePreset[pShared->changeCount] = index;
+        pShared->changeCount++;
+        nextChange = now + LINK_CHANGE_MICROS;
+        if (verbose)
+        {
+            printf("leader   %10llu preset %d\n", (unsigned long long)now, index);
+        }
+    }
+    if (!settling)
+    {
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            int value = sim::analogPins[Board::POT0 + i] + (int)(rng() % 65) - 32;
+            sim::analogPins[Board::POT0 + i] = constrain(value, 0, POTS_MAX_VALUE);
+        }
+    }
+
+    controlTask();
+    pShared->leaderPreset = presetIndex;
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        pShared->leaderParams[i] = paramValues[i];
+    }
+}
+
+/// @brief 追従側。制御周期の後にプリセットが変わっていれば記録する
+static void followerControlTask()
+{
+    int8_t last = presetIndex;
+    controlTask();
+    if (presetIndex != last && pShared->applyCount < LINK_CHANGE_MAX)
+    {
+        uint64_t now = monotonicMicros();
+        pShared->applyMicros[pShared->applyCount] = now;
+        pShared->applyPreset[pShared->applyCount] = presetIndex;
+        pShared->applyCount++;
+        if (verbose)
+        {
+            printf("follower %10llu preset %d\n", (unsigned long long)now, presetIndex);
+        }
+    }
+    if (!pShared->leaderRunning)
+    {
+        return;
+    }
+    pShared->followerPreset = presetIndex;
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        pShared->followerParams[i] = paramValues[i];
+    }
+}
+
+/// @brief 1台分を決めた時間だけ動かす
+static void runUnit(int fd, byte mode, uint32_t seconds)
+{
+    sim::realTime = true;
+    // パラメタの初期値(0)から拾えるようにポットも0から動かす
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        sim::analogPins[Board::POT0 + i] = 0;
+    }
+    Serial1.fd = fd;
+    linkMode = mode;
+    linkPots = 1;
+    tasks[TASK_CONTROL].func = mode == LINK_MODE_LEADER ? leaderControlTask : followerControlTask;
+
+    // 表示のタスクは回さない
+    setup();
+    setup1();
+    endMicros = monotonicMicros() + (uint64_t)seconds * 1000000;
+    while (monotonicMicros() < endMicros)
+    {
+        loop();
+        // 2つのプロセスが1つのCPUでも交互に動けるように
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+static bool setRaw(int fd)
+{
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        return false;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B500000);
+    cfsetospeed(&tio, B500000);
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+/// @brief 組で動かした結果。変えたプリセットを順に追従側の記録から探す
+static int report()
+{
+    uint32_t found = 0;
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    uint32_t apply = 0;
+    for (uint32_t i = 0; i < pShared->changeCount; ++i)
+    {
+        while (apply < pShared->applyCount &&
+               (pShared->applyPreset[apply] != pShared->changePreset[i] ||
+                pShared->applyMicros[apply] < pShared->changeMicros[i]))
+        {
+            apply++;
+        }
+        if (apply >= pShared->applyCount)
+        {
+            break;
+        }
+        uint64_t latency = pShared->applyMicros[apply] - pShared->changeMicros[i];
+        total += latency;
+        worst = max(worst, latency);
+        found++;
+        apply++;
+    }
+
+    printf("presets: %u changed, %u applied by follower\n", pShared->changeCount, found);
+    if (found > 0)
+    {
+        printf("latency: avg %.0f us, max %llu us (control tick %u us)\n",
+               (double)total / found, (unsigned long long)worst, tasks[TASK_CONTROL].period);
+    }
+
+    bool paramsMatch = true;
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        uint16_t a = pShared->leaderParams[i];
+        uint16_t b = pShared->followerParams[i];
+        uint16_t diff = a > b ? a - b : b - a;
+        printf("param%d: leader %4u follower %4u\n", i, a, b);
+        // 追従側も自分の不感帯を通すので、その分の違いは残りうる
+        paramsMatch = paramsMatch && diff <= deadbands[pShared->leaderPreset][i];
+    }
+    bool ok = found == pShared->changeCount && pShared->changeCount > 0 &&
+              pShared->leaderPreset == pShared->followerPreset && paramsMatch;
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: link [seconds] | link leader TTY [seconds] | link follower TTY [seconds]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string role = argc > 1 && !isdigit(argv[1][0]) ? argv[1] : "";
+    if (role == "leader" || role == "follower")
+    {
+        if (argc < 3)
+        {
+            usage();
+            return 2;
+        }
+        int fd = open(argv[2], O_RDWR | O_NOCTTY);
+        if (fd < 0 || !setRaw(fd))
+        {
+            perror(argv[2]);
+            return 2;
+        }
+        verbose = true;
+        runUnit(fd, role == "leader" ? LINK_MODE_LEADER : LINK_MODE_FOLLOWER, argc > 3 ? atoi(argv[3]) : 10);
+        printf("%s: preset %d, %u frames received\n", role.c_str(), presetIndex, unitLink.getRxCount());
+        return 0;
+    }
+    if (!role.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    uint32_t seconds = argc > 1 ? max(atoi(argv[1]), 1) : 3;
+    void *pMap = mmap(NULL, sizeof(LinkShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pMap == MAP_FAILED)
+    {
+        perror("mmap");
+        return 2;
+    }
+    pShared = (LinkShared *)pMap;
+    memset(pShared, 0, sizeof(LinkShared));
+
+    int leaderFd, followerFd;
+    if (openpty(&leaderFd, &followerFd, NULL, NULL, NULL) != 0 || !setRaw(leaderFd) || !setRaw(followerFd))
+    {
+        perror("openpty");
+        return 2;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return 2;
+    }
+    if (pid == 0)
+    {
+        close(leaderFd);
+        // 先導側より少し長く動かし、最後の変更を受け取れるようにする
+        runUnit(followerFd, LINK_MODE_FOLLOWER, seconds + 1);
+        _exit(0);
+    }
+
+    close(followerFd);
+    pShared->leaderRunning = true;
+    runUnit(leaderFd, LINK_MODE_LEADER, seconds);
+    pShared->leaderRunning = false;
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return report();
+}
@@ -0,0 +1,359 @@
+/*!
+ * Host OLED frame dump
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 表示タスクをスタブのSSD1306バッファに描かせ、画面ごとのフレームを画像に書き出す
+ * 基準画像と比べれば描画の最適化で見た目が変わっていないかを実機なしで確かめられる
+ *   oled [--out DIR] [--png] [--update DIR] [--check DIR] [--frames N]
+ *     --out DIR     画像の出力先(既定 oled_frames)
+ *     --png         PBMに加えてPNGも書く
+ *     --update DIR  基準画像(PBM)をDIRに書く
+ *     --check DIR   DIRの基準画像と比べ、違えば差分画像を出力先に書いて終了コード1
+ *     --frames N    時間計測のフレーム数(既定200)
+ * 画面ごとに1フレームの描画時間(平均/最大)を表示する。数値はホストのもの
+ * U8g2のcsrcがあれば本物のU8g2で描く。なければ簡易版のスタブで描くので、文字の形は実機と違う
+ * 基準画像は描画系ごとに tools/host/golden/u8g2 と tools/host/golden/stub に置き、ctestのoledで比べる
+ */
+
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "../../app/ReverIsland/src/main.cpp"
+
+#define FRAME_WIDTH 128
+#define FRAME_HEIGHT 64
+
+typedef std::vector<byte> Frame;
+
+/// @brief CV入力の疑似波形。ADCの変換時間ぶん時計を進める
+static uint16_t cvWave(byte pin)
+{
+    (void)pin;
+    sim::nowMicros = sim::nowMicros + 2;
+    double t = sim::nowMicros * 1e-6;
+    // 50Hzの正弦に3倍音を少し混ぜる
+    double value = sin(2 * M_PI * 50 * t) * 0.35 + sin(2 * M_PI * 150 * t) * 0.1;
+    return (uint16_t)(2048 + value * 2047);
+}
+
+static Frame capture()
+{
+    Frame frame(FRAME_WIDTH * FRAME_HEIGHT);
+    for (int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+        for (int x = 0; x < FRAME_WIDTH; ++x)
+        {
+            frame[y * FRAME_WIDTH + x] = u8g2.getPixel(x, y);
+        }
+    }
+    return frame;
+}
+
+static bool writePbm(const std::string &path, const Frame &frame)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    fprintf(fp, "P4\n%d %d\n", FRAME_WIDTH, FRAME_HEIGHT);
+    for (int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+        for (int x = 0; x < FRAME_WIDTH; x += 8)
+        {
+            byte bits = 0;
+            for (int b = 0; b < 8; ++b)
+            {
+                bits |= frame[y * FRAME_WIDTH + x + b] << (7 - b);
+            }
+            fputc(bits, fp);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool readPbm(const std::string &path, Frame &frame)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    int width = 0;
+    int height = 0;
+    bool result = fscanf(fp, "P4 %d %d", &width, &height) == 2 && width == FRAME_WIDTH && height == FRAME_HEIGHT;
+    // ヘッダ後の空白1文字
+    result = result && fgetc(fp) != EOF;
+    frame.assign(FRAME_WIDTH * FRAME_HEIGHT, 0);
+    for (int y = 0; result && y < FRAME_HEIGHT; ++y)
+    {
+        for (int x = 0; result && x < FRAME_WIDTH; x += 8)
+        {
+            int bits = fgetc(fp);
+            result = bits != EOF;
+            for (int b = 0; result && b < 8; ++b)
+            {
+                frame[y * FRAME_WIDTH + x + b] = (bits >> (7 - b)) & 1;
+            }
+        }
+    }
+    fclose(fp);
+    return result;
+}
+
+static uint32_t crc32(const byte *pData, size_t length, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+    {
+        crc ^= pData[i];
+        for (int k = 0; k < 8; ++k)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void putBe(std::vector<byte> &out, uint32_t value)
+{
+    for (int i = 3; i >= 0; --i)
+    {
+        out.push_back((value >> (i * 8)) & 0xFF);
+    }
+}
+
+static void pngChunk(std::vector<byte> &out, const char *pType, const std::vector<byte> &data)
+{
+    putBe(out, data.size());
+    std::vector<byte> body(pType, pType + 4);
+    body.insert(body.end(), data.begin(), data.end());
+    out.insert(out.end(), body.begin(), body.end());
+    putBe(out, crc32(body.data(), body.size()));
+}
+
+/// @brief 1bitグレースケールPNG。圧縮なし(deflateの無圧縮ブロック)で書く
+static bool writePng(const std::string &path, const Frame &frame)
+{
+    // 行頭のフィルタ種別(0)+ 16バイト。OLEDの点灯を白にする
+    std::vector<byte> raw;
+    for (int y = 0; y < FRAME_HEIGHT; ++y)
+    {
+        raw.push_back(0);
+        for (int x = 0; x < FRAME_WIDTH; x += 8)
+        {
+            byte bits = 0;
+            for (int b = 0; b < 8; ++b)
+            {
+                bits |= frame[y * FRAME_WIDTH + x + b] << (7 - b);
+            }
+            raw.push_back(bits);
+        }
+    }
+
+    std::vector<byte> zlib = {0x78, 0x01, 0x01};
+    zlib.push_back(raw.size() & 0xFF);
+    zlib.push_back(raw.size() >> 8);
+    zlib.push_back(~raw.size() & 0xFF);
+    zlib.push_back((~raw.size() >> 8) & 0xFF);
+    zlib.insert(zlib.end(), raw.begin(), raw.end());
+    uint32_t a = 1, b = 0;
+    for (byte value : raw)
+    {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBe(zlib, (b << 16) | a);
+
+    std::vector<byte> header;
+    putBe(header, FRAME_WIDTH);
+    putBe(header, FRAME_HEIGHT);
+    header.insert(header.end(), {1, 0, 0, 0, 0});
+
+    std::vector<byte> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    pngChunk(out, "IHDR", header);
+    pngChunk(out, "IDAT", zlib);
+    pngChunk(out, "IEND", std::vector<byte>());
+
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == NULL)
+    {
+        return false;
+    }
+    bool result = fwrite(out.data(), 1, out.size(), fp) == out.size();
+    fclose(fp);
+    return result;
+}
+
+struct Scene
+{
+    std::string name;
+    byte mode;
+    byte index;
+    byte scopeDisp;
+};
+
+/// @brief 画面を用意する。表示タスクが参照する状態だけを設定する
+static void setupScene(const Scene &scene)
+{
+    sim::nowMicros = 0;
+    dispMode = scene.mode;
+    if (scene.mode == 0)
+    {
+        presetIndex = scene.index;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            potValues[i] = (scene.index * 97 + i * 1365) & POTS_MAX_VALUE;
+            lastPot[i] = map(potValues[i], 0, POTS_MAX_VALUE, 0, 127);
+        }
+    }
+    else if (scene.mode == 1)
+    {
+        scopeDispMode = scene.scopeDisp;
+        // 深いキャプチャはindexが0なら全体、1なら中ほどを拡大
+        ezOscillo.setDeepView(scene.index == 0 ? DATA_MAX_VALUE : 1200, 2048);
+        ezOscillo.arm();
+    }
+    else
+    {
+        settingIndex = scene.index;
+        for (byte i = 0; i < POTS_MAX; ++i)
+        {
+            potSettingValues[i] = (scene.index * 311 + i * 1024) & POTS_MAX_VALUE;
+        }
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: oled [--out DIR] [--png] [--update DIR] [--check DIR] [--frames N]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string outDir = "oled_frames";
+    std::string updateDir;
+    std::string checkDir;
+    bool png = false;
+    int frames = 200;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            outDir = argv[++i];
+        else if (arg == "--update" && hasValue)
+            updateDir = argv[++i];
+        else if (arg == "--check" && hasValue)
+            checkDir = argv[++i];
+        else if (arg == "--frames" && hasValue)
+            frames = max(1, atoi(argv[++i]));
+        else if (arg == "--png")
+            png = true;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    mkdir(outDir.c_str(), 0755);
+    if (!updateDir.empty())
+    {
+        mkdir(updateDir.c_str(), 0755);
+    }
+
+    sim::realTime = false;
+    sim::analogSource = cvWave;
+    initController();
+    initOLED();
+
+    std::vector<Scene> scenes;
+    for (byte i = 0; i < PRESET_TOTAL; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "preset_%02d", i);
+        scenes.push_back({name, 0, i, 0});
+    }
+    const char *scopeNames[] = {"scope_normal", "scope_average", "scope_persist", "scope_deep"};
+    for (byte i = 0; i < 4; ++i)
+    {
+        scenes.push_back({scopeNames[i], 1, 0, i});
+    }
+    scenes.push_back({"scope_deep_zoom", 1, 1, DISP_MODE_DEEP});
+    for (byte i = 0; i < EXSETMENU_MAX; ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "settings_%d", i);
+        scenes.push_back({name, 2, i, 0});
+    }
+
+    int mismatches = 0;
+    printf("%-20s %12s %12s %8s\n", "screen", "avg us", "max us", "diff px");
+    for (const Scene &scene : scenes)
+    {
+        setupScene(scene);
+
+        // 画像は最初のframes回を描いた後のもの。スコープは平均や残光が溜まった状態になる
+        double total = 0;
+        double worst = 0;
+        for (int f = 0; f < frames; ++f)
+        {
+            auto start = std::chrono::steady_clock::now();
+            displayTask();
+            auto end = std::chrono::steady_clock::now();
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            total += us;
+            worst = max(worst, us);
+        }
+
+        Frame frame = capture();
+        std::string base = outDir + "/" + scene.name;
+        writePbm(base + ".pbm", frame);
+        if (png)
+        {
+            writePng(base + ".png", frame);
+        }
+        if (!updateDir.empty())
+        {
+            writePbm(updateDir + "/" + scene.name + ".pbm", frame);
+        }
+
+        char diffText[16] = "-";
+        if (!checkDir.empty())
+        {
+            Frame golden;
+            if (!readPbm(checkDir + "/" + scene.name + ".pbm", golden))
+            {
+                snprintf(diffText, sizeof(diffText), "missing");
+                mismatches++;
+            }
+            else
+            {
+                Frame diff(frame.size());
+                int count = 0;
+                for (size_t i = 0; i < frame.size(); ++i)
+                {
+                    diff[i] = frame[i] ^ golden[i];
+                    count += diff[i];
+                }
+                snprintf(diffText, sizeof(diffText), "%d", count);
+                if (count > 0)
+                {
+                    writePbm(base + "_diff.pbm", diff);
+                    mismatches++;
+                }
+            }
+        }
+        printf("%-20s %12.1f %12.1f %8s\n", scene.name.c_str(), total / frames, worst, diffText);
+    }
+
+    if (!checkDir.empty())
+    {
+        printf("%d of %zu screens differ from %s\n", mismatches, scenes.size(), checkDir.c_str());
+    }
+    return mismatches > 0 ? 1 : 0;
+}
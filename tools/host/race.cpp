@@ -0,0 +1,234 @@
+/*!
+ * Host two-core race harness
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 実機のCPU 1(操作系)とCPU 2(表示系)を2つのスレッドで同時に動かし、
+ * コア間で共有する状態の競合を探す。ThreadSanitizer付きでビルドすると
+ * 同期のないアクセスを報告する
+ *   cmake -S tools/host -B build-tsan -DHOST_TSAN=ON && cmake --build build-tsan --target race
+ *   race [seconds] [seed]
+ * 入力はランダムに動かし、スタブのI/Oごとにランダムな待ちを入れてタイミングを揺らす
+ * 起動も実機と同じく両方のコアで同時に始め、初期化の順番に頼る箇所を探す
+ * 表示1回ごとに共有状態の範囲と描画結果を検査し、違反があれば終了コード1
+ */
+
+#include <atomic>
+#include <random>
+#include <ctime>
+#include "../../app/ReverIsland/src/main.cpp"
+
+static std::atomic<bool> running(true);
+static std::atomic<byte> startCount(0);
+static std::atomic<uint32_t> violationCount(0);
+static std::atomic<uint32_t> controlRuns(0);
+static std::atomic<uint32_t> displayRuns(0);
+static uint32_t seed = 1;
+
+// アナログ入力は表示側(スコープ)からも読むので原子的に持つ
+static std::atomic<uint16_t> analogInputs[SIM_PIN_MAX];
+
+static thread_local std::mt19937 rng;
+
+static uint16_t raceAnalogSource(byte pin)
+{
+    return analogInputs[pin].load(std::memory_order_relaxed);
+}
+
+/// @brief 大半は素通り、残りでyield/短いスピン/短いスリープ
+static void racePerturb()
+{
+    uint32_t r = rng() & 0x3FF;
+    if (r < 640)
+    {
+        return;
+    }
+    else if (r < 960)
+    {
+        for (volatile uint32_t i = rng() & 0x3FF; i > 0; i = i - 1)
+        {
+        }
+    }
+    else if (r < 1020)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(rng() & 0x3F));
+    }
+}
+
+/// @brief 両方のスレッドが揃ってから同時に始める(リセット解除の代わり)
+static void waitStart()
+{
+    startCount.fetch_add(1);
+    while (startCount.load() < 2)
+    {
+        std::this_thread::yield();
+    }
+}
+
+static void violation(const char *what, long value)
+{
+    if (violationCount.fetch_add(1) < 20)
+    {
+        fprintf(stderr, "violation: %s = %ld\n", what, value);
+    }
+}
+
+/// @brief ボタンはクリックと長押しをランダムな間隔で。ポットはランダムウォーク
+static void randomizeInputs()
+{
+    static const byte buttonPins[2] = {Board::SW0, Board::SW1};
+    static const byte potPins[POTS_MAX] = {Board::POT0, Board::POT1, Board::POT2};
+    static uint32_t buttonUntil = 0;
+    static byte buttonPressed = 0xFF;
+
+    uint32_t now = millis();
+    if ((int32_t)(now - buttonUntil) >= 0)
+    {
+        if (buttonPressed != 0xFF)
+        {
+            sim::digitalPins[buttonPins[buttonPressed]] = HIGH;
+            buttonPressed = 0xFF;
+            buttonUntil = now + 20 + rng() % 300;
+        }
+        else
+        {
+            buttonPressed = rng() & 1;
+            sim::digitalPins[buttonPins[buttonPressed]] = LOW;
+            // 4回に1回は長押し
+            buttonUntil = now + ((rng() & 3) == 0 ? 600 + rng() % 400 : 30 + rng() % 100);
+        }
+    }
+
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        int value = analogInputs[potPins[i]].load(std::memory_order_relaxed);
+        value = (rng() & 0x3FF) == 0 ? rng() & POTS_MAX_VALUE : value + (int)(rng() % 65) - 32;
+        analogInputs[potPins[i]].store(constrain(value, 0, POTS_MAX_VALUE), std::memory_order_relaxed);
+    }
+    analogInputs[Board::CV].store(rng() & POTS_MAX_VALUE, std::memory_order_relaxed);
+}
+
+static void raceControlTask()
+{
+    randomizeInputs();
+    controlTask();
+    controlRuns.fetch_add(1, std::memory_order_relaxed);
+}
+
+/// @brief 表示系が読む共有状態の範囲と、描画結果を確かめる
+static void raceDisplayTask()
+{
+    int8_t index = presetIndex;
+    byte mode = dispMode;
+    uint32_t sends = u8g2.getSendCount();
+
+    displayTask();
+    displayRuns.fetch_add(1, std::memory_order_relaxed);
+
+    if (index < 0 || index >= PRESET_TOTAL)
+    {
+        violation("presetIndex", index);
+    }
+    if (mode > 2)
+    {
+        violation("dispMode", mode);
+    }
+    if (settingIndex >= EXSETMENU_MAX)
+    {
+        violation("settingIndex", settingIndex);
+    }
+    if (assignCVMode > CV_MODE_PRESET)
+    {
+        violation("assignCVMode", assignCVMode);
+    }
+    if (assignCV2Pot >= POTS_MAX)
+    {
+        violation("assignCV2Pot", assignCV2Pot);
+    }
+    for (byte i = 0; i < POTS_MAX; ++i)
+    {
+        if (potValues[i] > POTS_MAX_VALUE)
+        {
+            violation("potValues", potValues[i]);
+        }
+        if (potSettingValues[i] > POTS_MAX_VALUE)
+        {
+            violation("potSettingValues", potSettingValues[i]);
+        }
+    }
+
+    // プリセットと設定の画面は毎回全体を描き直して送る。空の画面は描画の途中で壊れたもの
+    if (mode != 1)
+    {
+        if (u8g2.getSendCount() == sends)
+        {
+            violation("frame not sent, mode", mode);
+        }
+
+        const byte *pBuff = u8g2.getBufferPtr();
+        uint32_t lit = 0;
+        for (uint16_t i = 0; i < u8g2.getBufferTileWidth() * u8g2.getBufferTileHeight() * 8; ++i)
+        {
+            lit += pBuff[i] != 0;
+        }
+        if (lit == 0)
+        {
+            violation("blank frame, mode", mode);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = argc > 1 ? atoi(argv[1]) : 10;
+    seed = argc > 2 ? atoi(argv[2]) : (uint32_t)time(NULL);
+    printf("race: %u s, seed %u\n", seconds, seed);
+
+    for (byte i = 0; i < SIM_PIN_MAX; ++i)
+    {
+        analogInputs[i].store(2048);
+    }
+    sim::realTime = true;
+    sim::analogSource = raceAnalogSource;
+    sim::perturb = racePerturb;
+
+    // 表示を速めて交錯の回数を増やす
+    tasks[TASK_CONTROL].func = raceControlTask;
+    tasks[TASK_DISPLAY].func = raceDisplayTask;
+    tasks[TASK_DISPLAY].period = 4000;
+    tasks[TASK_DISPLAY].deadline = 4000;
+
+    // 実機と同じくリセット直後から両方のコアを同時に走らせ、setupとsetup1の順番も揺らす
+    std::thread core0([] {
+        rng.seed(seed);
+        waitStart();
+        setup();
+        while (running.load(std::memory_order_relaxed))
+        {
+            loop();
+        }
+    });
+    std::thread core1([] {
+        rng.seed(seed * 2654435761u + 1);
+        waitStart();
+        setup1();
+        while (running.load(std::memory_order_relaxed))
+        {
+            loop1();
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    core0.join();
+    core1.join();
+
+    printf("control %u runs, display %u runs, %u violations\n",
+           controlRuns.load(), displayRuns.load(), violationCount.load());
+    return violationCount.load() > 0 ? 1 : 0;
+}
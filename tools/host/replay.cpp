@@ -0,0 +1,90 @@
+/*!
+ * Host input trace replay
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 実機で記録した操作入力(tools/trace.py record)をホストで再生し、
+ * 制御周期ごとのPWM出力とプリセット状態をCSVで出力する
+ *   replay input.trc [output.csv]
+ */
+
+#include <vector>
+#include "../../app/ReverIsland/src/main.cpp"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: replay input.trc [output.csv]\n");
+        return 2;
+    }
+
+    FILE *fin = fopen(argv[1], "rb");
+    if (fin == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 2;
+    }
+    std::vector<TraceEvent> events;
+    TraceEvent event;
+    while (fread(&event, sizeof(TraceEvent), 1, fin) == 1)
+    {
+        events.push_back(event);
+    }
+    fclose(fin);
+
+    FILE *fout = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (fout == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[2]);
+        return 2;
+    }
+
+    sim::realTime = false;
+    initController();
+    initPresets(&u8g2);
+    initSettings(&u8g2);
+
+    fprintf(fout, "micros,pwm0,pwm1,pwm2,preset_index,disp_mode\n");
+    inputTrace.startReplay();
+    size_t pos = 0;
+    uint32_t ticks = 0;
+    while (inputTrace.isReplaying())
+    {
+        // 実機と同じく、空きがある分だけフレーム単位で流し込む
+        while (pos < events.size() && inputTrace.getFree() >= TRACE_EVENTS_PER_FRAME)
+        {
+            size_t count = min(events.size() - pos, (size_t)TRACE_EVENTS_PER_FRAME);
+            inputTrace.feed(&events[pos], count);
+            pos += count;
+        }
+
+        if (!updateTrace())
+        {
+            // 終端がないトレース
+            break;
+        }
+        if (!inputTrace.isReplaying())
+        {
+            break;
+        }
+
+        updateController();
+        ticks++;
+        fprintf(fout, "%u,%u,%u,%u,%d,%d\n",
+                inputTrace.getClockMicros(),
+                sim::pwmLevels[potSlices[0]][potChs[0]],
+                sim::pwmLevels[potSlices[1]][potChs[1]],
+                sim::pwmLevels[potSlices[2]][potChs[2]],
+                presetIndex, dispMode);
+    }
+
+    if (fout != stdout)
+    {
+        fclose(fout);
+    }
+
+    fprintf(stderr, "%u ticks replayed%s\n", ticks, inputTrace.hasError() ? ", trace mismatch" : "");
+    return inputTrace.hasError() ? 1 : 0;
+}
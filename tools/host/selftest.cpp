@@ -0,0 +1,236 @@
+/*!
+ * Host self test
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * 実機で起こしにくい境界の場合をスタブ環境で確かめる
+ *   selftest
+ * 失敗した項目を表示し、1つでもあれば終了コード1
+ */
+
+#include <vector>
+#include "../../app/ReverIsland/src/main.cpp"
+
+static uint32_t failCount = 0;
+
+static void check(bool ok, const char *what, long value)
+{
+    if (!ok)
+    {
+        failCount++;
+        printf("FAILED: %s (%ld)\n", what, value);
+    }
+}
+
+/// @brief 自動操作のイベントを1フレームにして読み込ませる
+static bool loadAutomation(const AutomationEvent *pEvents, byte count)
+{
+    byte payload[FRAME_PAYLOAD_MAX];
+    payload[0] = 0;
+    payload[1] = 0;
+    memcpy(&payload[2], pEvents, count * sizeof(AutomationEvent));
+    return automation.load(payload, 2 + count * sizeof(AutomationEvent));
+}
+
+/// @brief 制御周期の時刻を進めながら自動操作を再生する
+static void runAutomation(uint32_t fromMicros, uint32_t toMicros)
+{
+    for (uint32_t t = fromMicros; t <= toMicros; t += 1000)
+    {
+        sim::nowMicros = t;
+        updateAutomation();
+        updatePresetsValues();
+    }
+}
+
+/// @brief 最後のイベントがランプの途中で終わっても目標値まで進む
+static void testAutomationRampAtEnd()
+{
+    AutomationEvent events[] = {
+        {0, AUTO_EVENT_POT, 0, 3000, 2000},
+    };
+    check(loadAutomation(events, 1), "automation load", 0);
+
+    runAutomation(0, 0);
+    automation.start(0);
+    runAutomation(0, 1000000);
+    check(automation.isPlaying(), "automation playing during ramp", 0);
+    uint16_t half = automation.getPotValue(0);
+    check(half > 1000 && half < 2000, "automation ramp midpoint", half);
+
+    runAutomation(1001000, 3000000);
+    check(!automation.isPlaying(), "automation stops after ramp", 1);
+    check(automation.getPotValue(0) == 3000, "automation ramp end value", automation.getPotValue(0));
+    uint16_t diff = paramValues[0] > 3000 ? paramValues[0] - 3000 : 3000 - paramValues[0];
+    check(diff <= deadbands[presetIndex][0], "param follows ramp end", paramValues[0]);
+    automation.stop();
+}
+
+/// @brief 範囲外のプリセット番号は転送時に断り、読み込み途中の分も残さない
+static void testAutomationPresetRange()
+{
+    AutomationEvent events[] = {
+        {0, AUTO_EVENT_PRESET, 0, 1, 0},
+        {1000, AUTO_EVENT_PRESET, 0, 200, 0},
+    };
+    check(!loadAutomation(events, 2), "automation rejects preset 200", 200);
+    check(automation.getCount() == 0, "automation cleared after reject", automation.getCount());
+
+    events[1].value = PRESET_TOTAL - 1;
+    check(loadAutomation(events, 2), "automation accepts last preset", PRESET_TOTAL - 1);
+    automation.clear();
+}
+
+/// @brief レジスタを見られるようにしたVM
+class TestVM : public ControlVM<1>
+{
+public:
+    int32_t getReg(byte index)
+    {
+        return _regs[index];
+    }
+};
+
+/// @brief 算術のあふれと最小値/-1の割り算は折り返す(未定義動作や例外にならない)
+static void testControlVMOverflow()
+{
+    static const VMInstruction code[] = {
+        {VM_OP_LDI, 0, 1, 0},
+        {VM_OP_LDI, 1, 31, 0},
+        {VM_OP_SHL, 2, 0, 1},          // r2 = INT32_MIN
+        {VM_OP_LDI, 3, 0xFF, 0xFF},    // r3 = -1
+        {VM_OP_DIV, 4, 2, 3},
+        {VM_OP_ADD, 5, 2, 3},
+        {VM_OP_SUB, 6, 2, 0},
+        {VM_OP_MUL, 7, 2, 3},
+        {VM_OP_NEG, 8, 2, 0},
+        {VM_OP_ABS, 9, 2, 0},
+        {VM_OP_DIV, 10, 2, 11},        // r11 = 0
+        {VM_OP_END, 0, 0, 0},
+    };
+    byte payload[FRAME_PAYLOAD_MAX];
+    payload[0] = 0;
+    payload[1] = 0;
+    payload[2] = 1;
+    memcpy(&payload[VM_FRAME_HEADER], code, sizeof(code));
+
+    TestVM vm;
+    byte slot, errorPc;
+    byte result = vm.load(payload, VM_FRAME_HEADER + sizeof(code), slot, errorPc);
+    check(result == VM_LOAD_OK, "vm load", result);
+
+    int32_t inputs[VM_IN_MAX] = {0};
+    int32_t outputs[VM_OUT_MAX];
+    vm.select(0);
+    vm.run(inputs, outputs);
+    check(vm.getReg(2) == INT32_MIN, "vm shl to INT32_MIN", vm.getReg(2));
+    check(vm.getReg(4) == INT32_MIN, "vm INT32_MIN / -1", vm.getReg(4));
+    check(vm.getReg(5) == INT32_MAX, "vm INT32_MIN + -1", vm.getReg(5));
+    check(vm.getReg(6) == INT32_MAX, "vm INT32_MIN - 1", vm.getReg(6));
+    check(vm.getReg(7) == INT32_MIN, "vm INT32_MIN * -1", vm.getReg(7));
+    check(vm.getReg(8) == INT32_MIN, "vm -INT32_MIN", vm.getReg(8));
+    check(vm.getReg(9) == INT32_MIN, "vm |INT32_MIN|", vm.getReg(9));
+    check(vm.getReg(10) == 0, "vm divide by zero", vm.getReg(10));
+}
+
+/// @brief ラベルのキャッシュは下の絵やフォントのモードによらずdrawStrと同じ結果になる
+static void testLabelCacheMatchesDrawStr()
+{
+    static byte expected[128 * 64 / 8];
+    u8g2.setFont(u8g2_font_6x13_tf);
+    for (byte mode = 0; mode < 2; ++mode)
+    {
+        u8g2.setFontMode(mode);
+        LabelCache cache;
+        cache.init(&u8g2);
+        // 2回目は転写になる。下の三角形は毎回動かす
+        for (byte pass = 0; pass < 3; ++pass)
+        {
+            u8g2.clearBuffer();
+            u8g2.drawTriangle(10 + pass * 7, 20, 20 + pass * 7, 14, 30 + pass * 7, 20);
+            u8g2.drawStr(4, 16, "Reverb Mix");
+            memcpy(expected, u8g2.getBufferPtr(), sizeof(expected));
+
+            u8g2.clearBuffer();
+            u8g2.drawTriangle(10 + pass * 7, 20, 20 + pass * 7, 14, 30 + pass * 7, 20);
+            cache.drawStr(4, 16, "Reverb Mix");
+            check(memcmp(expected, u8g2.getBufferPtr(), sizeof(expected)) == 0, "label cache matches drawStr", mode * 10 + pass);
+        }
+    }
+    // 表示タスクの設定に戻す
+    u8g2.setFontMode(1);
+    u8g2.clearBuffer();
+}
+
+/// @brief 書いたバイトをそのまま読み出すUART
+class LoopbackStream : public Stream
+{
+public:
+    using Stream::write;
+    std::vector<byte> data;
+
+    int available() override { return data.size(); }
+    int availableForWrite() override { return 4096; }
+
+    int read() override
+    {
+        if (data.empty())
+        {
+            return -1;
+        }
+        byte value = data.front();
+        data.erase(data.begin());
+        return value;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        data.insert(data.end(), buffer, buffer + size);
+        return size;
+    }
+};
+
+/// @brief 先導側が再起動して連番が戻っても追従側は通知を受ける。送り直しは受けない
+static void testLinkLeaderReboot()
+{
+    LoopbackStream stream;
+    uint16_t values[POTS_MAX] = {0};
+    UnitLink follower;
+    follower.begin(&stream);
+    follower.setMode(LINK_MODE_FOLLOWER, false);
+
+    UnitLink leader;
+    leader.begin(&stream);
+    leader.setMode(LINK_MODE_LEADER, false);
+    leader.publish(3, values, 0);
+    LinkPreset preset = {};
+    check(follower.receive(0, preset) && preset.presetIndex == 3, "link first preset", preset.presetIndex);
+
+    leader.publish(3, values, LINK_HEARTBEAT_MICROS);
+    check(!follower.receive(LINK_HEARTBEAT_MICROS, preset), "link ignores heartbeat", 0);
+
+    // 再起動した先導側は連番1から送り直す
+    UnitLink rebooted;
+    rebooted.begin(&stream);
+    rebooted.setMode(LINK_MODE_LEADER, false);
+    rebooted.publish(5, values, 0);
+    preset = {};
+    check(follower.receive(0, preset) && preset.presetIndex == 5, "link preset after leader reboot", preset.presetIndex);
+}
+
+int main()
+{
+    sim::realTime = false;
+    initController();
+    initOLED();
+
+    testAutomationRampAtEnd();
+    testAutomationPresetRange();
+    testControlVMOverflow();
+    testLinkLeaderReboot();
+    testLabelCacheMatchesDrawStr();
+
+    printf("%s\n", failCount == 0 ? "ok" : "FAILED");
+    return failCount == 0 ? 0 : 1;
+}
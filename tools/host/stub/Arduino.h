@@ -0,0 +1,233 @@
+/*!
+ * Arduino stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+typedef uint8_t byte;
+typedef unsigned int uint;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define A0 26
+#define A1 27
+#define A2 28
+#define A3 29
+
+#define SIM_PIN_MAX 30
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+template <class T, class L>
+auto min(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+    return (b < a) ? b : a;
+}
+
+template <class T, class L>
+auto max(const T &a, const L &b) -> decltype((b < a) ? b : a)
+{
+    return (a < b) ? b : a;
+}
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/// @brief 疑似ハードウェア状態。ホスト側から値を入れて使う
+namespace sim
+{
+    inline volatile uint16_t analogPins[SIM_PIN_MAX] = {0};
+    inline volatile byte digitalPins[SIM_PIN_MAX] = {0};
+    inline volatile byte pinModes[SIM_PIN_MAX] = {0};
+    inline volatile uint32_t digitalWriteCount = 0;
+    /// @brief trueならmicros/millisは実時間、falseならnowMicrosを返す
+    inline bool realTime = true;
+    inline volatile uint32_t nowMicros = 0;
+    /// @brief 設定するとanalogReadはこの関数の値を返す(波形の入力用)
+    inline uint16_t (*analogSource)(byte pin) = NULL;
+    /// @brief 設定するとI/Oのたびに呼ばれる(スレッドの実行タイミングを揺らす用)
+    inline void (*perturb)() = NULL;
+
+    inline void perturbPoint()
+    {
+        if (perturb != NULL)
+        {
+            perturb();
+        }
+    }
+
+    inline uint32_t realMicros()
+    {
+        static const auto start = std::chrono::steady_clock::now();
+        return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+}
+
+inline void pinMode(byte pin, byte mode)
+{
+    sim::pinModes[pin] = mode;
+    if (mode == INPUT_PULLUP)
+    {
+        sim::digitalPins[pin] = HIGH;
+    }
+}
+
+inline void digitalWrite(byte pin, byte value)
+{
+    sim::digitalPins[pin] = value ? HIGH : LOW;
+    sim::digitalWriteCount = sim::digitalWriteCount + 1;
+}
+
+inline byte digitalRead(byte pin)
+{
+    sim::perturbPoint();
+    return sim::digitalPins[pin];
+}
+
+inline int analogRead(byte pin)
+{
+    sim::perturbPoint();
+    return sim::analogSource != NULL ? sim::analogSource(pin) : sim::analogPins[pin];
+}
+
+inline void analogReadResolution(int bits)
+{
+    (void)bits;
+}
+
+inline unsigned long micros()
+{
+    return sim::realTime ? sim::realMicros() : sim::nowMicros;
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+    if (sim::realTime)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+    else
+    {
+        sim::nowMicros = sim::nowMicros + us;
+    }
+}
+
+inline void delay(unsigned long ms)
+{
+    delayMicroseconds(ms * 1000);
+}
+
+class Stream
+{
+public:
+    virtual ~Stream() {}
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int availableForWrite() { return 0; }
+    virtual size_t write(const uint8_t *buffer, size_t size) { return size; }
+    size_t write(uint8_t value) { return write(&value, 1); }
+    void begin(unsigned long baud) { (void)baud; }
+    void print(const char *str) { write((const uint8_t *)str, strlen(str)); }
+    void print(long value)
+    {
+        char buff[16];
+        snprintf(buff, sizeof(buff), "%ld", value);
+        print(buff);
+    }
+    void println(const char *str = "")
+    {
+        print(str);
+        print("\r\n");
+    }
+    void println(long value)
+    {
+        print(value);
+        println();
+    }
+};
+
+/// @brief ホスト上のSerial。書き込みは捨て、読み出しは空
+class SimSerial : public Stream
+{
+public:
+    int availableForWrite() override { return 4096; }
+    operator bool() { return true; }
+};
+
+inline SimSerial Serial;
+
+/// @brief ホスト上のSerial1(UART)。fdをつなぐと読み書きする(擬似端末など)
+/// つないでいなければ書き込みは捨て、読み出しは空
+class SimUart : public Stream
+{
+public:
+    using Stream::write;
+    int fd = -1;
+
+    void setTX(byte pin) { (void)pin; }
+    void setRX(byte pin) { (void)pin; }
+    void setFIFOSize(size_t size) { (void)size; }
+
+    int available() override
+    {
+        int count = 0;
+        if (fd < 0 || ioctl(fd, FIONREAD, &count) != 0)
+        {
+            return 0;
+        }
+        return count;
+    }
+
+    int read() override
+    {
+        byte value;
+        return fd >= 0 && ::read(fd, &value, 1) == 1 ? value : -1;
+    }
+
+    int availableForWrite() override { return 4096; }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        size_t written = 0;
+        while (fd >= 0 && written < size)
+        {
+            ssize_t result = ::write(fd, buffer + written, size - written);
+            if (result <= 0)
+            {
+                break;
+            }
+            written += result;
+        }
+        return size;
+    }
+};
+
+inline SimUart Serial1;
@@ -0,0 +1,78 @@
+/*!
+ * EEPROM stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include "Arduino.h"
+
+#define SIM_EEPROM_MAX 4096
+
+namespace sim
+{
+    /// @brief フラッシュ上のEEPROM領域。消去済み(0xFF)から始まる
+    inline byte eeprom[SIM_EEPROM_MAX];
+    inline bool eepromErased = false;
+    inline volatile uint32_t eepromCommitCount = 0;
+}
+
+/// @brief arduino-picoのEEPROM(フラッシュの1セクタをRAMに写して使う)と同じ使い方
+class EEPROMClass
+{
+public:
+    void begin(size_t size)
+    {
+        if (!sim::eepromErased)
+        {
+            memset(sim::eeprom, 0xFF, sizeof(sim::eeprom));
+            sim::eepromErased = true;
+        }
+        _size = min(size, (size_t)SIM_EEPROM_MAX);
+        memcpy(_data, sim::eeprom, _size);
+    }
+
+    byte read(int address)
+    {
+        return _data[address];
+    }
+
+    void write(int address, byte value)
+    {
+        _data[address] = value;
+    }
+
+    template <typename T>
+    T &get(int address, T &t)
+    {
+        memcpy(&t, &_data[address], sizeof(T));
+        return t;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &t)
+    {
+        memcpy(&_data[address], &t, sizeof(T));
+        return t;
+    }
+
+    bool commit()
+    {
+        memcpy(sim::eeprom, _data, _size);
+        sim::eepromCommitCount = sim::eepromCommitCount + 1;
+        return true;
+    }
+
+    size_t length()
+    {
+        return _size;
+    }
+
+protected:
+    byte _data[SIM_EEPROM_MAX];
+    size_t _size = 0;
+};
+
+inline EEPROMClass EEPROM;
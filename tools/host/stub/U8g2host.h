@@ -0,0 +1,119 @@
+/*!
+ * U8g2 wrapper for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ *
+ * U8g2のcsrcをホストでビルドし、SSD1306 128x64のフルバッファに本物と同じ描画をさせる
+ * I2Cとgpioのコールバックは何もしないので、送信はどこにも出ていかない
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <u8g2.h>
+
+class U8G2
+{
+public:
+    U8G2()
+    {
+        _sendCount = 0;
+    }
+
+    /// @brief 実機では初期化と画面消去をI2Cで送るのに約25msかかる。実時間のときだけ待つ
+    void begin()
+    {
+        sim::perturbPoint();
+        if (sim::realTime)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(25000));
+        }
+        // U8G2::begin()と同じ手順
+        u8g2_InitDisplay(&_u8g2);
+        u8g2_ClearDisplay(&_u8g2);
+        u8g2_SetPowerSave(&_u8g2, 0);
+    }
+    void setContrast(byte value) { u8g2_SetContrast(&_u8g2, value); }
+    void setFontPosTop() { u8g2_SetFontPosTop(&_u8g2); }
+    void setFlipMode(byte mode) { u8g2_SetFlipMode(&_u8g2, mode); }
+    void setDrawColor(byte color) { u8g2_SetDrawColor(&_u8g2, color); }
+    void setFontMode(byte mode) { u8g2_SetFontMode(&_u8g2, mode); }
+    u8g2_t *getU8g2() { return &_u8g2; }
+    void setFont(const uint8_t *pFont) { u8g2_SetFont(&_u8g2, pFont); }
+
+    void clearBuffer()
+    {
+        sim::perturbPoint();
+        u8g2_ClearBuffer(&_u8g2);
+    }
+    void sendBuffer()
+    {
+        sim::perturbPoint();
+        u8g2_SendBuffer(&_u8g2);
+        _sendCount++;
+    }
+    uint32_t getSendCount() { return _sendCount; }
+
+    byte *getBufferPtr() { return u8g2_GetBufferPtr(&_u8g2); }
+    byte getBufferTileWidth() { return u8g2_GetBufferTileWidth(&_u8g2); }
+    byte getBufferTileHeight() { return u8g2_GetBufferTileHeight(&_u8g2); }
+    byte getDisplayWidth() { return u8g2_GetDisplayWidth(&_u8g2); }
+    byte getDisplayHeight() { return u8g2_GetDisplayHeight(&_u8g2); }
+
+    /// @brief 表示座標でのピクセル値（回転を戻して読む）
+    byte getPixel(int x, int y)
+    {
+        int width = getBufferTileWidth() * 8;
+        if (_u8g2.cb == U8G2_R2)
+        {
+            x = width - 1 - x;
+            y = getBufferTileHeight() * 8 - 1 - y;
+        }
+        return (getBufferPtr()[(y >> 3) * width + x] >> (y & 7)) & 1;
+    }
+
+    void drawPixel(int x, int y) { u8g2_DrawPixel(&_u8g2, x, y); }
+    void drawHLine(int x, int y, int w) { u8g2_DrawHLine(&_u8g2, x, y, w); }
+    void drawVLine(int x, int y, int h) { u8g2_DrawVLine(&_u8g2, x, y, h); }
+    void drawLine(int x1, int y1, int x2, int y2) { u8g2_DrawLine(&_u8g2, x1, y1, x2, y2); }
+    void drawFrame(int x, int y, int w, int h) { u8g2_DrawFrame(&_u8g2, x, y, w, h); }
+    void drawBox(int x, int y, int w, int h) { u8g2_DrawBox(&_u8g2, x, y, w, h); }
+    void drawTriangle(int x0, int y0, int x1, int y1, int x2, int y2) { u8g2_DrawTriangle(&_u8g2, x0, y0, x1, y1, x2, y2); }
+    void drawXBM(int x, int y, int w, int h, const byte *bitmap) { u8g2_DrawXBM(&_u8g2, x, y, w, h, bitmap); }
+    int getStrWidth(const char *str) { return u8g2_GetStrWidth(&_u8g2, str); }
+    int drawStr(int x, int y, const char *str) { return u8g2_DrawStr(&_u8g2, x, y, str); }
+
+protected:
+    u8g2_t _u8g2;
+    uint32_t _sendCount;
+
+    static uint8_t byteCallback(u8x8_t *pU8x8, uint8_t msg, uint8_t argInt, void *pArg)
+    {
+        (void)pU8x8;
+        (void)msg;
+        (void)argInt;
+        (void)pArg;
+        return 1;
+    }
+
+    static uint8_t gpioCallback(u8x8_t *pU8x8, uint8_t msg, uint8_t argInt, void *pArg)
+    {
+        (void)pU8x8;
+        (void)msg;
+        (void)argInt;
+        (void)pArg;
+        return 1;
+    }
+};
+
+class U8G2_SSD1306_128X64_NONAME_F_HW_I2C : public U8G2
+{
+public:
+    U8G2_SSD1306_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, byte reset = U8X8_PIN_NONE)
+    {
+        (void)reset;
+        // U8g2lib.hの同名クラスと同じセットアップ
+        u8g2_Setup_ssd1306_i2c_128x64_noname_f(&_u8g2, rotation, byteCallback, gpioCallback);
+    }
+};
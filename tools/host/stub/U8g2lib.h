@@ -0,0 +1,361 @@
+/*!
+ * U8g2 stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifdef HOST_U8G2
+// U8g2のcsrcがあれば本物で描く(CMakeのU8G2_CSRC)
+#include "U8g2host.h"
+#else
+
+// 以下はU8g2がないときの簡易版。フォントは全部5x7の仮のもので、実機の表示とは一致しない
+// SSD1306 128x64 フルバッファと同じページ構成のメモリだけに描く
+// バッファはページ(8px)ごとに128バイト、各バイトのLSBが上端
+
+#define U8X8_PIN_NONE 255
+
+struct u8g2_cb_t
+{
+    byte rotation;
+};
+
+struct u8g2_font_decode_t
+{
+    byte is_transparent;
+};
+
+/// @brief u8g2_t のうちファームウェアが参照するメンバ
+struct u8g2_t
+{
+    const u8g2_cb_t *cb;
+    byte draw_color;
+    const void *font;
+    u8g2_font_decode_t font_decode;
+};
+
+inline const u8g2_cb_t u8g2_cb_r0 = {0};
+inline const u8g2_cb_t u8g2_cb_r2 = {2};
+#define U8G2_R0 (&u8g2_cb_r0)
+#define U8G2_R2 (&u8g2_cb_r2)
+
+/// @brief グリフは5x7固定。幅と高さ、太字だけフォントごとに変える
+struct u8g2_font_t
+{
+    byte advance;
+    byte height;
+    byte offsetY;
+    byte bold;
+};
+
+inline const u8g2_font_t u8g2_font_5x8_tf[1] = {{5, 8, 0, 0}};
+inline const u8g2_font_t u8g2_font_6x13_tf[1] = {{6, 13, 3, 0}};
+inline const u8g2_font_t u8g2_font_8x13B_tf[1] = {{8, 13, 3, 1}};
+
+// 0x20-0x7E 5x7 フォント（列ごと、LSBが上）
+inline const byte simFont5x7[95][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01}, {0x3E, 0x41, 0x49, 0x49, 0x7A},
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F},
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x7F, 0x10, 0x28, 0x44, 0x00},
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08},
+};
+
+class U8G2
+{
+public:
+    U8G2(const u8g2_cb_t *rotation = U8G2_R0)
+    {
+        _u8g2.cb = rotation;
+        _u8g2.draw_color = 1;
+        // U8g2と同じく既定はグリフの背景も塗る
+        _u8g2.font_decode.is_transparent = 0;
+        _pFont = u8g2_font_5x8_tf;
+        _u8g2.font = _pFont;
+        _sendCount = 0;
+        memset(_buff, 0, sizeof(_buff));
+    }
+
+    /// @brief 実機では初期化と画面消去をI2Cで送るのに約25msかかる。実時間のときだけ待つ
+    void begin()
+    {
+        sim::perturbPoint();
+        if (sim::realTime)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(25000));
+        }
+    }
+    void setContrast(byte value) { (void)value; }
+    void setFontPosTop() {}
+    void setFlipMode(byte mode) { (void)mode; }
+    void setDrawColor(byte color) { _u8g2.draw_color = color; }
+    void setFontMode(byte mode) { _u8g2.font_decode.is_transparent = mode; }
+    u8g2_t *getU8g2() { return &_u8g2; }
+    void setFont(const u8g2_font_t *pFont)
+    {
+        _pFont = pFont;
+        _u8g2.font = pFont;
+    }
+
+    void clearBuffer()
+    {
+        sim::perturbPoint();
+        memset(_buff, 0, sizeof(_buff));
+    }
+    void sendBuffer()
+    {
+        sim::perturbPoint();
+        _sendCount++;
+    }
+    uint32_t getSendCount() { return _sendCount; }
+
+    byte *getBufferPtr() { return _buff; }
+    byte getBufferTileWidth() { return WIDTH / 8; }
+    byte getBufferTileHeight() { return HEIGHT / 8; }
+    byte getDisplayWidth() { return WIDTH; }
+    byte getDisplayHeight() { return HEIGHT; }
+
+    /// @brief 表示座標でのピクセル値（回転を戻して読む）
+    byte getPixel(int x, int y)
+    {
+        toBuffer(x, y);
+        return (_buff[(y >> 3) * WIDTH + x] >> (y & 7)) & 1;
+    }
+
+    void drawPixel(int x, int y)
+    {
+        if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT)
+        {
+            return;
+        }
+
+        toBuffer(x, y);
+        byte *p = &_buff[(y >> 3) * WIDTH + x];
+        byte mask = 1 << (y & 7);
+        switch (_u8g2.draw_color)
+        {
+        case 0:
+            *p &= ~mask;
+            break;
+        case 1:
+            *p |= mask;
+            break;
+        default:
+            *p ^= mask;
+            break;
+        }
+    }
+
+    void drawHLine(int x, int y, int w)
+    {
+        for (int i = 0; i < w; ++i)
+        {
+            drawPixel(x + i, y);
+        }
+    }
+
+    void drawVLine(int x, int y, int h)
+    {
+        for (int i = 0; i < h; ++i)
+        {
+            drawPixel(x, y + i);
+        }
+    }
+
+    void drawLine(int x1, int y1, int x2, int y2)
+    {
+        int dx = abs(x2 - x1);
+        int dy = -abs(y2 - y1);
+        int sx = x1 < x2 ? 1 : -1;
+        int sy = y1 < y2 ? 1 : -1;
+        int err = dx + dy;
+        while (true)
+        {
+            drawPixel(x1, y1);
+            if (x1 == x2 && y1 == y2)
+            {
+                break;
+            }
+            int e2 = err * 2;
+            if (e2 >= dy)
+            {
+                err += dy;
+                x1 += sx;
+            }
+            if (e2 <= dx)
+            {
+                err += dx;
+                y1 += sy;
+            }
+        }
+    }
+
+    void drawFrame(int x, int y, int w, int h)
+    {
+        drawHLine(x, y, w);
+        drawHLine(x, y + h - 1, w);
+        drawVLine(x, y + 1, h - 2);
+        drawVLine(x + w - 1, y + 1, h - 2);
+    }
+
+    void drawBox(int x, int y, int w, int h)
+    {
+        for (int i = 0; i < h; ++i)
+        {
+            drawHLine(x, y + i, w);
+        }
+    }
+
+    void drawTriangle(int x0, int y0, int x1, int y1, int x2, int y2)
+    {
+        int yMin = min(y0, min(y1, y2));
+        int yMax = max(y0, max(y1, y2));
+        for (int y = yMin; y <= yMax; ++y)
+        {
+            int xl = WIDTH;
+            int xr = -1;
+            edge(x0, y0, x1, y1, y, xl, xr);
+            edge(x1, y1, x2, y2, y, xl, xr);
+            edge(x2, y2, x0, y0, y, xl, xr);
+            if (xl <= xr)
+            {
+                drawHLine(xl, y, xr - xl + 1);
+            }
+        }
+    }
+
+    /// @brief XBM形式（行ごと、LSBが左）のビットマップ描画
+    void drawXBM(int x, int y, int w, int h, const byte *bitmap)
+    {
+        int stride = (w + 7) >> 3;
+        for (int j = 0; j < h; ++j)
+        {
+            for (int i = 0; i < w; ++i)
+            {
+                if ((bitmap[j * stride + (i >> 3)] >> (i & 7)) & 1)
+                {
+                    drawPixel(x + i, y + j);
+                }
+            }
+        }
+    }
+
+    int getStrWidth(const char *str)
+    {
+        return strlen(str) * _pFont->advance;
+    }
+
+    int drawStr(int x, int y, const char *str)
+    {
+        int startX = x;
+        for (; *str != '\0'; ++str)
+        {
+            byte c = *str;
+            if (c >= 0x20 && c <= 0x7E)
+            {
+                drawGlyph(x, y + _pFont->offsetY, simFont5x7[c - 0x20]);
+            }
+            x += _pFont->advance;
+        }
+        return x - startX;
+    }
+
+    static const int WIDTH = 128;
+    static const int HEIGHT = 64;
+
+protected:
+    byte _buff[WIDTH * HEIGHT / 8];
+    u8g2_t _u8g2;
+    const u8g2_font_t *_pFont;
+    uint32_t _sendCount;
+
+    void toBuffer(int &x, int &y)
+    {
+        if (_u8g2.cb->rotation == 2)
+        {
+            x = WIDTH - 1 - x;
+            y = HEIGHT - 1 - y;
+        }
+    }
+
+    /// @brief 背景を塗るモードではU8g2と同じく、描画色が0以外なら背景を0で塗る(XORでも)
+    void drawGlyph(int x, int y, const byte *glyph)
+    {
+        byte color = _u8g2.draw_color;
+        byte bgColor = color == 0 ? 1 : 0;
+        for (int col = 0; col < 5 + _pFont->bold; ++col)
+        {
+            byte bits = 0;
+            if (col < 5)
+                bits |= glyph[col];
+            if (_pFont->bold && col > 0)
+                bits |= glyph[col - 1];
+            for (int row = 0; row < 7; ++row)
+            {
+                if ((bits >> row) & 1)
+                {
+                    drawPixel(x + col, y + row);
+                }
+                else if (!_u8g2.font_decode.is_transparent)
+                {
+                    _u8g2.draw_color = bgColor;
+                    drawPixel(x + col, y + row);
+                    _u8g2.draw_color = color;
+                }
+            }
+        }
+    }
+
+    static void edge(int x0, int y0, int x1, int y1, int y, int &xl, int &xr)
+    {
+        if ((y < y0 && y < y1) || (y > y0 && y > y1))
+        {
+            return;
+        }
+        int x = (y0 == y1) ? x0 : x0 + (x1 - x0) * (y - y0) / (y1 - y0);
+        if (y0 == y1)
+        {
+            xl = min(xl, min(x0, x1));
+            xr = max(xr, max(x0, x1));
+            return;
+        }
+        xl = min(xl, x);
+        xr = max(xr, x);
+    }
+};
+
+class U8G2_SSD1306_128X64_NONAME_F_HW_I2C : public U8G2
+{
+public:
+    U8G2_SSD1306_128X64_NONAME_F_HW_I2C(const u8g2_cb_t *rotation, byte reset = U8X8_PIN_NONE)
+        : U8G2(rotation)
+    {
+        (void)reset;
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+/*!
+ * pico-sdk adc stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// ADC入力0-3はGPIO26-29
+#define SIM_ADC_PIN_BASE 26
+
+namespace sim
+{
+    inline volatile byte adcInput = 0;
+}
+
+inline void adc_init()
+{
+}
+
+inline void adc_gpio_init(uint gpio)
+{
+    sim::pinModes[gpio] = INPUT;
+}
+
+inline void adc_select_input(uint input)
+{
+    sim::adcInput = input;
+}
+
+/// @brief sim::analogSourceがあればそれを、なければsim::analogPinsを返す
+inline uint16_t adc_read()
+{
+    return analogRead(SIM_ADC_PIN_BASE + sim::adcInput);
+}
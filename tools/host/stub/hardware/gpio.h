@@ -0,0 +1,82 @@
+/*!
+ * pico-sdk gpio stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#define GPIO_FUNC_PWM 4
+
+inline void gpio_set_function(uint gpio, uint func)
+{
+    (void)gpio;
+    (void)func;
+}
+
+inline void gpio_init(uint gpio)
+{
+    sim::pinModes[gpio] = INPUT;
+}
+
+inline void gpio_init_mask(uint32_t mask)
+{
+    for (uint gpio = 0; gpio < SIM_PIN_MAX; ++gpio)
+    {
+        if (mask & (1u << gpio))
+        {
+            gpio_init(gpio);
+        }
+    }
+}
+
+inline void gpio_set_dir(uint gpio, bool out)
+{
+    sim::pinModes[gpio] = out ? OUTPUT : INPUT;
+}
+
+inline void gpio_set_dir_out_masked(uint32_t mask)
+{
+    for (uint gpio = 0; gpio < SIM_PIN_MAX; ++gpio)
+    {
+        if (mask & (1u << gpio))
+        {
+            gpio_set_dir(gpio, true);
+        }
+    }
+}
+
+inline void gpio_pull_up(uint gpio)
+{
+    sim::pinModes[gpio] = INPUT_PULLUP;
+    sim::digitalPins[gpio] = HIGH;
+}
+
+inline bool gpio_get(uint gpio)
+{
+    sim::perturbPoint();
+    return sim::digitalPins[gpio] != LOW;
+}
+
+inline void gpio_put(uint gpio, bool value)
+{
+    sim::digitalPins[gpio] = value ? HIGH : LOW;
+    sim::digitalWriteCount = sim::digitalWriteCount + 1;
+}
+
+/// @brief 実機と同じく1回の書き込みとして数える
+inline void gpio_put_masked(uint32_t mask, uint32_t value)
+{
+    sim::perturbPoint();
+    for (uint gpio = 0; gpio < SIM_PIN_MAX; ++gpio)
+    {
+        if (mask & (1u << gpio))
+        {
+            sim::digitalPins[gpio] = (value >> gpio) & 1;
+        }
+    }
+    sim::digitalWriteCount = sim::digitalWriteCount + 1;
+}
@@ -0,0 +1,51 @@
+/*!
+ * pico-sdk pwm stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <hardware/gpio.h>
+
+#define PWM_CHAN_A 0
+#define PWM_CHAN_B 1
+#define SIM_PWM_SLICE_MAX 8
+
+namespace sim
+{
+    inline volatile uint16_t pwmLevels[SIM_PWM_SLICE_MAX][2] = {{0}};
+    inline volatile uint32_t pwmWriteCount = 0;
+}
+
+inline uint pwm_gpio_to_slice_num(uint gpio)
+{
+    return (gpio >> 1) & 7;
+}
+
+inline void pwm_set_clkdiv(uint slice, float div)
+{
+    (void)slice;
+    (void)div;
+}
+
+inline void pwm_set_wrap(uint slice, uint16_t wrap)
+{
+    (void)slice;
+    (void)wrap;
+}
+
+inline void pwm_set_enabled(uint slice, bool enabled)
+{
+    (void)slice;
+    (void)enabled;
+}
+
+inline void pwm_set_chan_level(uint slice, uint chan, uint16_t level)
+{
+    sim::perturbPoint();
+    sim::pwmLevels[slice][chan] = level;
+    sim::pwmWriteCount = sim::pwmWriteCount + 1;
+}
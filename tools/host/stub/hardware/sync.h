@@ -0,0 +1,15 @@
+/*!
+ * pico-sdk sync stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/// @brief 起こす相手はbest_effort_wfe_or_timeoutの中で短く眠るだけなので何もしない
+inline void __sev()
+{
+}
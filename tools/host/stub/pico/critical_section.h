@@ -0,0 +1,30 @@
+/*!
+ * pico-sdk critical_section stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <mutex>
+
+typedef struct
+{
+    std::mutex *pMutex;
+} critical_section_t;
+
+inline void critical_section_init(critical_section_t *pCritSec)
+{
+    pCritSec->pMutex = new std::mutex();
+}
+
+inline void critical_section_enter_blocking(critical_section_t *pCritSec)
+{
+    pCritSec->pMutex->lock();
+}
+
+inline void critical_section_exit(critical_section_t *pCritSec)
+{
+    pCritSec->pMutex->unlock();
+}
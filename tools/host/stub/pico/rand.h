@@ -0,0 +1,17 @@
+/*!
+ * pico-sdk rand stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <random>
+#include <Arduino.h>
+
+inline uint32_t get_rand_32()
+{
+    static std::random_device device;
+    return device();
+}
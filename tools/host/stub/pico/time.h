@@ -0,0 +1,38 @@
+/*!
+ * pico-sdk time stub for host build
+ * Copyright 2023 marksard
+ * This software is released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// 実時間でこれより長くは眠らない。__sevで起こせないので、もう片方のスレッドのsignalはこの間隔で拾う
+#define SIM_WFE_MAX_MICROS 100
+
+typedef uint32_t absolute_time_t;
+
+inline absolute_time_t get_absolute_time()
+{
+    return micros();
+}
+
+inline absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return get_absolute_time() + (uint32_t)us;
+}
+
+/// @brief 実機と同じく早めに戻ってよい。疑似時間では時計を進めずにすぐ戻る
+/// @return 時刻に達したらtrue
+inline bool best_effort_wfe_or_timeout(absolute_time_t timeout)
+{
+    int32_t remain = (int32_t)(timeout - get_absolute_time());
+    if (remain > 0 && sim::realTime)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(min(remain, (int32_t)SIM_WFE_MAX_MICROS)));
+        remain = (int32_t)(timeout - get_absolute_time());
+    }
+    return remain <= 0;
+}
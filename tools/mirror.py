@@ -0,0 +1,185 @@
+#
+# Reverb Island display mirror viewer
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# USB CDCから流れる画面の写しを受けて端末に表示する
+#   python mirror.py COM3                 (端末に表示。Ctrl+Cで終了)
+#   python mirror.py COM3 --pbm frames    (受けた画面をPBMでも書き出す)
+#   python mirror.py --file capture.bin --pbm frames
+# 画面はXOR差分をPackBitsで縮めたもの。DisplayMirror.hpp を参照
+# シリアル受信には pyserial が必要
+#
+
+import argparse
+import os
+import sys
+
+from telemetry_csv import FrameDecoder
+
+FRAME_TYPE_DISPLAY_MIRROR = 0x08
+
+WIDTH = 128
+HEIGHT = 64
+FRAME_SIZE = WIDTH * HEIGHT // 8
+
+MIRROR_HEADER_SIZE = 3
+MIRROR_FLAG_KEY = 0x01
+MIRROR_FLAG_LAST = 0x02
+MIRROR_FLAG_ROTATE = 0x04
+
+
+def decode_rle(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        control = data[i]
+        i += 1
+        if control & 0x80:
+            out += bytes([data[i]]) * ((control & 0x7F) + 1)
+            i += 1
+        else:
+            out += data[i:i + control + 1]
+            i += control + 1
+    return out
+
+
+class MirrorDecoder:
+    """分割されたフレームを組み立て、前の画面に差分を重ねる。全体を受けるまでは何も返さない"""
+
+    def __init__(self):
+        self.frame = bytearray(FRAME_SIZE)
+        self.has_key = False
+        self.rotate = False
+        self.seq = None
+        self.last_seq = None  # 最後に組み上がったフレームの連番
+        self.next_chunk = 0
+        self.data = bytearray()
+        self.frames = 0
+        self.bytes = 0
+        self.dropped = 0
+
+    def feed(self, payload):
+        if len(payload) < MIRROR_HEADER_SIZE:
+            return None
+        seq, flags, chunk = payload[0], payload[1], payload[2]
+        if chunk == 0:
+            if self.next_chunk != 0:
+                # 組み立て中のフレームを捨てる。その差分が抜けるので次の全体を待つ
+                self.dropped += 1
+                self.has_key = False
+            self.seq = seq
+            self.data = bytearray()
+        elif seq != self.seq or chunk != self.next_chunk:
+            # 途中が欠けたフレームは捨てる。次の全体まで差分は重ねられない
+            self.dropped += 1
+            self.next_chunk = 0
+            self.has_key = False
+            return None
+        self.data += payload[MIRROR_HEADER_SIZE:]
+        self.next_chunk = chunk + 1
+        if not flags & MIRROR_FLAG_LAST:
+            return None
+
+        self.next_chunk = 0
+        delta = decode_rle(self.data)
+        if len(delta) != FRAME_SIZE:
+            self.dropped += 1
+            self.has_key = False
+            return None
+        last_seq = self.last_seq
+        self.last_seq = seq
+        if flags & MIRROR_FLAG_KEY:
+            self.frame = delta
+            self.has_key = True
+        elif self.has_key and seq == (last_seq + 1) & 0xFF:
+            self.frame = bytearray(a ^ b for a, b in zip(self.frame, delta))
+        else:
+            # 連番が飛んだら間の差分を失っている
+            self.has_key = False
+            return None
+        self.rotate = bool(flags & MIRROR_FLAG_ROTATE)
+        self.frames += 1
+        self.bytes += len(self.data)
+        return self.frame
+
+    def pixel(self, x, y):
+        if self.rotate:
+            x = WIDTH - 1 - x
+            y = HEIGHT - 1 - y
+        return (self.frame[(y >> 3) * WIDTH + x] >> (y & 7)) & 1
+
+
+def render(decoder):
+    # 上下2ドットを1文字にする
+    chars = " ▀▄█"
+    lines = []
+    for y in range(0, HEIGHT, 2):
+        lines.append("".join(chars[decoder.pixel(x, y) | (decoder.pixel(x, y + 1) << 1)] for x in range(WIDTH)))
+    average = decoder.bytes / decoder.frames if decoder.frames else 0
+    lines.append("frames %d  avg %.0f bytes/frame  dropped %d" % (decoder.frames, average, decoder.dropped))
+    return "\x1b[H" + "\n".join(lines) + "\n"
+
+
+def write_pbm(path, decoder):
+    with open(path, "wb") as f:
+        f.write(b"P4\n%d %d\n" % (WIDTH, HEIGHT))
+        for y in range(HEIGHT):
+            for x in range(0, WIDTH, 8):
+                bits = 0
+                for b in range(8):
+                    bits |= decoder.pixel(x + b, y) << (7 - b)
+                f.write(bytes([bits]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island display mirror")
+    parser.add_argument("port", nargs="?", help="serial port (e.g. COM3, /dev/ttyACM0)")
+    parser.add_argument("--file", help="read frames from a capture file instead of a serial port")
+    parser.add_argument("--pbm", help="also write each frame to DIR as PBM")
+    parser.add_argument("--quiet", action="store_true", help="do not draw on the terminal")
+    args = parser.parse_args()
+    if (args.port is None) == (args.file is None):
+        parser.error("specify a serial port or --file")
+
+    if args.pbm:
+        os.makedirs(args.pbm, exist_ok=True)
+
+    frames = FrameDecoder()
+    decoder = MirrorDecoder()
+
+    def handle(data):
+        for frame_type, payload in frames.feed(data):
+            if frame_type != FRAME_TYPE_DISPLAY_MIRROR or decoder.feed(payload) is None:
+                continue
+            if args.pbm:
+                write_pbm(os.path.join(args.pbm, "frame_%06d.pbm" % decoder.frames), decoder)
+            if not args.quiet:
+                sys.stdout.write(render(decoder))
+                sys.stdout.flush()
+
+    if not args.quiet:
+        sys.stdout.write("\x1b[2J")
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            handle(f.read())
+        return
+
+    import serial
+
+    with serial.Serial(args.port, timeout=0.1) as port:
+        # 開始すると最初は全体が来る
+        port.write(b"M")
+        try:
+            while True:
+                handle(port.read(4096))
+        except KeyboardInterrupt:
+            pass
+        finally:
+            port.write(b"m")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,104 @@
+#
+# Reverb Island task statistics viewer
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# スケジューラのタスクごとの実行統計を取得して表示する
+#   python task_stats.py COM3 [--reset] [--interval N] [--boot]
+#     --boot  起動の節目の時刻も表示する(電源投入からの時刻)
+# 時間の単位はすべてus
+# シリアル通信には pyserial が必要
+#
+
+import argparse
+import struct
+import time
+
+from telemetry_csv import FrameDecoder
+
+FRAME_TYPE_TASK_STATS = 0x03
+FRAME_TYPE_BOOT = 0x07
+
+# Scheduler.hpp の SchedulerTaskStats と同じ並び
+STATS = struct.Struct("<8sBB8I")
+CORE_NAMES = {0: "core0", 1: "core1", 2: "any"}
+
+# BootLog.hpp の BOOT_* と同じ並び
+BOOT = struct.Struct("<8I")
+BOOT_NAMES = ["setup", "snapshot", "outputs", "inputs", "ready", "oled_setup", "oled_ready", "first_frame"]
+
+
+def request(port, decoder):
+    port.write(b"S")
+    rows = []
+    deadline = time.monotonic() + 1.0
+    while time.monotonic() < deadline:
+        received = False
+        for frame_type, payload in decoder.feed(port.read(4096)):
+            if frame_type == FRAME_TYPE_TASK_STATS and len(payload) == STATS.size:
+                rows.append(STATS.unpack(payload))
+                received = True
+        # 全タスク分はまとめて来るので、途切れたら1回分として締める
+        if rows and not received:
+            break
+    return rows
+
+
+def request_boot(port, decoder):
+    port.write(b"B")
+    deadline = time.monotonic() + 1.0
+    while time.monotonic() < deadline:
+        for frame_type, payload in decoder.feed(port.read(4096)):
+            if frame_type == FRAME_TYPE_BOOT and len(payload) == BOOT.size:
+                return BOOT.unpack(payload)
+    return None
+
+
+def show_boot(milestones):
+    if milestones is None:
+        print("no boot log")
+        return
+    print("%-12s %10s" % ("milestone", "us"))
+    for name, value in zip(BOOT_NAMES, milestones):
+        print("%-12s %10s" % (name, value if value > 0 else "-"))
+
+
+def show(rows):
+    print("%-8s %-5s %3s %8s %8s %10s %8s %6s %8s %8s %8s" % (
+        "task", "core", "pri", "period", "deadline", "runs", "overrun", "skip", "exec_max", "exec_ave", "lat_max"))
+    for (name, core, priority, period, deadline, runs, overruns, skips,
+         exec_max, exec_ave, latency_max) in rows:
+        print("%-8s %-5s %3d %8d %8d %10d %8d %6d %8d %8d %8d" % (
+            name.rstrip(b"\0").decode("ascii", "replace"), CORE_NAMES.get(core, core), priority,
+            period, deadline, runs, overruns, skips, exec_max, exec_ave, latency_max))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island task statistics")
+    parser.add_argument("port", help="serial port (e.g. COM3, /dev/ttyACM0)")
+    parser.add_argument("--reset", action="store_true", help="clear statistics before reading")
+    parser.add_argument("--interval", type=float, default=0, help="repeat every N seconds")
+    parser.add_argument("--boot", action="store_true", help="show boot milestones")
+    args = parser.parse_args()
+
+    import serial
+
+    decoder = FrameDecoder()
+    with serial.Serial(args.port, timeout=0.1) as port:
+        if args.boot:
+            show_boot(request_boot(port, decoder))
+            print()
+        if args.reset:
+            port.write(b"s")
+        while True:
+            if args.interval > 0:
+                time.sleep(args.interval)
+            show(request(port, decoder))
+            if args.interval <= 0:
+                break
+            print()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#
+# Reverb Island telemetry decoder
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# USB CDCから流れるテレメトリフレームを受けてCSVに書き出す
+#   python telemetry_csv.py COM3 out.csv
+#   python telemetry_csv.py --file capture.bin out.csv
+#   python telemetry_csv.py COM3 out.csv --scope scope.csv   (スコープの測定結果も別のCSVへ)
+# シリアル受信には pyserial が必要
+#
+
+import argparse
+import csv
+import struct
+import sys
+
+FRAME_SYNC = b"\xA5\x5A"
+FRAME_HEADER_SIZE = 4
+FRAME_FOOTER_SIZE = 2
+FRAME_TYPE_TELEMETRY = 0x01
+FRAME_TYPE_SCOPE_MEASURE = 0x05
+
+POTS_MAX = 3
+
+# Telemetry.hpp の TelemetryRecord と同じ並び
+RECORD = struct.Struct("<I3H3HHH3HBB")
+COLUMNS = (["micros"]
+           + ["pot%d_raw" % i for i in range(POTS_MAX)]
+           + ["pot%d_value" % i for i in range(POTS_MAX)]
+           + ["cv_raw", "cv_value"]
+           + ["pwm%d" % i for i in range(POTS_MAX)]
+           + ["preset_index", "disp_mode"])
+
+
+# WaveMeasure.hpp の ScopeMeasure と同じ並び
+SCOPE_RECORD = struct.Struct("<III6H")
+SCOPE_COLUMNS = ["micros", "period_us", "freq_hz", "vpp_v", "mean_v", "rms_v", "duty_pct", "samples", "edges"]
+DATA_MAX_VOLT = 5.0
+DATA_MAX_VALUE = 4095
+
+
+def scope_row(values):
+    micros, period_ns, freq_milli, vpp, mean, rms, duty, samples, edges = values
+    volt = DATA_MAX_VOLT / DATA_MAX_VALUE
+    return [micros, "%.3f" % (period_ns / 1000.0), "%.3f" % (freq_milli / 1000.0),
+            "%.3f" % (vpp * volt), "%.3f" % (mean * volt), "%.3f" % (rms * volt),
+            "%.1f" % (duty / 10.0), samples, edges]
+
+def fletcher16(data):
+    sum1 = 0
+    sum2 = 0
+    for b in data:
+        sum1 = (sum1 + b) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+class FrameDecoder:
+    """バイト列からフレームを切り出す。同期が外れたら次のSYNCまで読み捨てる"""
+
+    def __init__(self):
+        self.buff = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        self.buff += data
+        while True:
+            start = self.buff.find(FRAME_SYNC)
+            if start < 0:
+                # SYNC0だけ来ている可能性があるので末尾1バイトは残す
+                del self.buff[:max(len(self.buff) - 1, 0)]
+                return
+            del self.buff[:start]
+            if len(self.buff) < FRAME_HEADER_SIZE:
+                return
+            length = self.buff[3]
+            size = FRAME_HEADER_SIZE + length + FRAME_FOOTER_SIZE
+            if len(self.buff) < size:
+                return
+            body = bytes(self.buff[2:FRAME_HEADER_SIZE + length])
+            sum_rx = self.buff[size - 2] | (self.buff[size - 1] << 8)
+            if fletcher16(body) != sum_rx:
+                self.errors += 1
+                del self.buff[:1]
+                continue
+            del self.buff[:size]
+            yield body[0], body[2:]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island telemetry to CSV")
+    parser.add_argument("port", nargs="?", help="serial port (e.g. COM3, /dev/ttyACM0)")
+    parser.add_argument("output", help="output csv file ('-' for stdout)")
+    parser.add_argument("--file", help="decode raw capture file instead of serial port")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after N seconds (serial only)")
+    parser.add_argument("--scope", help="also write scope measurements to this csv")
+    args = parser.parse_args()
+
+    if args.file is None and args.port is None:
+        parser.error("port or --file is required")
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w", newline="")
+    writer = csv.writer(out)
+    writer.writerow(COLUMNS)
+
+    scope_out = None
+    scope_writer = None
+    if args.scope is not None:
+        scope_out = open(args.scope, "w", newline="")
+        scope_writer = csv.writer(scope_out)
+        scope_writer.writerow(SCOPE_COLUMNS)
+
+    decoder = FrameDecoder()
+    rows = 0
+
+    def write_frames(data):
+        nonlocal rows
+        for frame_type, payload in decoder.feed(data):
+            if frame_type == FRAME_TYPE_SCOPE_MEASURE and scope_writer is not None:
+                if len(payload) == SCOPE_RECORD.size:
+                    scope_writer.writerow(scope_row(SCOPE_RECORD.unpack(payload)))
+                continue
+            if frame_type != FRAME_TYPE_TELEMETRY or len(payload) != RECORD.size:
+                continue
+            writer.writerow(RECORD.unpack(payload))
+            rows += 1
+
+    if args.file is not None:
+        with open(args.file, "rb") as f:
+            write_frames(f.read())
+    else:
+        import time
+        import serial
+
+        with serial.Serial(args.port, timeout=0.1) as port:
+            port.write(b"T")
+            start = time.monotonic()
+            try:
+                while args.seconds <= 0 or time.monotonic() - start < args.seconds:
+                    write_frames(port.read(4096))
+            except KeyboardInterrupt:
+                pass
+            finally:
+                port.write(b"t")
+
+    if out is not sys.stdout:
+        out.close()
+    if scope_out is not None:
+        scope_out.close()
+    print("%d records, %d checksum errors" % (rows, decoder.errors), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,125 @@
+#
+# Reverb Island input trace recorder / player
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# 操作入力(ポット、CV、ボタン)の記録と実機での再生
+#   python trace.py record COM3 session.trc [--seconds N]
+#   python trace.py replay COM3 session.trc
+#   python trace.py dump session.trc
+# ホストでの再生は tools/host の replay を使う
+# シリアル通信には pyserial が必要
+#
+
+import argparse
+import struct
+import sys
+import time
+
+from telemetry_csv import FRAME_SYNC, FrameDecoder, fletcher16
+
+FRAME_TYPE_TRACE = 0x02
+FRAME_PAYLOAD_MAX = 255
+
+# InputTrace.hpp の TraceEvent と同じ並び
+EVENT = struct.Struct("<IBH")
+EVENTS_PER_FRAME = FRAME_PAYLOAD_MAX // EVENT.size
+
+SRC_TICK = 0x00
+SRC_END = 0xFF
+SOURCE_NAMES = {0x00: "tick", 0x01: "pot0", 0x02: "pot1", 0x03: "pot2",
+                0x04: "cv", 0x05: "sw0", 0x06: "sw1", 0x40: "state", 0xFF: "end"}
+
+
+def build_frame(frame_type, payload):
+    body = bytes([frame_type, len(payload)]) + payload
+    s = fletcher16(body)
+    return FRAME_SYNC + body + bytes([s & 0xFF, s >> 8])
+
+
+def record(args):
+    import serial
+
+    decoder = FrameDecoder()
+    events = 0
+    ended = False
+    with serial.Serial(args.port, timeout=0.1) as port, open(args.trace, "wb") as out:
+        port.write(b"R")
+        start = time.monotonic()
+        try:
+            while args.seconds <= 0 or time.monotonic() - start < args.seconds:
+                for frame_type, payload in decoder.feed(port.read(4096)):
+                    if frame_type == FRAME_TYPE_TRACE:
+                        out.write(payload)
+                        events += len(payload) // EVENT.size
+        except KeyboardInterrupt:
+            pass
+
+        # 停止すると終端イベントが来るので、それまで受ける
+        port.write(b"r")
+        deadline = time.monotonic() + 2.0
+        while not ended and time.monotonic() < deadline:
+            for frame_type, payload in decoder.feed(port.read(4096)):
+                if frame_type != FRAME_TYPE_TRACE:
+                    continue
+                out.write(payload)
+                events += len(payload) // EVENT.size
+                last = EVENT.unpack_from(payload, len(payload) - EVENT.size)
+                if last[1] == SRC_END:
+                    ended = True
+                    if last[2] != 0:
+                        print("warning: trace buffer overflowed on device", file=sys.stderr)
+
+    print("%d events%s" % (events, "" if ended else " (no end marker)"), file=sys.stderr)
+
+
+def replay(args):
+    import serial
+
+    with open(args.trace, "rb") as f:
+        data = f.read()
+
+    chunk = EVENTS_PER_FRAME * EVENT.size
+    with serial.Serial(args.port, timeout=0.1) as port:
+        port.write(b"P")
+        # 実機側は再生バッファに空きがないと受信しないので、書き込みがそのまま流量制御になる
+        for pos in range(0, len(data), chunk):
+            port.write(build_frame(FRAME_TYPE_TRACE, data[pos:pos + chunk]))
+        port.flush()
+    print("%d events sent" % (len(data) // EVENT.size), file=sys.stderr)
+
+
+def dump(args):
+    with open(args.trace, "rb") as f:
+        data = f.read()
+    print("micros,source,value")
+    for micros, source, value in EVENT.iter_unpack(data[:len(data) - len(data) % EVENT.size]):
+        print("%d,%s,%d" % (micros, SOURCE_NAMES.get(source, source), value))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island input trace")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("record", help="record inputs from device")
+    p.add_argument("port")
+    p.add_argument("trace")
+    p.add_argument("--seconds", type=float, default=0)
+    p.set_defaults(func=record)
+
+    p = sub.add_parser("replay", help="replay trace on device")
+    p.add_argument("port")
+    p.add_argument("trace")
+    p.set_defaults(func=replay)
+
+    p = sub.add_parser("dump", help="print trace as csv")
+    p.add_argument("trace")
+    p.set_defaults(func=dump)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,411 @@
+#
+# Reverb Island control script compiler
+# Copyright 2023 marksard
+# This software is released under the MIT license.
+# see https://opensource.org/licenses/MIT
+#
+# 操作の割り当てスクリプトを ControlVM.hpp の命令列にコンパイルし、プリセットへ転送する
+#   python vmc.py build mapping.ctl
+#   python vmc.py upload COM3 mapping.ctl --preset 5
+#   python vmc.py clear COM3 --preset 5
+# スクリプトはPythonの文法の一部。制御周期(1ms)ごとに先頭から1回実行される
+#   param1 = clamp(pot1 + cv - 2048, 0, 4095)   # CVを両極性で加算
+#   if sw0 == CLICK and count < 3:
+#       count += 1
+#   param2 = mulq(pot2, 4095 - pot0)             # 12bit固定小数の積
+# 入力  pot0-2 cv sw0 sw1 time(ms) param0-2(現在値) preset
+# 出力  param0-2 (0-4095) preset。代入したものだけが通常の操作より優先される
+# ほかの名前は実行をまたいで値を保持する変数(プリセットが変わると0)
+# 関数  min max abs clamp mulq   定数 DOWN CLICK HOLDING HOLDED (sw0/sw1の状態)
+# 分岐は前方だけなので、ループは書けず実行命令数は最悪でも命令数に収まる
+# シリアル通信には pyserial が必要
+#
+
+import argparse
+import ast
+import struct
+import sys
+import time
+
+from telemetry_csv import FRAME_SYNC, FrameDecoder, fletcher16
+
+FRAME_TYPE_CONTROL_VM = 0x06
+FRAME_PAYLOAD_MAX = 255
+
+# ControlVM.hpp と同じ値
+REGS = 16
+PROGRAM_MAX = 64
+FRAME_HEADER = 3
+INSTRUCTIONS_PER_FRAME = (FRAME_PAYLOAD_MAX - FRAME_HEADER) // 4
+PRESET_TOTAL = 24
+
+OP_END, OP_LDI, OP_MOV, OP_IN, OP_OUT = 0x00, 0x01, 0x02, 0x03, 0x04
+OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MULQ = 0x10, 0x11, 0x12, 0x13, 0x14
+OP_MIN, OP_MAX, OP_AND, OP_OR, OP_XOR = 0x15, 0x16, 0x17, 0x18, 0x19
+OP_SHL, OP_SHR, OP_ABS, OP_NEG = 0x1A, 0x1B, 0x1C, 0x1D
+OP_JMP, OP_JZ, OP_JNZ, OP_JLT, OP_JGE, OP_JEQ, OP_JNE = 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26
+OP_NAMES = {OP_END: "end", OP_LDI: "ldi", OP_MOV: "mov", OP_IN: "in", OP_OUT: "out",
+            OP_ADD: "add", OP_SUB: "sub", OP_MUL: "mul", OP_DIV: "div", OP_MULQ: "mulq",
+            OP_MIN: "min", OP_MAX: "max", OP_AND: "and", OP_OR: "or", OP_XOR: "xor",
+            OP_SHL: "shl", OP_SHR: "shr", OP_ABS: "abs", OP_NEG: "neg",
+            OP_JMP: "jmp", OP_JZ: "jz", OP_JNZ: "jnz", OP_JLT: "jlt", OP_JGE: "jge",
+            OP_JEQ: "jeq", OP_JNE: "jne"}
+JUMPS = (OP_JMP, OP_JZ, OP_JNZ, OP_JLT, OP_JGE, OP_JEQ, OP_JNE)
+
+INPUTS = {"pot0": 0, "pot1": 1, "pot2": 2, "cv": 3, "sw0": 4, "sw1": 5, "time": 6,
+          "param0": 7, "param1": 8, "param2": 9, "preset": 10}
+OUTPUTS = {"param0": 0, "param1": 1, "param2": 2, "preset": 3}
+CONSTANTS = {"DOWN": 1, "CLICK": 2, "HOLDING": 3, "HOLDED": 4}
+FUNCTIONS = ("min", "max", "abs", "clamp", "mulq")
+
+BINOPS = {ast.Add: OP_ADD, ast.Sub: OP_SUB, ast.Mult: OP_MUL, ast.Div: OP_DIV, ast.FloorDiv: OP_DIV,
+          ast.BitAnd: OP_AND, ast.BitOr: OP_OR, ast.BitXor: OP_XOR, ast.LShift: OP_SHL, ast.RShift: OP_SHR}
+# 比較 -> (成立で飛ぶ命令, 左右を入れ替えるか)
+COMPARES = {ast.Lt: (OP_JLT, False), ast.GtE: (OP_JGE, False), ast.Gt: (OP_JLT, True),
+            ast.LtE: (OP_JGE, True), ast.Eq: (OP_JEQ, False), ast.NotEq: (OP_JNE, False)}
+NEGATE = {OP_JLT: OP_JGE, OP_JGE: OP_JLT, OP_JEQ: OP_JNE, OP_JNE: OP_JEQ}
+
+
+class CompileError(Exception):
+    def __init__(self, node, message):
+        super().__init__(message)
+        self.line = getattr(node, "lineno", 0)
+
+
+class Compiler:
+    def __init__(self):
+        self.code = []
+        self.names = {}
+        self.temps = []
+        self.labels = []
+        self.fixups = []
+
+    def compile(self, source):
+        tree = ast.parse(source)
+        # 入力と変数のレジスタを先に決め、読まれる入力は先頭で一度だけ取り込む
+        reads = []
+        funcs = set()
+        for node in ast.walk(tree):
+            if isinstance(node, ast.Call) and isinstance(node.func, ast.Name):
+                # 関数名は変数ではない。レジスタを取らせない
+                if node.func.id not in FUNCTIONS:
+                    raise CompileError(node, "unknown function %s" % node.func.id)
+                funcs.add(node.func)
+        for node in ast.walk(tree):
+            if isinstance(node, ast.Name) and node.id not in CONSTANTS and node not in funcs:
+                self.reg(node.id, node)
+                if isinstance(node.ctx, ast.Load) and node.id in INPUTS and node.id not in reads:
+                    reads.append(node.id)
+            elif isinstance(node, ast.AugAssign) and isinstance(node.target, ast.Name):
+                if node.target.id in INPUTS and node.target.id not in reads:
+                    reads.append(node.target.id)
+        for name in reads:
+            self.emit(OP_IN, self.names[name], INPUTS[name], 0)
+
+        self.block(tree.body)
+        for index, label in self.fixups:
+            offset = self.labels[label] - (index + 1)
+            op, a, b, _ = self.code[index]
+            self.code[index] = (op, a, b, offset)
+        if len(self.code) > PROGRAM_MAX:
+            raise CompileError(None, "%d instructions (max %d)" % (len(self.code), PROGRAM_MAX))
+        return self.code
+
+    def reg(self, name, node):
+        if name not in self.names:
+            if len(self.names) + len(self.temps) >= REGS:
+                raise CompileError(node, "too many variables")
+            self.names[name] = len(self.names)
+        return self.names[name]
+
+    def temp(self, node):
+        used = set(self.names.values()) | set(self.temps)
+        for r in range(REGS):
+            if r not in used:
+                self.temps.append(r)
+                return r
+        raise CompileError(node, "expression too deep")
+
+    def free(self, *regs):
+        for r in regs:
+            if r in self.temps:
+                self.temps.remove(r)
+
+    def emit(self, op, a=0, b=0, c=0):
+        self.code.append((op, a, b, c))
+
+    def new_label(self):
+        self.labels.append(None)
+        return len(self.labels) - 1
+
+    def place(self, label):
+        self.labels[label] = len(self.code)
+
+    def jump(self, op, a, b, label):
+        self.fixups.append((len(self.code), label))
+        self.emit(op, a, b, 0)
+
+    def block(self, body):
+        for node in body:
+            self.statement(node)
+
+    def statement(self, node):
+        if isinstance(node, ast.Assign):
+            if len(node.targets) != 1 or not isinstance(node.targets[0], ast.Name):
+                raise CompileError(node, "only 'name = expr' is supported")
+            self.assign(node.targets[0].id, node.value, node)
+        elif isinstance(node, ast.AugAssign):
+            if not isinstance(node.target, ast.Name):
+                raise CompileError(node, "only 'name op= expr' is supported")
+            value = ast.BinOp(left=ast.Name(id=node.target.id, ctx=ast.Load()), op=node.op, right=node.value)
+            ast.copy_location(value, node)
+            self.assign(node.target.id, value, node)
+        elif isinstance(node, ast.If):
+            skip = self.new_label()
+            self.branch(node.test, skip, False)
+            self.block(node.body)
+            if node.orelse:
+                end = self.new_label()
+                self.jump(OP_JMP, 0, 0, end)
+                self.place(skip)
+                self.block(node.orelse)
+                self.place(end)
+            else:
+                self.place(skip)
+        elif isinstance(node, ast.Pass):
+            pass
+        else:
+            raise CompileError(node, "unsupported statement (no loops or calls)")
+
+    def assign(self, name, value, node):
+        if name in CONSTANTS or (name in INPUTS and name not in OUTPUTS):
+            raise CompileError(node, "'%s' is read only" % name)
+        dst = self.names[name]
+        self.expr(value, dst)
+        if name in OUTPUTS:
+            self.emit(OP_OUT, dst, OUTPUTS[name], 0)
+
+    def expr(self, node, dst=None):
+        """式を評価したレジスタを返す。dstがあれば必ずそこへ入れる"""
+        if isinstance(node, ast.Constant) and isinstance(node.value, int) and not isinstance(node.value, bool):
+            return self.load(node.value, dst, node)
+        if isinstance(node, ast.Name):
+            if node.id in CONSTANTS:
+                return self.load(CONSTANTS[node.id], dst, node)
+            src = self.names[node.id]
+            if dst is not None and dst != src:
+                self.emit(OP_MOV, dst, src, 0)
+                return dst
+            return src
+        if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.USub):
+            if isinstance(node.operand, ast.Constant):
+                return self.load(-node.operand.value, dst, node)
+            return self.unary(OP_NEG, node.operand, dst, node)
+        if isinstance(node, ast.BinOp) and type(node.op) in BINOPS:
+            return self.binary(BINOPS[type(node.op)], node.left, node.right, dst, node)
+        if isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and not node.keywords:
+            return self.call(node.func.id, node.args, dst, node)
+        raise CompileError(node, "unsupported expression")
+
+    def load(self, value, dst, node):
+        if not -0x8000 <= value <= 0x7FFF:
+            raise CompileError(node, "constant %d out of 16bit range" % value)
+        r = dst if dst is not None else self.temp(node)
+        self.emit(OP_LDI, r, value & 0xFF, (value >> 8) & 0xFF)
+        return r
+
+    def unary(self, op, operand, dst, node):
+        a = self.expr(operand)
+        self.free(a)
+        r = dst if dst is not None else self.temp(node)
+        self.emit(op, r, a, 0)
+        return r
+
+    def binary(self, op, left, right, dst, node):
+        a = self.expr(left)
+        b = self.expr(right)
+        self.free(a, b)
+        r = dst if dst is not None else self.temp(node)
+        self.emit(op, r, a, b)
+        return r
+
+    def call(self, name, args, dst, node):
+        if name in ("min", "max") and len(args) >= 2:
+            op = OP_MIN if name == "min" else OP_MAX
+            value = args[0]
+            for arg in args[1:-1]:
+                value = ast.Call(func=ast.Name(id=name, ctx=ast.Load()), args=[value, arg], keywords=[])
+            return self.binary(op, value, args[-1], dst, node)
+        if name == "abs" and len(args) == 1:
+            return self.unary(OP_ABS, args[0], dst, node)
+        if name == "mulq" and len(args) == 2:
+            return self.binary(OP_MULQ, args[0], args[1], dst, node)
+        if name == "clamp" and len(args) == 3:
+            low = ast.Call(func=ast.Name(id="max", ctx=ast.Load()), args=args[:2], keywords=[])
+            return self.binary(OP_MIN, low, args[2], dst, node)
+        raise CompileError(node, "unknown function %s/%d" % (name, len(args)))
+
+    def branch(self, node, label, when):
+        """nodeの真偽がwhenならlabelへ飛ぶ"""
+        if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.Not):
+            self.branch(node.operand, label, not when)
+        elif isinstance(node, ast.BoolOp):
+            # and: どれかが偽なら偽 / or: どれかが真なら真
+            decisive = isinstance(node.op, ast.Or)
+            if when == decisive:
+                for value in node.values:
+                    self.branch(value, label, when)
+            else:
+                done = self.new_label()
+                for value in node.values[:-1]:
+                    self.branch(value, done, decisive)
+                self.branch(node.values[-1], label, when)
+                self.place(done)
+        elif isinstance(node, ast.Compare):
+            if len(node.ops) != 1 or type(node.ops[0]) not in COMPARES:
+                raise CompileError(node, "use a single <, <=, >, >=, == or !=")
+            op, swap = COMPARES[type(node.ops[0])]
+            a = self.expr(node.left)
+            b = self.expr(node.comparators[0])
+            self.free(a, b)
+            if swap:
+                a, b = b, a
+            self.jump(op if when else NEGATE[op], a, b, label)
+        else:
+            a = self.expr(node)
+            self.free(a)
+            self.jump(OP_JNZ if when else OP_JZ, a, 0, label)
+
+
+def worst_case(code):
+    """前方分岐だけなので、後ろから最長経路を求める"""
+    longest = [0] * (len(code) + 1)
+    for pc in range(len(code) - 1, -1, -1):
+        op, _, _, c = code[pc]
+        if op == OP_END:
+            longest[pc] = 1
+        elif op == OP_JMP:
+            longest[pc] = 1 + longest[pc + 1 + c]
+        elif op in JUMPS:
+            longest[pc] = 1 + max(longest[pc + 1], longest[pc + 1 + c])
+        else:
+            longest[pc] = 1 + longest[pc + 1]
+    return longest[0]
+
+
+def compile_script(path):
+    with open(path) as f:
+        source = f.read()
+    try:
+        return Compiler().compile(source)
+    except CompileError as e:
+        sys.exit("%s:%d: %s" % (path, e.line, e))
+    except SyntaxError as e:
+        sys.exit("%s:%d: %s" % (path, e.lineno, e.msg))
+
+
+def build_frame(frame_type, payload):
+    body = bytes([frame_type, len(payload)]) + payload
+    s = fletcher16(body)
+    return FRAME_SYNC + body + bytes([s & 0xFF, s >> 8])
+
+
+def build_frames(preset, code):
+    frames = []
+    offset = 0
+    while True:
+        chunk = code[offset:offset + INSTRUCTIONS_PER_FRAME]
+        last = offset + len(chunk) >= len(code)
+        payload = bytes([preset, offset, 1 if last else 0])
+        for inst in chunk:
+            payload += bytes(inst)
+        frames.append(build_frame(FRAME_TYPE_CONTROL_VM, payload))
+        offset += len(chunk)
+        if last:
+            return frames
+
+
+def send(port_name, preset, code):
+    import serial
+
+    results = {0: "ok", 2: "bad frame", 3: "bad code"}
+    decoder = FrameDecoder()
+    with serial.Serial(port_name, timeout=0.1) as port:
+        for frame in build_frames(preset, code):
+            port.write(frame)
+        port.flush()
+        deadline = time.monotonic() + 1.0
+        while time.monotonic() < deadline:
+            for frame_type, payload in decoder.feed(port.read(256)):
+                if frame_type == FRAME_TYPE_CONTROL_VM and len(payload) == 3 and payload[0] == preset:
+                    if payload[1] != 0:
+                        sys.exit("preset %d: %s at %d" % (preset, results.get(payload[1], payload[1]), payload[2]))
+                    return
+    sys.exit("no reply")
+
+
+def listing(code):
+    for pc, (op, a, b, c) in enumerate(code):
+        name = OP_NAMES[op]
+        if op == OP_LDI:
+            text = "r%d, %d" % (a, struct.unpack("<h", bytes([b, c]))[0])
+        elif op in (OP_MOV, OP_ABS, OP_NEG):
+            text = "r%d, r%d" % (a, b)
+        elif op == OP_IN:
+            text = "r%d, %s" % (a, next(k for k, v in INPUTS.items() if v == b))
+        elif op == OP_OUT:
+            text = "%s, r%d" % (next(k for k, v in OUTPUTS.items() if v == b), a)
+        elif op == OP_JMP:
+            text = "@%d" % (pc + 1 + c)
+        elif op in (OP_JZ, OP_JNZ):
+            text = "r%d, @%d" % (a, pc + 1 + c)
+        elif op in JUMPS:
+            text = "r%d, r%d, @%d" % (a, b, pc + 1 + c)
+        elif op == OP_END:
+            text = ""
+        else:
+            text = "r%d, r%d, r%d" % (a, b, c)
+        print("%3d  %-5s %s" % (pc, name, text))
+
+
+def build(args):
+    code = compile_script(args.script)
+    listing(code)
+    print("%d instructions, worst case %d executed" % (len(code), worst_case(code)), file=sys.stderr)
+
+
+def upload(args):
+    code = compile_script(args.script)
+    send(args.port, args.preset, code)
+    print("preset %d: %d instructions" % (args.preset, len(code)), file=sys.stderr)
+
+
+def clear(args):
+    send(args.port, args.preset, [])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Reverb Island control script compiler")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("build", help="compile and print listing")
+    p.add_argument("script")
+    p.set_defaults(func=build)
+
+    p = sub.add_parser("upload", help="compile and upload to a preset")
+    p.add_argument("port")
+    p.add_argument("script")
+    p.add_argument("--preset", type=int, required=True, choices=range(PRESET_TOTAL), metavar="N")
+    p.set_defaults(func=upload)
+
+    p = sub.add_parser("clear", help="remove the script from a preset")
+    p.add_argument("port")
+    p.add_argument("--preset", type=int, required=True, choices=range(PRESET_TOTAL), metavar="N")
+    p.set_defaults(func=clear)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()